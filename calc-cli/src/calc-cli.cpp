@@ -4,18 +4,200 @@
  * It supports the basic four functions, float modulus and float
  * factorial along with user-defined variables, and predefined
  * constants and functions.
+ *
+ * Usage:
+ *   calc-cli                   interactive calculator
+ *   calc-cli --server <path>   serve calculators on a UNIX socket
+ *   calc-cli --client <path>   evaluate standard input on a server
+ *   calc-cli --script <file>   run a file of statements, with those
+ *                              which don't depend on each other run
+ *                              at the same time
+ *   calc-cli --script <file> <names>
+ *                              print only the variables named, running
+ *                              only the lines they depend on
+ *   calc-cli --validate <file>...
+ *                              check files without evaluating them,
+ *                              reporting each error's line and column
+ *   calc-cli --csv <file> <expression>
+ *                              evaluate for every row of a CSV file
+ *   calc-cli --binary <names> <file> <expression>
+ *                              the same for a file of raw numbers
+ *
+ * These options may come first, in any order:
+ *   --fast-math   trade a few units in the last place for speed in the
+ *                 trigonometric, hyperbolic, logarithmic and root
+ *                 functions
+ *   --memo        cache the results of the more costly predefined
+ *                 functions, for inputs which repeat arguments
+ *   --raw-output  write the results of --csv and --binary as raw
+ *                 numbers rather than text
+ *   --stats       instead, summarize them
+ *   --plugin <path>
+ *                 add the functions of a plugin; see
+ *                 plugin/calc_cli_plugin.h
+ *   --load <file> start with a session saved by the save command
+ *   --profile <file>
+ *                 time every subexpression evaluated, and write the
+ *                 times to a file of folded stacks on exit
+ *   --limit <name>=<value>
+ *                 limit what each input may use: input (characters),
+ *                 tokens, depth (of parentheses and brackets), time
+ *                 (seconds), steps or memory (MiB); may be repeated
+ *   --threads <n> work with n threads rather than one per processor
  */
 
 
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+
 #include "calculator/calculator.hpp"
+#include "server/server.hpp"
 #include "utils/utils.hpp"
+#include "utils/calc_consts.hpp"
+#include "utils/batch_funcs.hpp"
+#include "utils/memo.hpp"
+#include "plugin/plugin.hpp"
+#include "calculator/pool/pool.hpp"
+#include "calculator/limits/limits.hpp"
+#include "calculator/profile/profile.hpp"
+#include "calculator/exceptions/exceptions.hpp"
+
+
+// with --memo, each function's cache holds about this much at most
+constexpr std::size_t memo_bytes = 1 << 20;
 
 
-int main() {
+int main(int argc, char* argv[]) {
+	auto precision = Precision::exact;
+	bool memoized = false;
+	auto output = Table_output::text;
+	std::vector<std::string> plugins;
+	std::string session;
+	for (; argc > 1; --argc, ++argv) {
+		std::string option{ argv[1] };
+		if (option == fast_math_option) {
+			precision = Precision::fast;
+		} else if (option == memo_option) {
+			memoized = true;
+		} else if (option == raw_output_option) {
+			output = Table_output::raw;
+		} else if (option == stats_option) {
+			output = Table_output::summary;
+		} else if (option == plugin_option && argc > 2) {
+			plugins.push_back(argv[2]);
+			--argc, ++argv;
+		} else if (option == load_option && argc > 2) {
+			session = argv[2];
+			--argc, ++argv;
+		} else if (option == profile_option && argc > 2) {
+			start_profiling(argv[2]);
+			--argc, ++argv;
+		} else if (option == limit_option && argc > 2) {
+			if (!set_limit(argv[2])) {
+				std::cerr << error << "unknown limit " << argv[2] << '\n';
+				return 1;
+			}
+			--argc, ++argv;
+		} else if (option == threads_option && argc > 2) {
+			if (!set_thread_count(argv[2])) {
+				std::cerr << error << "bad thread count " << argv[2] << '\n';
+				return 1;
+			}
+			--argc, ++argv;
+		} else {
+			break;
+		}
+	}
+
+	if (is_profiling()) {
+		std::atexit([]() {
+			if (!write_profile()) {
+				std::cerr << error << "can't write the profile\n";
+			}
+		});
+	}
+
+	// the client doesn't calculate anything itself, so it starts
+	// before any calculator is set up
+	if (argc == 3 && std::string{ argv[1] } == client_option) {
+		return connect_to(argv[2]);
+	}
+
 	auto consts = get_consts();
 	auto funcs = get_funcs();
+	auto derivs = get_derivs();
+	auto batches = get_batch_funcs(precision);
+
+	// outside of reductions, use the same approximations
+	if (precision == Precision::fast) {
+		for (const auto& b : batches) {
+			funcs[b.first] = scalar(b.second);
+		}
+	}
+
+	if (memoized) {
+		for (const auto& name : get_pure_funcs()) {
+			funcs[name] = memoize(name, funcs[name], memo_bytes);
+		}
+	}
+
+	Plugin_funcs added;
+	for (const auto& path : plugins) {
+		if (!load_plugin(path, added)) {
+			return 1;
+		}
+	}
+
+	for (const auto& f : added.funcs) {
+		bool pure = (added.impure.count(f.first) == 0);
+		funcs[f.first] = (memoized && pure)
+			? memoize(f.first, f.second, memo_bytes) : f.second;
+	}
+	batches.insert(added.batches.begin(), added.batches.end());
 
-	Calculator calc{ consts, funcs };
+	Calculator calc{ consts, funcs, derivs, batches, added.impure };
+
+	if (!session.empty()) {
+		try {
+			calc.load(session);
+		} catch (Calc_cli_exception& e) {
+			std::cerr << error << e.what() << '\n';
+			return 1;
+		}
+	}
+
+	if (argc == 3 && std::string{ argv[1] } == server_option) {
+		return serve(argv[2], calc);
+	}
+
+	if (argc == 3 && std::string{ argv[1] } == script_option) {
+		return run_script(argv[2], calc);
+	}
+
+	if (argc == 4 && std::string{ argv[1] } == script_option) {
+		return run_script(argv[2], calc, split_names(argv[3]));
+	}
+
+	if (argc >= 3 && std::string{ argv[1] } == validate_option) {
+		auto arities = get_arities();
+		arities.insert(added.arities.begin(), added.arities.end());
+
+		return run_validate({ argv + 2, argv + argc }, calc, arities);
+	}
+
+	if (argc == 4 && std::string{ argv[1] } == csv_option) {
+		return run_csv(argv[2], argv[3], calc, output);
+	}
+
+	if (argc == 5 && std::string{ argv[1] } == binary_option) {
+		return run_binary(argv[3], argv[2], argv[4], calc, output);
+	}
+
+	if (!is_interactive()) {
+		return run_stream(calc);
+	}
 
 	while (true) {
 		run(calc);
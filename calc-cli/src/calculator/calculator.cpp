@@ -2,22 +2,42 @@
  * calc-cli is a command-line calculator.
  *
  * calculator.cpp defines the grammar functions used by the
- * Calculator class.
+ * Calculator class. Statements are executed right away; everything
+ * below <statement> and <declaration> compiles into a Node which is
+ * then evaluated.
  * 
  * Calculator uses the following grammar:
  *
- * <statement>		:= <expression> | <declaration>
- * <declaration>	:= "let" <variable> = <expression>
+ * <statement>		:= <value> | <declaration>
+ * <declaration>	:= "let" <variable> "=" <value> | "let" <function> "[" <parameters> "]" "=" <comparison>
+ * <value>			:= <comparison> | <arguments> of which one is a range, which make a vector
+ * <parameters>		:= <variable> | <parameters> "," <variable>
+ * <comparison>		:= <comparison> <comparator> <expression> | <expression>
+ * <comparator>		:= "<" | "<=" | ">" | ">=" | "==" | "!="
  * <expression>		:= <expression> "+" <term> | <expression> "-" <term> | <term>
  * <term>			:= <term> "*" <unary> | <term> "/" <unary> | <term> "%" <unary> | <unary>
  * <unary>			:= "+" <power> | "-" <power> | <power>
  * <power>			:= <power> "^" <primary> | <primary>
- * <primary>		:= "(" <expression> ")" | <primary> "!" | <number>
+ * <primary>		:= "(" <comparison> ")" | <primary> "!" | "[" <arguments> "]" | <number>
  * <number>			:= <call> | <variable> | "_" | a floating-point literal as used in C++ without unary + or -
- * <call>			:= <function> "[" <arguments> "]"
+ * <call>			:= <function> "[" <arguments> "]" | <reduction> | <numerical> | <conditional>
+ * <reduction>		:= <reducer> "[" <variable> "," <comparison> "," <comparison> "," <comparison> "]"
+ * <reducer>		:= "sum" | "product"
+ * <numerical>		:= <method> "[" <variable> "," <comparison> "," <comparison> "," <comparison> "]" | <method> "[" <variable> "," <comparison> "," <comparison> "," <comparison> "," <comparison> "]"
+ * <method>			:= "integrate" | "solve"
+ * <conditional>	:= "if" "[" <comparison> "," <comparison> "," <comparison> "]" | "piecewise" "[" <pieces> "," <comparison> "]"
+ * <pieces>			:= <comparison> "," <comparison> | <pieces> "," <comparison> "," <comparison>
  * <function>		:= a group of letters with no underscore or digits allowed
- * <arguments>		:= <expression> | <arguments> "," <expression>
+ * <arguments>		:= <argument> | <arguments> "," <argument>
+ * <argument>		:= <comparison> | <comparison> ".." <comparison>
  * <variable>		:= a group of letters with no underscore or digits allowed
+ *
+ * A vector, written as "[" <arguments> "]" or held by a variable, has
+ * an element for each of the values of its arguments. An operation or
+ * function applied to vectors is applied to each of their elements in
+ * turn, and so to the numbers with them; the result is a vector too.
+ * A function taking any number of arguments, such as sum or max, is
+ * given a vector's elements as its arguments instead.
  */
 
 
@@ -25,9 +45,16 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <utility>
+#include <memory>
+#include <initializer_list>
 
 #include "calculator.hpp"
 #include "token/token.hpp"
+#include "limits/limits.hpp"
+#include "numeric/numeric.hpp"
+#include "profile/profile.hpp"
+#include "polynomial/polynomial.hpp"
 #include "exceptions/exceptions.hpp"
 
 
@@ -37,25 +64,96 @@ using std::vector;
 using ull = unsigned long long;
 
 
+// user-defined functions with bodies of at most this many Nodes are
+// inlined into their callers
+constexpr std::size_t inline_limit = 64;
+
+// a chain of operations longer than this is compiled in segments of
+// at least this many
+constexpr std::size_t chain_segment = 1000;
+
+
 bool is_operator(Token_type t);
 
 bool is_unary(const Token_iter& current_index,
 	const Token_iter& start_index);
 
-double factorial(double n);
+bool is_reducer(const std::string& name);
+bool is_numerical(const std::string& name);
+bool is_conditional(const std::string& name);
+bool is_aggregate(const std::string& name);
+
+bool is_simple(const Node& argument);
+bool has_impure(const Node& node);
+
+bool has_vector(const Node& node);
+bool has_each(const Node& node);
+bool depends(const Node& node, std::size_t outer);
+void bind_vectors(Node& node, Node& each, std::size_t first,
+	bool checking);
+
+Node operation(Node_type type, Node operand);
+Node operation(Node_type type, Node lhs, Node rhs);
+Node_type operation_of(Token_type op);
+Node link_chain(Node first, vector<Node> links, std::size_t free_slot);
+
+bool encloses(const Token_iter& start, const Token_iter& end);
 
 Token_iter backward_find(const Token_iter& start,
-	const Token_iter& end, const vector<Token_type>& to_find);
+	const Token_iter& end, std::initializer_list<Token_type> to_find);
 
 
-double Calculator::statement(const Token_iter& s,
+/**
+ * Return an error located at the given column.
+ */
+template <typename E>
+E located(E e, std::size_t column) {
+	e.locate(column);
+	return e;
+}
+
+
+/**
+ * Execute a statement. Compiling it may evaluate calls with constant
+ * arguments, so the whole statement is counted against the limits.
+ */
+Real Calculator::statement(const Token_iter& s,
 		const Token_iter& e) {
-	
-	double result;
+
+	Evaluation_budget bounded;
+	shown.reset();
+	defined.clear();
+	if (s == e) {	// e.g.: input of only spaces
+		throw located(Syntax_error{ "bad syntax" }, column_of(s));
+	}
+
+	if (s->type == Token_type::let && e - s > 2 &&
+			(s + 2)->type == Token_type::arg_delim_open) {
+		// function definition; it has no value, so `_` is unchanged,
+		// and what is shown is the function's name
+		return function_declaration(s, e);
+	}
+
+	Real result;
 	if (s->type == Token_type::let) {	// variable definition
 		result = declaration(s, e);
 	} else {
-		result = expression(s, e);
+		auto exp = outermost(s, e);
+		if (checking()) {
+			return prev;
+		}
+
+		mark_parallel(exp);
+
+		// a vector leaves `_` and the statistics as they were; it has
+		// exact ones of its own, such as average[v]
+		if (exp.type == Node_type::each) {
+			shown = run_vector(exp);
+			return prev;
+		}
+
+		result = run(exp);
+		results.add(result);
 	}
 
 	prev = result;
@@ -63,21 +161,24 @@ double Calculator::statement(const Token_iter& s,
 }
 
 
-double Calculator::declaration(const Token_iter& s,
+Real Calculator::declaration(const Token_iter& s,
 		const Token_iter& e) {
 
 	// let (1) var (2) = (3) exp (4)
-	// a valid declaration must have all four parts
-	if (!(s + 1 == e || s + 2 == e || s + 3 == e)) {
-		throw Syntax_error{
-			"declaration must be of the form: let var = val" };
+	// a valid declaration must have all four parts; the error is at
+	// the first one missing or out of place
+	auto part = s + 1;
+	if (part != e && part->type == Token_type::variable) {
+		++part;
+		if (part != e && part->type == Token_type::assignment) {
+			++part;
+		}
 	}
 
-	if (s->type != Token_type::let ||
-			(s + 1)->type != Token_type::variable ||
-			(s + 2)->type != Token_type::assignment) {
-		throw Syntax_error{
-			"declaration must be of the form: let var = val" };
+	if (part == e || part != s + 3) {
+		throw located(Syntax_error{
+			"declaration must be of the form: let var = val" },
+			column_of(part));
 	}
 
 	// at what position do (2) and (4) start
@@ -85,9 +186,22 @@ double Calculator::declaration(const Token_iter& s,
 	auto exp_start = s + 3;
 
 	string name = var_start->name;
-	double val = expression(exp_start, e);
+	auto exp = outermost(exp_start, e);
+	if (exp.type == Node_type::each) {
+		if (!checking()) {
+			mark_parallel(exp);
+			shown = run_vector(exp);
+		}
+
+		define_vector(name, checking() ? exp.children[1].elements : shown,
+			column_of(var_start));
+
+		return prev;
+	}
+
+	Real val = checking() ? 0 : run(exp);
 
-	define_var(name, val);
+	define_var(name, val, column_of(var_start));
 
 	// result of a variable definition is the ultimate value
 	// assigned to the variable
@@ -95,84 +209,247 @@ double Calculator::declaration(const Token_iter& s,
 }
 
 
-double Calculator::expression(const Token_iter& s,
+/**
+ * Compile and define a function: let (1) name (2) [ (3) params (4)
+ * ] (5) = (6) exp (7).
+ */
+Real Calculator::function_declaration(const Token_iter& s,
 		const Token_iter& e) {
 
-	auto p = backward_find(s, e,
-		{ Token_type::plus, Token_type::minus });
-	if (p == e) {
-		return term(s, e);
-	} else if (p->type == Token_type::plus) {
-		return expression(s, p) + term(p + 1, e);
-	} else {
-		return expression(s, p) - term(p + 1, e);
+	auto close = std::find_if(s, e, [](const Token& t) {
+		return t.type == Token_type::arg_delim_close; });
+
+	if ((s + 1)->type != Token_type::variable || close == e ||
+			close + 1 == e || close + 2 == e ||
+			(close + 1)->type != Token_type::assignment) {
+		throw located(Syntax_error{ "function definition must be of "
+			"the form: let f[x, y] = val" }, column_of(s));
 	}
-}
 
+	// parameters are the names at every other position inside [ ]
+	vector<string> params;
+	for (auto i = s + 3; i < close; i += 2) {
+		if (i->type != Token_type::variable || (i + 1 != close &&
+				(i + 1)->type != Token_type::arg_separator)) {
+			throw located(Syntax_error{ "parameters must be names "
+				"separated by commas" }, column_of(i));
+		}
 
-double Calculator::term(const Token_iter& s, const Token_iter& e) {
-	using std::fmod;
+		if (std::find(params.begin(), params.end(), i->name) !=
+				params.end()) {
+			throw located(Redeclaration_of_variable{
+				"can't repeat a parameter" }, column_of(i));
+		}
 
-	auto p = backward_find(s, e, {
-		Token_type::multiply, Token_type::divide, Token_type::mod });
-	if (p == e) {
-		return unary(s, e);
-	} else if (p->type == Token_type::multiply) {
-		return term(s, p) * unary(p + 1, e);
-	} else {
-		auto r = unary(p + 1, e);
-		if (r == 0) {
-			throw Unsupported_operand{ "Can't divide or mod by 0." };
+		params.push_back(i->name);
+	}
+
+	auto exp_start = close + 2;
+	auto prev_use = std::find_if(exp_start, e, [](const Token& t) {
+		return t.type == Token_type::previous; });
+	if (prev_use != e) {
+		throw located(Syntax_error{ "_ can't be used in a function" },
+			column_of(prev_use));
+	}
+
+	auto& name = (s + 1)->name;
+	if (user_funcs.find(name) != user_funcs.end() ||
+			funcs.find(name) != funcs.end() || is_conditional(name) ||
+			is_numerical(name)) {
+		throw located(Redeclaration_of_variable{
+			"can't redeclare function" }, column_of(s + 1));
+	}
+
+	// the body sees only its parameters, in slots 0 .. arity - 1
+	auto outer = std::move(locals);
+	locals = params;
+	try {
+		User_func fn{ params.size(), outermost(exp_start, e) };
+		locals = std::move(outer);
+
+		// a function is saved with its body, which has no room for
+		// the elements of a vector
+		if (has_each(fn.body)) {
+			throw located(Syntax_error{ "a function can't use a vector" },
+				column_of(exp_start));
 		}
 
-		if (p->type == Token_type::divide) {
-			return term(s, p) / r;
-		} else {
-			return fmod(term(s, p), r);
+		if (!checking()) {
+			fold(fn.body);
 		}
+		define_fn(name, std::move(fn));
+	} catch (...) {
+		locals = std::move(outer);
+		throw;
+	}
+
+	defined = name + '[';
+	for (std::size_t i = 0; i < params.size(); ++i) {
+		defined += ((i > 0) ? ", " : "") + params[i];
 	}
+	defined += ']';
+
+	return prev;
 }
 
 
-double Calculator::unary(const Token_iter& s, const Token_iter& e) {
-	int multiplier = 1;
+/**
+ * Compile a whole expression, which mustn't have operations nested
+ * too deeply to evaluate. No token adds more Nodes than an inlined
+ * function does, so a short expression isn't walked to check. If its
+ * value is a vector, it is evaluated for each element. Polynomials in
+ * an index variable are rewritten to be evaluated by Horner's scheme.
+ */
+Node Calculator::outermost(const Token_iter& s, const Token_iter& e) {
+	auto exp = (backward_find(s, e, { Token_type::range }) != e)
+		? vector_literal(s, e) : comparison(s, e);
+	auto tokens = static_cast<std::size_t>(e - s);
+	if (tokens > max_nesting / (inline_limit + 1) &&
+			depth(exp) > max_nesting) {
+		throw located(Limit_exceeded{ "nested too deeply" },
+			column_of(s));
+	}
 
-	Token_iter i;
-	for (i = s; i->type == Token_type::plus; ++i) {
+	if (has_vector(exp)) {
+		exp = elementwise(std::move(exp));
 	}
 
-	for (; i->type == Token_type::minus; ++i) {
-		multiplier *= -1;
+	if (!checking()) {
+		find_polynomials(exp);
 	}
 
-	return multiplier * power(i, e);
+	return exp;
 }
 
 
-double Calculator::power(const Token_iter& s, const Token_iter& e) {
-	using std::pow;
+/**
+ * Compile the arguments from start to end into a vector of all of
+ * their values, which is evaluated right away: its elements are
+ * stored, like a variable's value, rather than computed each time it
+ * is used.
+ */
+Node Calculator::vector_literal(const Token_iter& s,
+		const Token_iter& e) {
+
+	Node list{ Node_type::call };
+	list.children = arguments(s, e);
+	for (auto& element : list.children) {
+		if (element.type != Node_type::range && has_vector(element)) {
+			element = elementwise(std::move(element));
+		}
+	}
+
+	if (depends(list, locals.size())) {
+		throw located(Syntax_error{ "the elements of a vector can't "
+			"depend on _ or an index variable" }, column_of(s));
+	}
+
+	Node v{ Node_type::vector };
+	v.name = "[...]";
 
-	auto p = backward_find(s, e, { Token_type::power });
-	if (p == e) {
-		return primary(s, e);
-	} else {
-		return pow(power(s, p), primary(p + 1, e));
+	// while checking, a vector has no elements
+	if (checking()) {
+		v.elements = std::make_shared<const vector<Real>>();
+		return v;
 	}
+
+	Frame frame{ prev, vector<Real>(frame_size(list)) };
+	v.elements = std::make_shared<const vector<Real>>(
+		::arguments(list, frame));
+
+	return v;
+}
+
+
+/**
+ * Return an each which evaluates the given expression for every
+ * element of the vectors it uses, other than those in an each of its
+ * own. The vectors are bound to slots above those the expression
+ * uses; a vector used more than once has one slot.
+ */
+Node Calculator::elementwise(Node body) {
+	Node each{ Node_type::each };
+	each.children.emplace_back();
+
+	bind_vectors(body, each, std::max(locals.size(), frame_size(body)),
+		checking());
+	each.children[0] = std::move(body);
+
+	return each;
 }
 
 
-double Calculator::primary(const Token_iter& s,
+/**
+ * Compile comparisons, which bind less tightly than any arithmetic,
+ * so that x + 1 < y * 2 compares two sums.
+ */
+Node Calculator::comparison(const Token_iter& s,
 		const Token_iter& e) {
 
+	return chain(s, e, { Token_type::less, Token_type::less_equal,
+		Token_type::greater, Token_type::greater_equal,
+		Token_type::equal, Token_type::not_equal },
+		&Calculator::expression);
+}
+
+
+Node Calculator::expression(const Token_iter& s,
+		const Token_iter& e) {
+
+	return chain(s, e, { Token_type::plus, Token_type::minus },
+		&Calculator::term);
+}
+
+
+Node Calculator::term(const Token_iter& s, const Token_iter& e) {
+	return chain(s, e, { Token_type::multiply, Token_type::divide,
+		Token_type::mod }, &Calculator::unary);
+}
+
+
+Node Calculator::unary(const Token_iter& s, const Token_iter& e) {
+	int multiplier = 1;
+
+	Token_iter i;
+	for (i = s; i != e && i->type == Token_type::plus; ++i) {
+	}
+
+	for (; i != e && i->type == Token_type::minus; ++i) {
+		multiplier *= -1;
+	}
+
+	if (multiplier == -1) {
+		return operation(Node_type::negate, power(i, e));
+	}
+
+	return power(i, e);
+}
+
+
+Node Calculator::power(const Token_iter& s, const Token_iter& e) {
+	return chain(s, e, { Token_type::power }, &Calculator::primary);
+}
+
+
+Node Calculator::primary(const Token_iter& s, const Token_iter& e) {
 	if (e == s) {	// this is caused when a lone `!` is given as
 					// input; maybe caused due to other reasons as
 					// well
-		throw Syntax_error{ "bad syntax" };
+		throw located(Syntax_error{ "bad syntax" }, column_of(e));
+	}
+
+	// a run of factorials, as in 3!!, is applied in a loop
+	auto operand_end = e;
+	while (operand_end != s &&
+			(operand_end - 1)->type == Token_type::factorial) {
+		--operand_end;
 	}
 
-	if ((e - 1)->type == Token_type::factorial) {
-		double n = primary(s, e - 1);
-		return factorial(n);
+	if (operand_end != e) {
+		vector<Node> links(static_cast<std::size_t>(e - operand_end),
+			operation(Node_type::factorial, Node{}));
+		return link_chain(primary(s, operand_end), std::move(links),
+			locals.size());
 	}
 
 	switch (s->type) {
@@ -180,101 +457,558 @@ double Calculator::primary(const Token_iter& s,
 	case Token_type::variable:
 	case Token_type::previous:
 		return number(s, e);
-	//	if (s != (e - 1)) {
-	//		throw Syntax_error{ "no operator between operands" };
-	//	}
-	//	return s->value;
-	//case Token_type::variable:	// could be a variable or function
-
-	//	// function: name (1) [ (2) args (3) ] (4)
-	//	if (s != (e - 1) && 
-	//			(s + 1)->type == Token_type::arg_delim_open) {
-	//		
-	//		if ((e - 1)->type != Token_type::arg_delim_close) {
-	//			throw Unbalanced_parentheses{ "] was not found" };
-	//		}
-	//		return invoke_fn(s->name, arguments(s + 1, e));
-	//	}
-
-	//	// variable
-	//	return evaluate_var(s->name);
-	//case Token_type::previous:
-	//	return prev;
-	case Token_type::p_open:
+	case Token_type::p_open: {
 		if ((e - 1)->type != Token_type::p_close) {
-			throw Unbalanced_parentheses{ ") was not found" };
+			throw located(Unbalanced_parentheses{ ") was not found" },
+				column_of(s));
 		}
-		return expression(s + 1, e - 1);
+
+		// parentheses around nothing but more parentheses, as in
+		// ((1 + 2)), are taken off in a loop
+		auto start = s;
+		auto end = e;
+		while (encloses(start, end) && encloses(start + 1, end - 1)) {
+			++start;
+			--end;
+		}
+
+		return comparison(start + 1, end - 1);
+	}
+	case Token_type::arg_delim_open: {
+		auto close = e - 1;
+		if (close->type != Token_type::arg_delim_close ||
+				(close->opened && close->opened !=
+					static_cast<std::size_t>(close - s))) {
+			throw located(Syntax_error{ "a vector must be of the form: "
+				"[a, b, ...]" }, column_of(s));
+		}
+
+		return vector_literal(s + 1, close);
+	}
 	default:
-		throw Syntax_error{ "the given token doesn't belong here" };
+		throw located(Syntax_error{
+			"the given token doesn't belong here" }, column_of(s));
 	}
 }
 
 
-double Calculator::number(const Token_iter& s, const Token_iter& e) {
+Node Calculator::number(const Token_iter& s, const Token_iter& e) {
 	switch (s->type) {
 	case Token_type::number:
 	case Token_type::previous: {
 		if (s != (e - 1)) {	// e.g.: "1 1"
-			throw Syntax_error{ "no operator between operands" };
+			throw located(Syntax_error{
+				"no operator between operands" }, column_of(s + 1));
 		}
 
-		auto v = (s->type == Token_type::number) ? s->value : prev;
-		return v;
+		if (s->type == Token_type::previous) {
+			return Node{ Node_type::previous };
+		}
+
+		return Node{ Node_type::number, s->value };
 	}
 	case Token_type::variable:
-		if (s == (e - 1)) {
-			return evaluate_var(s->name);
+		if (s != (e - 1)) {
+			return call(s, e);
 		}
 
-		return call(s, e);
+		// innermost index variable first, so that nested reductions
+		// may reuse a name
+		for (auto i = locals.size(); i > 0; --i) {
+			if (locals[i - 1] == s->name) {
+				Node local{ Node_type::local, 0, i - 1 };
+				local.name = s->name;
+
+				return local;
+			}
+		}
+
+		// nor can vectors, so their elements are taken as they are now
+		if (auto elements = find_vector(s->name)) {
+			Node v{ Node_type::vector };
+			v.elements = std::move(elements);
+			v.name = s->name;
+
+			return v;
+		}
+
+		// variables can't be redefined, so their current value is
+		// their value forever
+		return Node{ Node_type::number,
+			evaluate_var(s->name, column_of(s)) };
 	default:
-		throw Syntax_error{ "the given token doesn't belong here" };
+		throw located(Syntax_error{
+			"the given token doesn't belong here" }, column_of(s));
 	}
 }
 
 
-double Calculator::call(const Token_iter& s, const Token_iter& e) {
+Node Calculator::call(const Token_iter& s, const Token_iter& e) {
 	// check if this is a proper function call
 	if (s->type != Token_type::variable ||
 			(s + 1)->type != Token_type::arg_delim_open ||
 			(e - 1)->type != Token_type::arg_delim_close) {
 
-		throw Syntax_error{ "improper function call" };
+		throw located(Syntax_error{ "improper function call" },
+			column_of(s));
+	}
+
+	if (is_index_form(s, e)) {
+		return reduction(s, e);
+	}
+
+	if (is_numerical(s->name)) {
+		throw located(Syntax_error{ s->name + " must be given a "
+			"variable, its bounds and an expression" }, column_of(s));
+	}
+
+	if (is_conditional(s->name)) {
+		return conditional(s, arguments(s + 2, e - 1));
+	}
+
+	auto args = arguments(s + 2, e - 1);
+
+	// a function of any number of arguments is given the elements of
+	// a vector; any other is called for each of them
+	if (is_aggregate(s->name)) {
+		for (auto& arg : args) {
+			if (arg.type != Node_type::range && has_vector(arg)) {
+				arg = elementwise(std::move(arg));
+			}
+		}
+	}
+
+	auto has_range = std::any_of(args.begin(), args.end(),
+		[](const Node& n) { return n.type == Node_type::range; });
+	auto expands = has_range || std::any_of(args.begin(), args.end(),
+		[](const Node& n) { return n.type == Node_type::each; });
+
+	auto user = user_funcs.find(s->name);
+	if (checking() && !expands) {
+		check_arity(s, args.size());
+	} else if (user != user_funcs.end() && !expands &&
+			size(user->second.body) <= inline_limit) {
+		return inline_fn(user->second, std::move(args));
+	}
+
+	auto plain_call = [this, &s](vector<Node> args) {
+		Node c{ Node_type::call, 0, 0, find_fn(s->name, column_of(s)),
+			find_deriv(s->name), find_batch(s->name), s->name };
+		c.children = std::move(args);
+		c.impure = (impure.count(s->name) != 0);
+
+		return c;
+	};
+
+	if (!has_range || !is_reducer(s->name)) {
+		return plain_call(std::move(args));
+	}
+
+	// sum and product don't need all their arguments at once: each
+	// range is streamed through a reduction, and the partial results
+	// are combined
+	auto type = (s->name == "sum") ? Node_type::sum : Node_type::product;
+	auto combine = (s->name == "sum") ? Node_type::add
+		: Node_type::multiply;
+
+	Node result{ Node_type::number,
+		static_cast<Real>(type == Node_type::product) };
+	for (auto& arg : args) {
+		if (arg.type == Node_type::range) {
+			Node r{ type, 0, locals.size() };
+			r.children = std::move(arg.children);
+			r.children.push_back(Node{ Node_type::local, 0, r.slot });
+
+			arg = std::move(r);
+		} else if (arg.type == Node_type::each) {
+			vector<Node> elements;
+			elements.push_back(std::move(arg));
+			arg = plain_call(std::move(elements));
+		}
+
+		result = operation(combine, std::move(result), std::move(arg));
+	}
+
+	return result;
+}
+
+
+/**
+ * Compile a sum or product over an index variable:
+ * reducer [ var, lo, hi, body ], or an integral or root, which may
+ * also be given a tolerance: method [ var, lo, hi, body, tolerance ].
+ */
+Node Calculator::reduction(const Token_iter& s, const Token_iter& e) {
+	auto lo_start = s + 4;
+	auto close = e - 1;
+
+	// the separators after lo, from the last back
+	vector<Token_iter> seps;
+	for (auto last = close; ; ) {
+		auto p = backward_find(lo_start, last,
+			{ Token_type::arg_separator });
+		if (p == last) {
+			break;
+		}
+
+		seps.push_back(p);
+		last = p;
+	}
+	std::reverse(seps.begin(), seps.end());
+
+	bool numerical = is_numerical(s->name);
+	if (seps.size() != 2 && !(numerical && seps.size() == 3)) {
+		throw located(Unsupported_operand{
+			"invalid number of arguments" }, column_of(s));
+	}
+
+	Node_type type;
+	if (s->name == "sum") {
+		type = Node_type::sum;
+	} else if (s->name == "product") {
+		type = Node_type::product;
+	} else if (s->name == "integrate") {
+		type = Node_type::integral;
+	} else {
+		type = Node_type::root;
+	}
+
+	auto body_end = (seps.size() == 3) ? seps[2] : close;
+
+	Node r{ type, 0, locals.size() };
+	r.name = (s + 2)->name;
+	r.children.push_back(comparison(lo_start, seps[0]));
+	r.children.push_back(comparison(seps[0] + 1, seps[1]));
+
+	locals.push_back((s + 2)->name);
+	try {
+		r.children.push_back(comparison(seps[1] + 1, body_end));
+	} catch (...) {
+		locals.pop_back();
+		throw;
+	}
+	locals.pop_back();
+
+	if (numerical) {
+		r.children.push_back((seps.size() == 3)
+			? comparison(seps[2] + 1, close)
+			: Node{ Node_type::number, default_tolerance });
 	}
 
-	return invoke_fn(s->name, arguments(s + 2, e - 1));
+	return r;
 }
 
 
-vector<double> Calculator::arguments(const Token_iter& s,
+/**
+ * Compile if [ condition, a, b ], or piecewise [ c1, a1, c2, a2, ...,
+ * otherwise ], into selects, which evaluate only the value chosen: the
+ * first whose condition isn't 0, or the last.
+ */
+Node Calculator::conditional(const Token_iter& name, vector<Node> args) {
+	if (args.size() < 3 || args.size() % 2 == 0 ||
+			(name->name == "if" && args.size() != 3)) {
+		throw located(Unsupported_operand{
+			"invalid number of arguments" }, column_of(name));
+	}
+
+	if (std::any_of(args.begin(), args.end(), [](const Node& n) {
+			return n.type == Node_type::range; })) {
+		throw located(Syntax_error{
+			"a range can't be a condition or a value" },
+			column_of(name));
+	}
+
+	// built from the last choice back, so the first is outermost
+	auto result = std::move(args.back());
+	for (auto i = args.size() - 1; i > 0; i -= 2) {
+		Node select{ Node_type::select };
+		select.children.reserve(3);
+		select.children.push_back(std::move(args[i - 2]));
+		select.children.push_back(std::move(args[i - 1]));
+		select.children.push_back(std::move(result));
+
+		result = std::move(select);
+	}
+
+	return result;
+}
+
+
+vector<Node> Calculator::arguments(const Token_iter& s,
 		const Token_iter& e) {
 
+	vector<Node> args;
 	if (s == e) {	// empty argument list
-		return {};
+		return args;
+	}
+
+	// taken from the last argument back, in a loop rather than by
+	// recursion, so that a long list can't overflow the stack
+	for (auto last = e; ; ) {
+		auto p = backward_find(s, last, { Token_type::arg_separator });
+
+		if (p == last) {	// first argument
+			args.push_back(argument(s, last));
+			break;
+		}
+
+		args.push_back(argument(p + 1, last));
+		last = p;
+	}
+
+	std::reverse(args.begin(), args.end());
+	return args;
+}
+
+
+Node Calculator::argument(const Token_iter& s, const Token_iter& e) {
+	auto p = backward_find(s, e, { Token_type::range });
+
+	if (p == e) {
+		return comparison(s, e);
+	}
+
+	auto range = operation(Node_type::range, comparison(s, p),
+		comparison(p + 1, e));
+	if (has_vector(range)) {
+		throw located(Syntax_error{ "a range's bounds can't be vectors" },
+			column_of(p));
 	}
 
-	auto p = backward_find(s, e, { Token_type::arg_separator });
+	return range;
+}
+
+
+/**
+ * Compile a chain of left-associative operations, such as a + b - c,
+ * whose operands are compiled by the given rule. It is compiled in a
+ * loop rather than by recursion, so that a long chain can't overflow
+ * the stack: each operation is made without its left operand, which
+ * link_chain fills in. The operands are still compiled from the last
+ * to the first, as recursion compiled them, so the error reported for
+ * input with several doesn't change.
+ */
+Node Calculator::chain(const Token_iter& s, const Token_iter& e,
+		std::initializer_list<Token_type> operators,
+		Grammar_rule operand) {
+
+	auto p = backward_find(s, e, operators);
+	if (p == e) {
+		return (this->*operand)(s, e);
+	}
+
+	vector<Node> links;
+	auto last = e;
+	for (; p != last; p = backward_find(s, last, operators)) {
+		links.push_back(operation(operation_of(p->type), Node{},
+			(this->*operand)(p + 1, last)));
+		last = p;
+	}
+
+	std::reverse(links.begin(), links.end());
+	return link_chain((this->*operand)(s, last), std::move(links),
+		locals.size());
+}
+
+
+/**
+ * Compile an expression without evaluating it. Variables used by it
+ * are replaced by their values, which can never change.
+ */
+Node Calculator::compile(string input, const vector<string>& params) {
+	auto tokens = tokenize(input);
+	set_input(tokens, input);
+	if (!tokens.empty() && tokens.front().type == Token_type::let) {
+		throw located(Syntax_error{
+			"only an expression can be compiled" },
+			tokens.front().column);
+	}
+
+	auto outer = std::move(locals);
+	locals = params;
+	try {
+		Evaluation_budget bounded;
+		auto exp = outermost(tokens.begin(), tokens.end());
+		locals = std::move(outer);
+
+		return exp;
+	} catch (...) {
+		locals = std::move(outer);
+		throw;
+	}
+}
+
+
+/**
+ * Evaluate an expression together with its partial derivatives with
+ * respect to the given variables, in one pass. Like evaluate, this
+ * sets `_` to the expression's value.
+ */
+Dual Calculator::differentiate(string input, const vector<string>& wrt) {
+	Evaluation_budget bounded;
+	auto tokens = tokenize(input);
+	set_input(tokens, input);
+	if (!tokens.empty() && tokens.front().type == Token_type::let) {
+		throw located(Syntax_error{
+			"only an expression can be differentiated" },
+			tokens.front().column);
+	}
+
+	// compile the variables as index variables, so that they aren't
+	// replaced by their values
+	auto outer = std::move(locals);
+	locals = wrt;
+
+	Node exp;
+	try {
+		exp = outermost(tokens.begin(), tokens.end());
+		locals = std::move(outer);
+	} catch (...) {
+		locals = std::move(outer);
+		throw;
+	}
+
+	if (exp.type == Node_type::each) {
+		throw located(Unsupported_operand{
+			"a vector can't be differentiated" }, tokens.front().column);
+	}
+
+	auto slots = std::max(wrt.size(), frame_size(exp));
+	Dual_frame frame{ Dual{ prev }, vector<Dual>(slots) };
+	for (std::size_t i = 0; i < wrt.size(); ++i) {
+		frame.locals[i] = seed(evaluate_var(wrt[i]), i, wrt.size());
+	}
+
+	auto result = ::evaluate(exp, frame);
+	result.d.resize(wrt.size());
+
+	prev = result.value;
+	return result;
+}
+
+
+/**
+ * Parse a statement as evaluate would, checking that every name is
+ * known and that every call has a valid number of arguments, but
+ * without evaluating anything.
+ */
+void Calculator::check(string input, const std::map<string, Arity>& a,
+		const vector<string>& params) {
+	auto tokens = tokenize(input);
+	set_input(tokens, input);
+
+	auto outer = std::move(locals);
+	locals = params;
+	checked = &a;
+	try {
+		statement(tokens.begin(), tokens.end());
+		locals = std::move(outer);
+		checked = nullptr;
+	} catch (...) {
+		locals = std::move(outer);
+		checked = nullptr;
+		throw;
+	}
+}
 
-	if (p == e) {	// single argument
-		return { expression(s, e) };
+
+/**
+ * Throw if a call to the named function, with the given number of
+ * arguments, can't succeed.
+ */
+void Calculator::check_arity(const Token_iter& name, std::size_t count) {
+	Arity arity;
+
+	auto user = user_funcs.find(name->name);
+	auto predefined = checked->find(name->name);
+	if (user != user_funcs.end()) {
+		arity = Arity{ user->second.arity, user->second.arity };
+	} else if (predefined != checked->end()) {
+		arity = predefined->second;
 	} else {
-		auto args = arguments(s, p);
-		auto exp = expression(p + 1, e);
-		args.push_back(exp);
+		return;		// unknown, or of any arity
+	}
 
-		return args;
+	if (count < arity.least || count > arity.most) {
+		throw located(Unsupported_operand{
+			"invalid number of arguments" }, column_of(name));
+	}
+}
+
+
+Real Calculator::evaluate(const Node& exp) {
+	if (exp.type == Node_type::each) {
+		shown = run_vector(exp);
+		return prev;
+	}
+
+	shown.reset();
+	defined.clear();
+	prev = run(exp);
+	results.add(prev);
+	return prev;
+}
+
+
+/**
+ * Evaluate a compiled expression, within the limits and profiling it
+ * if asked to.
+ */
+Real Calculator::run(const Node& exp) {
+	Evaluation_budget bounded;
+	Profile_recording profile;
+	Frame frame{ prev, vector<Real>(frame_size(exp)) };
+	return ::evaluate(exp, frame);
+}
+
+
+/**
+ * Evaluate a compiled expression whose value is a vector, as run
+ * does. A vector on its own is already evaluated.
+ */
+std::shared_ptr<const vector<Real>> Calculator::run_vector(
+		const Node& exp) {
+
+	const auto& body = exp.children[0];
+	if (body.type == Node_type::local && exp.children.size() == 2) {
+		return exp.children[1].elements;
 	}
+
+	Evaluation_budget bounded;
+	Profile_recording profile;
+	Frame frame{ prev, vector<Real>(frame_size(exp)) };
+	return std::make_shared<const vector<Real>>(::elements(exp, frame));
+}
+
+
+/**
+ * Note the tokens about to be compiled, so that an error at their end
+ * can be located.
+ */
+void Calculator::set_input(const vector<Token>& tokens,
+		const string& input) {
+	input_end = tokens.end();
+	end_column = input.size() + 1;
+}
+
+
+/**
+ * Return the column of the token at i, or just past the input if i is
+ * the end of the tokens.
+ */
+std::size_t Calculator::column_of(const Token_iter& i) const {
+	return (i == input_end) ? end_column : i->column;
 }
 
 
 /**
  * Define a new variable.
  */
-void Calculator::define_var(const string& name, double val) {
-	if (variables.find(name) != variables.end()) {
-		throw Redeclaration_of_variable{ 
-			"can't redeclare variable " };
+void Calculator::define_var(const string& name, Real val,
+		std::size_t column) {
+	if (find_var(name) || find_vector(name)) {
+		throw located(Redeclaration_of_variable{
+			"can't redeclare variable " }, column);
 	}
 
 	variables[name] = val;
@@ -284,25 +1018,294 @@ void Calculator::define_var(const string& name, double val) {
 /**
  * Return the value of a previously defined variable.
  */
-double Calculator::evaluate_var(const string& name) {
-	if (variables.find(name) == variables.end()) {
+Real Calculator::evaluate_var(const string& name, std::size_t column) {
+	auto value = find_var(name);
+	if (!value) {
+		throw located(Variable_not_defined{ "no such variable" },
+			column);
+	}
+
+	return *value;
+}
+
+
+/**
+ * Return the value of the named variable, wherever it was defined, or
+ * nullptr if there is none.
+ */
+const Real* Calculator::find_var(const string& name) const {
+	auto v = variables.find(name);
+	if (v != variables.end()) {
+		return &v->second;
+	}
+
+	return saved ? saved->find(name) : nullptr;
+}
+
+
+/**
+ * Define a new variable whose value is a vector.
+ */
+void Calculator::define_vector(const string& name,
+		std::shared_ptr<const vector<Real>> elements, std::size_t column) {
+	if (find_var(name) || find_vector(name)) {
+		throw located(Redeclaration_of_variable{
+			"can't redeclare variable " }, column);
+	}
+
+	vectors[name] = std::move(elements);
+}
+
+
+/**
+ * Return the elements of the named vector, wherever it was defined,
+ * or nullptr if there is none.
+ */
+std::shared_ptr<const vector<Real>> Calculator::find_vector(
+		const string& name) const {
+	auto v = vectors.find(name);
+	if (v != vectors.end()) {
+		return v->second;
+	}
+
+	return saved ? saved->find_vector(name) : nullptr;
+}
+
+
+/**
+ * Return the partial derivatives of the named function, or an empty
+ * Calc_deriv if they aren't known.
+ */
+Calc_deriv Calculator::find_deriv(const std::string& name) {
+	auto d = derivs.find(name);
+	return (d == derivs.end()) ? Calc_deriv{} : d->second;
+}
+
+
+/**
+ * Return the batch version of the named function, or an empty
+ * Calc_batch if it has none.
+ */
+Calc_batch Calculator::find_batch(const std::string& name) {
+	auto b = batch_funcs.find(name);
+	return (b == batch_funcs.end()) ? Calc_batch{} : b->second;
+}
+
+
+/**
+ * Define a new function, and make it callable like a predefined one.
+ */
+void Calculator::define_fn(const string& name, User_func fn) {
+	auto arity = fn.arity;
+	auto body = std::make_shared<const Node>(fn.body);
+	auto slots = std::max(arity, frame_size(*body));
+
+	funcs[name] = [arity, body, slots](const vector<Real>& args) {
+		if (args.size() != arity) {
+			throw Unsupported_operand{ "invalid number of arguments" };
+		}
+
+		// a call isn't a loop, but calls can nest exponentially deep
+		spend(1);
+
+		Frame frame{ 0, vector<Real>(slots) };
+		std::copy(args.begin(), args.end(), frame.locals.begin());
+
+		return ::evaluate(*body, frame);
+	};
+
+	derivs[name] = [arity, body, slots](const vector<Real>& args) {
+		if (args.size() != arity) {
+			throw Unsupported_operand{ "invalid number of arguments" };
+		}
+
+		spend(1);
+
+		Dual_frame frame{ Dual{ 0 }, vector<Dual>(slots) };
+		for (std::size_t i = 0; i < arity; ++i) {
+			frame.locals[i] = seed(args[i], i, arity);
+		}
+
+		auto result = ::evaluate(*body, frame);
+		result.d.resize(arity);
+
+		return result.d;
+	};
+
+	batch_funcs.erase(name);
+	if (has_impure(fn.body)) {
+		impure.insert(name);
+	} else {
+		impure.erase(name);
+	}
+
+	user_funcs[name] = std::move(fn);
+}
+
+
+/**
+ * Define a name as another Calculator defines it, for a declaration
+ * run on an older copy of this one. It must not be defined here yet.
+ */
+void Calculator::copy_definition(const Calculator& from,
+		const string& name) {
+	if (has_variable(name) || funcs.find(name) != funcs.end()) {
+		throw Redeclaration_of_variable{ "can't redeclare " + name };
+	}
+
+	auto v = from.variables.find(name);
+	if (v != from.variables.end()) {
+		variables[name] = v->second;
+		return;
+	}
+
+	auto elements = from.find_vector(name);
+	if (elements) {
+		vectors[name] = std::move(elements);
+		return;
+	}
+
+	auto f = from.user_funcs.find(name);
+	if (f == from.user_funcs.end()) {
 		throw Variable_not_defined{ "no such variable" };
 	}
 
-	return variables[name];
+	funcs[name] = from.funcs.at(name);
+	derivs[name] = from.derivs.at(name);
+	if (from.impure.count(name)) {
+		impure.insert(name);
+	}
+
+	user_funcs[name] = f->second;
+}
+
+
+/**
+ * Save the session to a file.
+ */
+void Calculator::save(const string& path) const {
+	save_session(path, variables, vectors, saved.get(), user_funcs, prev,
+		results);
+}
+
+
+/**
+ * Replace the session with one saved to a file. The predefined
+ * functions stay as they are; nothing changes if the file can't be
+ * loaded, e.g. because it calls a function which isn't defined.
+ */
+void Calculator::load(const string& path) {
+	auto session = std::make_shared<const Saved_session>(path);
+
+	Calculator loaded{ {}, funcs, derivs, batch_funcs, impure };
+	for (const auto& f : user_funcs) {
+		loaded.funcs.erase(f.first);
+		loaded.derivs.erase(f.first);
+		loaded.impure.erase(f.first);
+	}
+
+	auto link = [&loaded, &path](Node& call, const string& name) {
+		if (loaded.funcs.find(name) == loaded.funcs.end()) {
+			throw File_error{ path + " calls " + name + ", which isn't "
+				"defined" };
+		}
+
+		call.func = loaded.find_fn(name);
+		call.deriv = loaded.find_deriv(name);
+		call.batch = loaded.find_batch(name);
+	};
+
+	// each function comes after those it calls
+	for (std::size_t i = 0; i < session->function_count(); ++i) {
+		auto name = session->function_name(i);
+		if (loaded.funcs.find(name) != loaded.funcs.end()) {
+			throw File_error{ path + " redefines " + name };
+		}
+
+		loaded.define_fn(name, session->function(i, link));
+	}
+
+	loaded.prev = session->previous();
+	loaded.results = session->statistics();
+	loaded.saved = std::move(session);
+
+	*this = std::move(loaded);
+}
+
+
+/**
+ * Return the body of a user-defined function specialized for the
+ * given arguments, for use in place of a call to it. Constant and
+ * other trivial arguments are substituted into the body, which is
+ * then folded; every other argument is evaluated once and stored in
+ * a slot above those used by the caller and the arguments.
+ */
+Node Calculator::inline_fn(const User_func& fn, vector<Node> args) {
+	if (args.size() != fn.arity) {
+		throw Unsupported_operand{ "invalid number of arguments" };
+	}
+
+	auto offset = locals.size();
+	vector<const Node*> simple;
+	for (const auto& a : args) {
+		offset = std::max(offset, frame_size(a));
+		simple.push_back(is_simple(a) ? &a : nullptr);
+	}
+
+	auto body = substitute(fn.body, simple, offset);
+
+	// bind the other arguments, the first one outermost so that
+	// arguments are still evaluated from left to right
+	for (auto i = fn.arity; i > 0; --i) {
+		if (simple[i - 1]) {
+			continue;
+		}
+
+		Node b{ Node_type::bind, 0, offset + i - 1 };
+		b.children.push_back(std::move(args[i - 1]));
+		b.children.push_back(std::move(body));
+		body = std::move(b);
+	}
+
+	fold(body);
+	return body;
+}
+
+
+/**
+ * Is the call in the range [s, e) a sum or product over an index
+ * variable? That is the case when its first argument is a lone name
+ * which isn't a variable already; otherwise it is an ordinary call.
+ * An integral or root is always over an index variable, which hides
+ * any variable with its name.
+ */
+bool Calculator::is_index_form(const Token_iter& s,
+		const Token_iter& e) {
+
+	if (!(is_reducer(s->name) || is_numerical(s->name)) || e - s < 5 ||
+			(s + 2)->type != Token_type::variable ||
+			(s + 3)->type != Token_type::arg_separator) {
+		return false;
+	}
+
+	auto& name = (s + 2)->name;
+	return is_numerical(s->name) || (!find_var(name) &&
+		!find_vector(name) &&
+		std::find(locals.begin(), locals.end(), name) == locals.end());
 }
 
 
 /**
- * Return the result of invoking a predefined function.
+ * Return the predefined function with the given name.
  */
-double Calculator::invoke_fn(const std::string& name,
-		const std::vector<double>& args) {
+Calc_func Calculator::find_fn(const std::string& name,
+		std::size_t column) {
 	if (funcs.find(name) == funcs.end()) {
-		throw Variable_not_defined{ "no such function" };
+		throw located(Variable_not_defined{ "no such function" },
+			column);
 	}
 
-	return funcs[name](args);
+	return funcs[name];
 }
 
 
@@ -313,7 +1316,10 @@ bool is_operator(Token_type t) {
 	return t == Token_type::plus || t == Token_type::minus ||
 		t == Token_type::multiply || t == Token_type::divide ||
 		t == Token_type::assignment || t == Token_type::mod ||
-		t == Token_type::power;
+		t == Token_type::power || t == Token_type::range ||
+		t == Token_type::less || t == Token_type::less_equal ||
+		t == Token_type::greater || t == Token_type::greater_equal ||
+		t == Token_type::equal || t == Token_type::not_equal;
 }
 
 
@@ -326,12 +1332,246 @@ bool is_unary(const Token_iter& curr, const Token_iter& start) {
 
 
 /**
- * Float factorial.
+ * Can the named function stream a range instead of expanding it?
+ */
+bool is_reducer(const string& name) {
+	return name == "sum" || name == "product";
+}
+
+
+/**
+ * Is the named function one that integrates or solves over an index
+ * variable?
+ */
+bool is_numerical(const string& name) {
+	return name == "integrate" || name == "solve";
+}
+
+
+/**
+ * Is the named function one that chooses between values?
+ */
+bool is_conditional(const string& name) {
+	return name == "if" || name == "piecewise";
+}
+
+
+/**
+ * Does the named function take any number of arguments, so that it is
+ * given the elements of a vector rather than called for each?
+ */
+bool is_aggregate(const string& name) {
+	return name == "sum" || name == "product" || name == "average" ||
+		name == "min" || name == "max" || name == "median" ||
+		name == "percentile" || name == "variance";
+}
+
+
+/**
+ * Can an argument be substituted for a parameter without evaluating
+ * it more than once?
+ */
+bool is_simple(const Node& a) {
+	return a.type == Node_type::number || a.type == Node_type::local ||
+		a.type == Node_type::previous;
+}
+
+
+/**
+ * Does an expression call an impure function anywhere?
  */
-double factorial(double n) {
-	using std::tgamma;
+bool has_impure(const Node& n) {
+	return n.impure || std::any_of(n.children.begin(), n.children.end(),
+		[](const Node& c) { return has_impure(c); });
+}
 
-	return tgamma(n + 1);
+
+/**
+ * Does an expression use a vector other than within an each, so that
+ * its value is a vector too?
+ */
+bool has_vector(const Node& n) {
+	return n.type == Node_type::vector || (n.type != Node_type::each &&
+		std::any_of(n.children.begin(), n.children.end(),
+			[](const Node& c) { return has_vector(c); }));
+}
+
+
+/**
+ * Does an expression evaluate anything for the elements of a vector?
+ */
+bool has_each(const Node& n) {
+	return n.type == Node_type::each || std::any_of(n.children.begin(),
+		n.children.end(), [](const Node& c) { return has_each(c); });
+}
+
+
+/**
+ * Does an expression read `_`, or one of the index variables in the
+ * first outer slots, which belong to whatever it is compiled in?
+ */
+bool depends(const Node& n, std::size_t outer) {
+	if (n.type == Node_type::previous ||
+			(n.type == Node_type::local && n.slot < outer)) {
+		return true;
+	}
+
+	return std::any_of(n.children.begin(), n.children.end(),
+		[outer](const Node& c) { return depends(c, outer); });
+}
+
+
+/**
+ * Replace each vector used by an expression, other than within an each
+ * of its own, by an index variable, which the given each binds to it:
+ * the vector is added to the each, in a slot from first up, unless it
+ * is there already. While checking, vectors have no elements to count.
+ */
+void bind_vectors(Node& n, Node& each, std::size_t first,
+		bool checking) {
+	if (n.type == Node_type::each) {
+		return;
+	}
+
+	if (n.type != Node_type::vector) {
+		for (auto& c : n.children) {
+			bind_vectors(c, each, first, checking);
+		}
+		return;
+	}
+
+	auto& bound = each.children;
+	auto v = std::find_if(bound.begin() + 1, bound.end(),
+		[&n](const Node& b) { return b.elements == n.elements; });
+	if (v == bound.end()) {
+		if (bound.size() > 1 && !checking &&
+				n.elements->size() != bound[1].elements->size()) {
+			throw Unsupported_operand{
+				"vectors must have the same number of elements" };
+		}
+
+		n.slot = first + bound.size() - 1;
+		bound.push_back(std::move(n));
+		v = bound.end() - 1;
+	}
+
+	Node local{ Node_type::local, 0, v->slot };
+	local.name = v->name;
+	n = std::move(local);
+}
+
+
+/**
+ * Return a Node applying the given operation to its operand(s).
+ */
+Node operation(Node_type t, Node operand) {
+	Node n{ t };
+	n.children.push_back(std::move(operand));
+
+	return n;
+}
+
+Node operation(Node_type t, Node lhs, Node rhs) {
+	Node n{ t };
+	n.children.reserve(2);
+	n.children.push_back(std::move(lhs));
+	n.children.push_back(std::move(rhs));
+
+	return n;
+}
+
+
+/**
+ * Apply operations, each made without its first operand, one after
+ * another to the first operand, as in ((a + b) - c)!. A chain longer
+ * than chain_segment is split into segments of about the square root
+ * of its length: each is evaluated into a slot above any used by the
+ * operands, from free_slot up, as an inlined argument is, and the next
+ * starts from that slot. The expression is then only about twice that
+ * deep, and can be walked by recursion however long the chain is; the
+ * operations are applied in the same order, to the same values, but a
+ * segment is evaluated before those after it rather than after them.
+ */
+Node link_chain(Node first, vector<Node> links, std::size_t free_slot) {
+	auto count = links.size();
+	auto segment = std::max(chain_segment, static_cast<std::size_t>(
+		std::ceil(std::sqrt(static_cast<double>(count)))));
+
+	auto slot = std::max(free_slot, frame_size(first));
+	if (count > segment) {
+		for (const auto& l : links) {
+			slot = std::max(slot, frame_size(l));
+		}
+	}
+
+	// the last segment first, each one after it held by a bind of it
+	Node rest;
+	for (auto k = (count + segment - 1) / segment; k-- > 0; ) {
+		auto n = (k == 0) ? std::move(first)
+			: Node{ Node_type::local, 0, slot };
+		for (auto i = k * segment; i < std::min(count, (k + 1) * segment);
+				++i) {
+			links[i].children[0] = std::move(n);
+			n = std::move(links[i]);
+		}
+
+		if ((k + 1) * segment >= count) {
+			rest = std::move(n);
+			continue;
+		}
+
+		Node b{ Node_type::bind, 0, slot };
+		b.children.reserve(2);
+		b.children.push_back(std::move(n));
+		b.children.push_back(std::move(rest));
+		rest = std::move(b);
+	}
+
+	return rest;
+}
+
+
+/**
+ * Return the type of Node which applies the given binary operator.
+ */
+Node_type operation_of(Token_type t) {
+	switch (t) {
+	case Token_type::plus:
+		return Node_type::add;
+	case Token_type::minus:
+		return Node_type::subtract;
+	case Token_type::multiply:
+		return Node_type::multiply;
+	case Token_type::divide:
+		return Node_type::divide;
+	case Token_type::mod:
+		return Node_type::mod;
+	case Token_type::power:
+		return Node_type::power;
+	case Token_type::less:
+		return Node_type::less;
+	case Token_type::less_equal:
+		return Node_type::less_equal;
+	case Token_type::greater:
+		return Node_type::greater;
+	case Token_type::greater_equal:
+		return Node_type::greater_equal;
+	case Token_type::equal:
+		return Node_type::equal;
+	default:
+		return Node_type::not_equal;
+	}
+}
+
+
+/**
+ * Are the tokens from start to end a pair of parentheses and what
+ * they enclose?
+ */
+bool encloses(const Token_iter& s, const Token_iter& e) {
+	return e - s >= 2 && s->type == Token_type::p_open &&
+		(e - 1)->type == Token_type::p_close &&
+		static_cast<std::size_t>(e - 1 - s) == (e - 1)->opened;
 }
 
 
@@ -341,9 +1581,12 @@ double factorial(double n) {
  * return the end of the given range.
  * 
  * Also make sure, in case we're finding +/-, they must not be unary.
+ *
+ * Brackets which nest properly are skipped at once, so a search costs
+ * only as much as what isn't nested, however deeply the rest is.
  */
 Token_iter backward_find(const Token_iter& s, const Token_iter& e,
-		const vector<Token_type>& tf) {
+		std::initializer_list<Token_type> tf) {
 
 	using std::find;
 
@@ -354,6 +1597,15 @@ Token_iter backward_find(const Token_iter& s, const Token_iter& e,
 		--i;	// don't put this anywhere in the for-loop
 				// or it'll seek before s, resulting in an exception
 
+		if (i->opened) {
+			if (static_cast<std::size_t>(i - s) < i->opened) {
+				return e;	// opened before s, so the rest is nested
+			}
+
+			i -= i->opened;
+			continue;
+		}
+
 		switch (i->type) {
 		case Token_type::p_close:
 			++nesting;
@@ -372,6 +1624,8 @@ Token_iter backward_find(const Token_iter& s, const Token_iter& e,
 				continue;
 			}
 			break;
+		default:
+			break;
 		}
 
 		if (find(tf.begin(), tf.end(), i->type) != tf.end() && 
@@ -7,8 +7,8 @@
  * calc-cli is a command-line calculator.
  *
  * calculator.hpp declares the Calculator class that stores
- * calculator state, and provides methods for parsing input and
- * performing calculations.
+ * calculator state, and provides methods for compiling input into
+ * Nodes and performing calculations.
  * 
  * See calculator.hpp for the grammar used to parse the input.
  */
@@ -16,68 +16,269 @@
 
 #include <vector>
 #include <map>
+#include <set>
 #include <string>
-#include <functional>
+#include <memory>
+#include <utility>
+#include <initializer_list>
 
 #include "token/token.hpp"
+#include "node/node.hpp"
+#include "dual/dual.hpp"
+#include "stats/stats.hpp"
+#include "saved/saved.hpp"
 
 
 using Token_iter = std::vector<Token>::const_iterator;
-using Calc_func = std::function<double(const std::vector<double>&)>;
 
 
 class Calculator {
 public:
-	Calculator(const std::map<std::string, double>& consts={},
-			const std::map<std::string, Calc_func>& functions={})
-				:variables{ consts }, funcs{ functions } {
+	Calculator(const std::map<std::string, Real>& consts={},
+			const std::map<std::string, Calc_func>& functions={},
+			const std::map<std::string, Calc_deriv>& derivatives={},
+			const std::map<std::string, Calc_batch>& batches={},
+			const std::set<std::string>& impure_functions={})
+				:variables{ consts }, funcs{ functions },
+				derivs{ derivatives }, batch_funcs{ batches },
+				impure{ impure_functions } {
 	}
 
-	double evaluate(std::string input) {
+	Real evaluate(std::string input) {
 		auto tokens = tokenize(input);
+		set_input(tokens, input);
 		return statement(tokens.begin(), tokens.end());
 	}
 
+	// parse a statement without evaluating anything, throwing what
+	// evaluate would for bad syntax, unknown names or a wrong number
+	// of arguments, located at a column; what it declares is declared
+	// with no value. The given names are index variables, as for
+	// compile
+	void check(std::string input,
+		const std::map<std::string, Arity>& arities,
+		const std::vector<std::string>& params={});
+
+	// compile an expression once, to be evaluated any number of times;
+	// the given names are index variables in slots 0, 1, ...
+	Node compile(std::string input,
+		const std::vector<std::string>& params={});
+
+	// evaluate a compiled expression, counting it in the statistics as
+	// evaluating the input would; if its value is a vector, `_` and
+	// the statistics are left as they were
+	Real evaluate(const Node& expression);
+
+	Dual differentiate(std::string input,
+		const std::vector<std::string>& wrt);
+
+	// whether there is a variable, its value a number or a vector,
+	// with the name
+	bool has_variable(const std::string& name) const {
+		return find_var(name) || find_vector(name);
+	}
+
+	// the value of `_`
+	Real previous() const {
+		return prev;
+	}
+
+	void set_previous(Real value) {
+		prev = value;
+	}
+
+	// the elements of the value of the last statement or expression
+	// evaluated, if it was a vector, or nullptr
+	std::shared_ptr<const std::vector<Real>> vector_result() const {
+		return shown;
+	}
+
+	void set_vector_result(std::shared_ptr<const std::vector<Real>> v) {
+		shown = std::move(v);
+	}
+
+	// the function the last statement defined, as in f[x, y], or ""
+	// if it wasn't a function declaration
+	const std::string& function_result() const {
+		return defined;
+	}
+
+	void set_function_result(std::string f) {
+		defined = std::move(f);
+	}
+
+	// a summary of the value of every expression evaluated from input,
+	// other than declarations
+	const Running_stats& statistics() const {
+		return results;
+	}
+
+	void set_statistics(const Running_stats& stats) {
+		results = stats;
+	}
+
+	// write the variables, user-defined functions, `_` and statistics
+	// to a file, from which this build can load them
+	void save(const std::string& path) const;
+
+	// replace them with those saved in a file; the functions are linked
+	// to the predefined ones, and the variables are read from the file
+	// where it is mapped, when they are used
+	void load(const std::string& path);
+
+	// define a name as another Calculator defines it, where it isn't
+	// defined yet
+	void copy_definition(const Calculator& from,
+		const std::string& name);
+
 private:
-	double statement(const Token_iter& start, const Token_iter& end);
+	Real statement(const Token_iter& start, const Token_iter& end);
 
-	double declaration(const Token_iter& start,
+	Real declaration(const Token_iter& start,
 		const Token_iter& end);
 
-	double expression(const Token_iter& start,
+	Real function_declaration(const Token_iter& start,
 		const Token_iter& end);
+
+	Node outermost(const Token_iter& start, const Token_iter& end);
+
+	Node vector_literal(const Token_iter& start, const Token_iter& end);
+
+	Node elementwise(Node body);
+
+	Node comparison(const Token_iter& start, const Token_iter& end);
+
+	Node expression(const Token_iter& start, const Token_iter& end);
 	
-	double term(const Token_iter& start, const Token_iter& end);
+	Node term(const Token_iter& start, const Token_iter& end);
 	
-	double unary(const Token_iter& start, const Token_iter& end);
+	Node unary(const Token_iter& start, const Token_iter& end);
 	
-	double power(const Token_iter& start, const Token_iter& end);
+	Node power(const Token_iter& start, const Token_iter& end);
 	
-	double primary(const Token_iter& start, const Token_iter& end);
+	Node primary(const Token_iter& start, const Token_iter& end);
+
+	Node number(const Token_iter& start, const Token_iter& end);
 
-	double number(const Token_iter& start, const Token_iter& end);
+	Node call(const Token_iter& start, const Token_iter& end);
 
-	double call(const Token_iter& start, const Token_iter& end);
+	Node reduction(const Token_iter& start, const Token_iter& end);
+
+	Node conditional(const Token_iter& name, std::vector<Node> args);
 	
-	std::vector<double> arguments(const Token_iter& start,
+	std::vector<Node> arguments(const Token_iter& start,
+		const Token_iter& end);
+
+	Node argument(const Token_iter& start, const Token_iter& end);
+
+	using Grammar_rule = Node (Calculator::*)(const Token_iter& start,
 		const Token_iter& end);
 
+	Node chain(const Token_iter& start, const Token_iter& end,
+		std::initializer_list<Token_type> operators, Grammar_rule operand);
+
+	Real run(const Node& expression);
+
+	std::shared_ptr<const std::vector<Real>> run_vector(
+		const Node& expression);
+
+
+	// the end of the tokens being compiled, and the column just past
+	// the input, to locate errors found there
+	Token_iter input_end;
+	std::size_t end_column = 0;
+
+	void set_input(const std::vector<Token>& tokens,
+		const std::string& input);
+	std::size_t column_of(const Token_iter& i) const;
+
+
+	// while checking, the arities of the predefined functions; calls
+	// are then neither inlined nor folded
+	const std::map<std::string, Arity>* checked = nullptr;
+
+	bool checking() const {
+		return checked != nullptr;
+	}
+
+	void check_arity(const Token_iter& name, std::size_t count);
+
 
 	// result of the previous calculation
-	double prev{};
+	Real prev{};
+
+	// its elements, if it was a vector
+	std::shared_ptr<const std::vector<Real>> shown;
+
+	// the function it defined instead, if any
+	std::string defined;
+
+	Running_stats results;
 
 	
-	std::map<std::string, double> variables;
+	std::map<std::string, Real> variables;
+
+	// variables loaded from a file, besides those in variables; it is
+	// shared by copies of this Calculator
+	std::shared_ptr<const Saved_session> saved;
+
+	const Real* find_var(const std::string& name) const;
+
+	void define_var(const std::string& name, Real value,
+		std::size_t column = 0);
+	Real evaluate_var(const std::string& name, std::size_t column = 0);
 
-	void define_var(const std::string& name, double value);
-	double evaluate_var(const std::string& name);
 
+	// variables whose values are vectors; their elements never change,
+	// so they are shared by copies of this Calculator and by the
+	// expressions using them
+	std::map<std::string, std::shared_ptr<const std::vector<Real>>>
+		vectors;
 
-	// predefined functions
+	std::shared_ptr<const std::vector<Real>> find_vector(
+		const std::string& name) const;
+
+	void define_vector(const std::string& name,
+		std::shared_ptr<const std::vector<Real>> elements,
+		std::size_t column = 0);
+
+
+	// index variables bound by the reductions being compiled,
+	// innermost last; a variable's position is its slot in the Frame
+	std::vector<std::string> locals;
+
+	bool is_index_form(const Token_iter& start, const Token_iter& end);
+
+
+	// predefined functions, and a Calc_func for every user-defined
+	// function
 	std::map<std::string, Calc_func> funcs;
 
-	double invoke_fn(const std::string& name,
-		const std::vector<double>& args);
+	Calc_func find_fn(const std::string& name, std::size_t column = 0);
+
+
+	// partial derivatives of those functions in funcs which have them
+	std::map<std::string, Calc_deriv> derivs;
+
+	Calc_deriv find_deriv(const std::string& name);
+
+
+	// batch versions of those functions in funcs which have them
+	std::map<std::string, Calc_batch> batch_funcs;
+
+	Calc_batch find_batch(const std::string& name);
+
+
+	// functions in funcs whose calls must not be folded
+	std::set<std::string> impure;
+
+
+	// user-defined functions, kept compiled so that calls to them can
+	// be inlined
+	std::map<std::string, User_func> user_funcs;
+
+	void define_fn(const std::string& name, User_func fn);
+	Node inline_fn(const User_func& fn, std::vector<Node> args);
 };
 
 
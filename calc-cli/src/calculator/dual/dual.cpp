@@ -0,0 +1,437 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * dual.cpp defines the functions from dual.hpp. Every operation
+ * computes its value as evaluate does for doubles, and its partial
+ * derivatives by the chain rule.
+ */
+
+
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "dual.hpp"
+#include "../limits/limits.hpp"
+#include "../numeric/numeric.hpp"
+#include "../polynomial/polynomial.hpp"
+#include "../exceptions/exceptions.hpp"
+
+
+using std::vector;
+
+using ull = unsigned long long;
+
+
+Dual chain(Real value, const Dual& x, Real dx);
+Dual chain(Real value, const Dual& x, Real dx, const Dual& y,
+	Real dy);
+
+Dual call(const Node& call, Dual_frame& frame);
+Dual reduce(const Node& reduction, Dual_frame& frame);
+Dual integrate(const Node& integral, Dual_frame& frame);
+Dual solve(const Node& root, Dual_frame& frame);
+
+Frame values(const Dual_frame& frame);
+
+
+/**
+ * Return the value and partial derivatives of a compiled expression.
+ */
+Dual evaluate(const Node& n, Dual_frame& f) {
+	using std::pow;
+	using std::fmod;
+	using std::log;
+	using std::tgamma;
+	using std::trunc;
+
+	switch (n.type) {
+	case Node_type::number:
+		return Dual{ n.value };
+	case Node_type::previous:
+		return f.prev;
+	case Node_type::local:
+		return f.locals[n.slot];
+	case Node_type::negate: {
+		auto x = evaluate(n.children[0], f);
+		return chain(-x.value, x, -1);
+	}
+	case Node_type::add:
+	case Node_type::subtract: {
+		auto x = evaluate(n.children[0], f);
+		auto y = evaluate(n.children[1], f);
+		if (n.type == Node_type::add) {
+			return chain(x.value + y.value, x, 1, y, 1);
+		}
+
+		return chain(x.value - y.value, x, 1, y, -1);
+	}
+	case Node_type::multiply: {
+		auto x = evaluate(n.children[0], f);
+		auto y = evaluate(n.children[1], f);
+		return chain(x.value * y.value, x, y.value, y, x.value);
+	}
+	case Node_type::divide:
+	case Node_type::mod: {
+		auto y = evaluate(n.children[1], f);
+		if (y.value == 0) {
+			throw Unsupported_operand{ "Can't divide or mod by 0." };
+		}
+
+		auto x = evaluate(n.children[0], f);
+		if (n.type == Node_type::divide) {
+			auto q = x.value / y.value;
+			return chain(q, x, 1 / y.value, y, -q / y.value);
+		}
+
+		// fmod(x, y) = x - trunc(x / y) * y
+		return chain(fmod(x.value, y.value), x, 1,
+			y, -trunc(x.value / y.value));
+	}
+	case Node_type::power: {
+		auto x = evaluate(n.children[0], f);
+		auto y = evaluate(n.children[1], f);
+		auto v = pow(x.value, y.value);
+
+		auto dx = (y.value == 0) ? 0
+			: y.value * pow(x.value, y.value - 1);
+		auto dy = y.d.empty() ? 0 : v * log(x.value);
+
+		return chain(v, x, dx, y, dy);
+	}
+	case Node_type::factorial: {
+		// d/dx gamma(x + 1) = gamma(x + 1) * digamma(x + 1)
+		auto x = evaluate(n.children[0], f);
+		auto v = tgamma(x.value + 1);
+		auto dx = x.d.empty() ? 0 : v * digamma(x.value + 1);
+		return chain(v, x, dx);
+	}
+	case Node_type::less:
+	case Node_type::less_equal:
+	case Node_type::greater:
+	case Node_type::greater_equal:
+	case Node_type::equal:
+	case Node_type::not_equal: {
+		// a comparison is constant wherever it doesn't jump, so its
+		// derivatives are 0
+		auto x = evaluate(n.children[0], f).value;
+		auto y = evaluate(n.children[1], f).value;
+		switch (n.type) {
+		case Node_type::less:
+			return Dual{ static_cast<Real>(x < y) };
+		case Node_type::less_equal:
+			return Dual{ static_cast<Real>(x <= y) };
+		case Node_type::greater:
+			return Dual{ static_cast<Real>(x > y) };
+		case Node_type::greater_equal:
+			return Dual{ static_cast<Real>(x >= y) };
+		case Node_type::equal:
+			return Dual{ static_cast<Real>(x == y) };
+		default:
+			return Dual{ static_cast<Real>(x != y) };
+		}
+	}
+	case Node_type::select:
+		// the derivatives of the value chosen
+		if (evaluate(n.children[0], f).value != 0) {
+			return evaluate(n.children[1], f);
+		}
+		return evaluate(n.children[2], f);
+	case Node_type::call:
+		return call(n, f);
+	case Node_type::sum:
+	case Node_type::product:
+		return reduce(n, f);
+	case Node_type::integral:
+		return integrate(n, f);
+	case Node_type::root:
+		return solve(n, f);
+	case Node_type::bind:
+		f.locals[n.slot] = evaluate(n.children[0], f);
+		return evaluate(n.children[1], f);
+	case Node_type::polynomial: {
+		auto x = evaluate(n.children[0], f);
+		return chain(polynomial(n, x.value), x, slope(n, x.value));
+	}
+	case Node_type::vector:
+	case Node_type::each:
+		throw Unsupported_operand{ "a vector isn't a number" };
+	default:
+		throw Syntax_error{ "a range is only allowed as an argument" };
+	}
+}
+
+
+/**
+ * Return the Dual of an independent variable: its derivative with
+ * respect to itself, the index-th of count variables, is 1.
+ */
+Dual seed(Real value, std::size_t index, std::size_t count) {
+	Dual x{ value, vector<Real>(count) };
+	x.d[index] = 1;
+
+	return x;
+}
+
+
+/**
+ * Return the digamma function, the derivative of ln(gamma(x)).
+ */
+Real digamma(Real x) {
+	using std::floor;
+	using std::log;
+	using std::tan;
+	using std::acos;
+
+	if (x <= 0 && floor(x) == x) {		// poles of the gamma function
+		return std::numeric_limits<Real>::quiet_NaN();
+	}
+
+	if (x < 0) {	// reflection formula
+		auto pi = acos(Real{ -1 });
+		return digamma(1 - x) - pi / tan(pi * x);
+	}
+
+	// move x up to where the asymptotic series is accurate
+	Real r = 0;
+	for (; x < 6; x += 1) {
+		r -= 1 / x;
+	}
+
+	auto f = 1 / (x * x);
+	return r + log(x) - 0.5 / x - f * (1.0 / 12 - f * (1.0 / 120 -
+		f * (1.0 / 252 - f * (1.0 / 240 - f / 132))));
+}
+
+
+/**
+ * Return a Dual with the given value whose derivatives are dx times
+ * those of x. A derivative of x which is 0 stays 0, even where dx is
+ * infinite or NaN, as that of sqrt[x] or x ^ y is at x = 0: the value
+ * doesn't depend on that variable through x at all.
+ */
+Dual chain(Real value, const Dual& x, Real dx) {
+	Dual r{ value, x.d };
+	for (auto& d : r.d) {
+		if (d != 0) {
+			d *= dx;
+		}
+	}
+
+	return r;
+}
+
+
+/**
+ * Return a Dual with the given value whose derivatives are dx times
+ * those of x plus dy times those of y, leaving out the terms whose
+ * derivative of x or y is 0, as above.
+ */
+Dual chain(Real value, const Dual& x, Real dx, const Dual& y,
+		Real dy) {
+
+	Dual r{ value, vector<Real>(std::max(x.d.size(), y.d.size())) };
+	for (std::size_t i = 0; i < x.d.size(); ++i) {
+		if (x.d[i] != 0) {
+			r.d[i] += dx * x.d[i];
+		}
+	}
+	for (std::size_t i = 0; i < y.d.size(); ++i) {
+		if (y.d[i] != 0) {
+			r.d[i] += dy * y.d[i];
+		}
+	}
+
+	return r;
+}
+
+
+/**
+ * Differentiate a function call using the function's partial
+ * derivatives. A range argument is expanded into constants, and an
+ * each into its body at every element, whose vectors are constants.
+ */
+Dual call(const Node& c, Dual_frame& f) {
+	Memory_hold held;
+	vector<Dual> args;
+	for (const auto& arg : c.children) {
+		if (arg.type == Node_type::each) {
+			auto count = arg.children[1].elements->size();
+			spend(count);
+			held.add(count, sizeof(Dual));
+
+			for (std::size_t i = 0; i < count; ++i) {
+				for (std::size_t v = 1; v < arg.children.size(); ++v) {
+					const auto& bound = arg.children[v];
+					f.locals[bound.slot] = Dual{ (*bound.elements)[i] };
+				}
+				args.push_back(evaluate(arg.children[0], f));
+			}
+			continue;
+		}
+
+		if (arg.type != Node_type::range) {
+			args.push_back(evaluate(arg, f));
+			continue;
+		}
+
+		auto lo = evaluate(arg.children[0], f).value;
+		auto count = steps(lo, evaluate(arg.children[1], f).value);
+		spend(count);
+		held.add(count, sizeof(Dual));
+
+		// without a memory limit, a range too large to hold fails here
+		try {
+			args.reserve(args.size() + static_cast<std::size_t>(count));
+		} catch (std::exception&) {		// bad_alloc or length_error
+			throw Unsupported_operand{ "range too large" };
+		}
+
+		for (ull i = 0; i < count; ++i) {
+			args.push_back(Dual{ lo + i });
+		}
+	}
+
+	vector<Real> values;
+	std::size_t size = 0;
+	for (const auto& a : args) {
+		values.push_back(a.value);
+		size = std::max(size, a.d.size());
+	}
+
+	Dual r{ c.func(values) };
+	if (size == 0) {	// all arguments are constants
+		return r;
+	}
+
+	if (!c.deriv) {
+		throw Unsupported_operand{ "can't differentiate this function" };
+	}
+
+	auto partial = c.deriv(values);
+	r.d.resize(size);
+	for (std::size_t i = 0; i < args.size(); ++i) {
+		for (std::size_t j = 0; j < args[i].d.size(); ++j) {
+			if (args[i].d[j] != 0) {	// as in chain
+				r.d[j] += partial[i] * args[i].d[j];
+			}
+		}
+	}
+
+	return r;
+}
+
+
+/**
+ * Differentiate a sum or product. The index variable is a constant;
+ * the bounds only decide how many terms there are.
+ */
+Dual reduce(const Node& r, Dual_frame& f) {
+	auto lo = evaluate(r.children[0], f).value;
+	auto count = steps(lo, evaluate(r.children[1], f).value);
+
+	const auto& body = r.children[2];
+	Dual acc{ (r.type == Node_type::sum) ? Real{ 0 } : Real{ 1 } };
+	for (ull i = 0; i < count; ++i) {
+		spend(1);
+		f.locals[r.slot] = Dual{ lo + i };
+		auto term = evaluate(body, f);
+
+		if (r.type == Node_type::sum) {
+			acc = chain(acc.value + term.value, acc, 1, term, 1);
+		} else {
+			acc = chain(acc.value * term.value, acc, term.value,
+				term, acc.value);
+		}
+	}
+
+	return acc;
+}
+
+
+/**
+ * Differentiate an integral by Leibniz's rule: the derivatives of the
+ * integrand are integrated over the same pieces as its value was, and
+ * the integrand at each bound is added times that bound's
+ * derivatives.
+ */
+Dual integrate(const Node& n, Dual_frame& f) {
+	auto lo = evaluate(n.children[0], f);
+	auto hi = evaluate(n.children[1], f);
+
+	auto frame = values(f);
+	vector<std::pair<Real, Real>> pieces;
+	auto value = integrate(n, frame, false, &pieces);
+
+	const auto& body = n.children[2];
+	Dual acc{ 0 };
+	Real points[rule_points];
+	Real weights[rule_points];
+	for (const auto& p : pieces) {
+		rule(p.first, p.second, points, weights);
+		spend(rule_points);
+
+		for (std::size_t i = 0; i < rule_points; ++i) {
+			f.locals[n.slot] = Dual{ points[i] };
+			auto y = evaluate(body, f);
+			acc = chain(acc.value + weights[i] * y.value, acc, 1, y,
+				weights[i]);
+		}
+	}
+
+	for (const auto* bound : { &hi, &lo }) {
+		if (!bound->d.empty()) {
+			f.locals[n.slot] = Dual{ bound->value };
+			auto y = evaluate(body, f).value;
+			acc = chain(acc.value, acc, 1, *bound, (bound == &hi) ? y : -y);
+		}
+	}
+
+	// the same value as evaluating it gives
+	acc.value = value;
+	return acc;
+}
+
+
+/**
+ * Differentiate a root x of g = 0, where g depends on other variables
+ * too. By the implicit function theorem, the derivatives of x are
+ * those of g, with x held constant, divided by -dg/dx.
+ */
+Dual solve(const Node& n, Dual_frame& f) {
+	auto frame = values(f);
+	auto x = solve(n, frame);
+
+	// x is seeded after every variable being differentiated
+	auto count = f.prev.d.size();
+	for (const auto& l : f.locals) {
+		count = std::max(count, l.d.size());
+	}
+
+	f.locals[n.slot] = seed(x, count, count + 1);
+	auto g = evaluate(n.children[2], f);
+
+	Dual r{ x };
+	if (g.d.size() > count) {
+		r.d.resize(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			r.d[i] = -g.d[i] / g.d[count];
+		}
+	}
+
+	return r;
+}
+
+
+/**
+ * Return a Frame holding the values of a Dual_frame.
+ */
+Frame values(const Dual_frame& f) {
+	Frame frame{ f.prev.value, vector<Real>(f.locals.size()) };
+	for (std::size_t i = 0; i < f.locals.size(); ++i) {
+		frame.locals[i] = f.locals[i].value;
+	}
+
+	return frame;
+}
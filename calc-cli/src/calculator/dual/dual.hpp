@@ -0,0 +1,43 @@
+#pragma once
+#ifndef CALC_CLI_DUAL_HPP
+#define CALC_CLI_DUAL_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * dual.hpp declares the Dual type, a value together with its partial
+ * derivatives, and the evaluate function that computes a compiled
+ * expression over Duals (forward-mode automatic differentiation).
+ */
+
+
+#include <vector>
+
+#include "../node/node.hpp"
+
+
+struct Dual {
+	Real value = 0;
+	std::vector<Real> d{};		// partial derivatives; missing trailing
+							// entries are 0, so constants have none
+};
+
+
+/**
+ * Values an expression may read while it is differentiated.
+ */
+struct Dual_frame {
+	Dual prev;					// value of `_`
+	std::vector<Dual> locals;	// current values of index variables
+};
+
+
+Dual evaluate(const Node& node, Dual_frame& frame);
+
+Dual seed(Real value, std::size_t index, std::size_t count);
+
+Real digamma(Real x);
+
+
+#endif // !CALC_CLI_DUAL_HPP
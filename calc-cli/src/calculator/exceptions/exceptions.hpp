@@ -5,6 +5,7 @@
 
 #include <stdexcept>
 #include <string>
+#include <cstddef>
 
 
 class Calc_cli_exception : public std::exception {
@@ -17,8 +18,22 @@ public:
 		return err.c_str();
 	}
 
+	// where in the input the problem is, counting from 1; 0 if that
+	// isn't known
+	std::size_t column() const noexcept {
+		return col;
+	}
+
+	// record where the problem is, unless that is known already
+	void locate(std::size_t column) noexcept {
+		if (col == 0) {
+			col = column;
+		}
+	}
+
 private:
 	std::string err;
+	std::size_t col = 0;
 };
 
 class Unbalanced_parentheses : public Calc_cli_exception {
@@ -49,6 +64,15 @@ class Variable_not_defined : public Calc_cli_exception {
 	using Calc_cli_exception::Calc_cli_exception;
 };
 
+class File_error : public Calc_cli_exception {
+	using Calc_cli_exception::Calc_cli_exception;
+};
+
+// an input went over one of the limits set with --limit
+class Limit_exceeded : public Calc_cli_exception {
+	using Calc_cli_exception::Calc_cli_exception;
+};
+
 
 
 #endif // !CACL_CLI_EXCEPTIONS_HPP
@@ -0,0 +1,131 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * limits.cpp defines the limits and Evaluation_budget from
+ * limits.hpp.
+ */
+
+
+#include <limits>
+#include <string>
+#include <cstdlib>
+
+#include "limits.hpp"
+#include "../exceptions/exceptions.hpp"
+
+
+using std::string;
+
+using ull = unsigned long long;
+
+
+// the clock is read whenever this many steps more have been spent
+constexpr ull clock_interval = 256;
+
+
+Limits limits;
+
+thread_local Evaluation_budget* budget = nullptr;
+
+
+/**
+ * Set one limit from a setting of the form name=value, e.g. time=0.5;
+ * the names are input, tokens, depth, time (in seconds), steps and
+ * memory (in MiB). Return false if the setting isn't understood.
+ */
+bool set_limit(const string& setting) {
+	auto equals = setting.find('=');
+	if (equals == string::npos || equals + 1 == setting.size()) {
+		return false;
+	}
+
+	auto name = setting.substr(0, equals);
+	auto text = setting.c_str() + equals + 1;
+
+	char* end;
+	auto value = std::strtod(text, &end);
+	if (*end != '\0' || !(value >= 0) ||
+			value > static_cast<double>(std::numeric_limits<ull>::max())) {
+		return false;
+	}
+
+	auto count = static_cast<ull>(value);
+	if (name == "input") {
+		limits.input = static_cast<std::size_t>(count);
+	} else if (name == "tokens") {
+		limits.tokens = static_cast<std::size_t>(count);
+	} else if (name == "depth") {
+		limits.depth = static_cast<std::size_t>(count);
+	} else if (name == "time") {
+		limits.seconds = value;
+	} else if (name == "steps") {
+		limits.steps = count;
+	} else if (name == "memory") {
+		limits.memory = static_cast<std::size_t>(value * (1 << 20));
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+
+Evaluation_budget::Evaluation_budget() {
+	if ((limits.seconds <= 0 && limits.steps == 0 &&
+			limits.memory == 0) || budget) {
+		return;
+	}
+
+	active = true;
+	deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(limits.seconds));
+	budget = this;
+}
+
+
+Evaluation_budget::~Evaluation_budget() {
+	if (active) {
+		budget = nullptr;
+	}
+}
+
+
+/**
+ * Count steps against the budget, throwing Limit_exceeded if it has
+ * run out of steps or time. The clock is only read every
+ * clock_interval steps.
+ */
+void Evaluation_budget::spend(ull steps) {
+	auto before = spent.fetch_add(steps);
+	auto after = before + steps;
+
+	if (limits.steps > 0 && (after > limits.steps || after < before)) {
+		throw Limit_exceeded{ "too many steps" };
+	}
+
+	if (limits.seconds > 0 && before / clock_interval !=
+			after / clock_interval && Clock::now() > deadline) {
+		throw Limit_exceeded{ "out of time" };
+	}
+}
+
+
+/**
+ * Count count values of the given size against the memory the
+ * evaluation may hold at once, throwing Limit_exceeded if they would
+ * go over it.
+ */
+void Evaluation_budget::hold(ull count, std::size_t size) {
+	auto most = std::numeric_limits<std::size_t>::max();
+	if (count > most / size) {
+		throw Limit_exceeded{ "needs too much memory" };
+	}
+
+	auto bytes = static_cast<std::size_t>(count) * size;
+	auto before = held.fetch_add(bytes);
+	if (limits.memory > 0 && (before + bytes > limits.memory ||
+			before + bytes < before)) {
+		held -= bytes;
+		throw Limit_exceeded{ "needs too much memory" };
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+#ifndef CALC_CLI_LIMITS_HPP
+#define CALC_CLI_LIMITS_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * limits.hpp declares the limits on what one input may use, so that
+ * a single pathological input can't stall a calculator or exhaust its
+ * stack or memory, and the Evaluation_budget which enforces those
+ * limits on evaluation.
+ *
+ * The size of an input is checked by tokenize, before anything is
+ * parsed. Evaluation is checked where it can take time or memory out
+ * of proportion to the size of the input: at every block of values of
+ * an index variable, at every range expanded into arguments and at
+ * every call to a user-defined function which wasn't inlined. Going
+ * over a limit throws Limit_exceeded.
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstddef>
+
+
+// limits on each input; 0 is no limit
+struct Limits {
+	std::size_t input = 0;			// characters
+	std::size_t tokens = 0;
+	std::size_t depth = 0;			// nesting of parentheses and brackets
+	double seconds = 0;				// time spent evaluating
+	unsigned long long steps = 0;	// values of index variables and
+									// ranges, and calls to user-defined
+									// functions
+	std::size_t memory = 0;			// bytes held at once by ranges
+									// expanded into arguments
+};
+
+
+// set before anything is evaluated
+extern Limits limits;
+
+// however the limits are set, input may nest no deeper than this, so
+// that compiling it can't overflow the stack
+constexpr std::size_t max_depth = 1000;
+
+// nor may a compiled expression have operations nested deeper than
+// this, as inlined functions nested in each other can, so that
+// evaluating it can't; a chain such as 1 + 2 + ... + n is compiled in
+// segments, and is only about twice the square root of n deep. Both
+// allow for a stack of 8 MiB, as on Linux, which the project file sets
+// for Windows as well
+constexpr std::size_t max_nesting = 10000;
+
+bool set_limit(const std::string& setting);
+
+
+/**
+ * The time, steps and memory one evaluation may still use, from being
+ * constructed to being destroyed. It does nothing unless one of those
+ * is limited, or if another budget is under way on the same thread,
+ * which the evaluation is then counted against instead. Threads which
+ * evaluate part of it share it.
+ */
+class Evaluation_budget {
+public:
+	Evaluation_budget();
+	~Evaluation_budget();
+
+	Evaluation_budget(const Evaluation_budget&) = delete;
+	Evaluation_budget& operator=(const Evaluation_budget&) = delete;
+
+	void spend(unsigned long long steps);
+
+	void hold(unsigned long long count, std::size_t size);
+	void release(std::size_t bytes) {
+		held -= bytes;
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	bool active = false;
+	Clock::time_point deadline;
+	std::atomic<unsigned long long> spent{ 0 };
+	std::atomic<std::size_t> held{ 0 };
+};
+
+
+// the budget under way on this thread, if any
+extern thread_local Evaluation_budget* budget;
+
+
+/**
+ * Count the given number of steps against the budget under way on
+ * this thread, if any.
+ */
+inline void spend(unsigned long long steps) {
+	if (budget) {
+		budget->spend(steps);
+	}
+}
+
+
+/**
+ * Memory held for the budget under way on this thread, if any, until
+ * it is destroyed.
+ */
+class Memory_hold {
+public:
+	Memory_hold()
+			:held_for{ budget } {
+	}
+
+	~Memory_hold() {
+		if (held_for) {
+			held_for->release(bytes);
+		}
+	}
+
+	Memory_hold(const Memory_hold&) = delete;
+	Memory_hold& operator=(const Memory_hold&) = delete;
+
+	// hold count values of the given size more, throwing
+	// Limit_exceeded, before anything is allocated, if they would go
+	// over the limit
+	void add(unsigned long long count, std::size_t size) {
+		if (held_for) {
+			held_for->hold(count, size);
+			bytes += static_cast<std::size_t>(count) * size;
+		}
+	}
+
+private:
+	Evaluation_budget* held_for;
+	std::size_t bytes = 0;
+};
+
+
+#endif // !CALC_CLI_LIMITS_HPP
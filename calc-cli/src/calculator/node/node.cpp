@@ -0,0 +1,1158 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * node.cpp defines the evaluate function and the Node rewriting
+ * helpers from node.hpp.
+ */
+
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <utility>
+
+#include "node.hpp"
+#include "../pool/pool.hpp"
+#include "../limits/limits.hpp"
+#include "../numeric/numeric.hpp"
+#include "../profile/profile.hpp"
+#include "../polynomial/polynomial.hpp"
+#include "../exceptions/exceptions.hpp"
+
+
+using std::vector;
+
+using ull = unsigned long long;
+
+
+template <bool profiled>
+Real evaluate(const Node& node, Frame& frame);
+Real factorial(Real n);
+
+vector<Real> arguments(const Node& call, Frame& frame,
+	Memory_hold& held);
+void expand(const Node& range, Frame& frame, vector<Real>& args,
+	Memory_hold& held);
+void expand_each(const Node& each, Frame& frame, vector<Real>& args,
+	Memory_hold& held);
+bool is_expanded(const Node& argument);
+void evaluate_columns(const Node& node, Frame& frame,
+	const vector<std::size_t>& slots, const vector<const Real*>& values,
+	std::size_t count, Real* out, bool parallel);
+
+bool is_chain(Node_type type);
+bool is_pure(const Node& node);
+Real evaluate_parallel(const Node& node, Frame& frame);
+template <typename Work>
+void for_each_task(std::size_t count, const Frame& frame, Work work);
+
+Real reduce(const Node& reduction, Frame& frame);
+Real reduce(const Node& reduction, Frame& frame, Real lo,
+	ull first, ull last);
+Real reduce_parallel(const Node& reduction, const Frame& frame,
+	Real lo, ull count);
+
+void select_block(const Node& select, Frame& frame,
+	const Real* const* columns, std::size_t count, Real* out,
+	Real* scratch);
+
+
+// reductions with at least this many steps are split across threads
+constexpr ull parallel_threshold = 1 << 16;
+
+// number of segments a parallel reduction is split into; partial
+// results are always combined in segment order, so the result
+// doesn't depend on how many threads were used
+constexpr std::size_t reduction_segments = 64;
+
+// is this thread already evaluating part of a parallel reduction?
+thread_local bool in_worker = false;
+
+// reductions shorter than this are always evaluated one step at a
+// time
+constexpr ull block_threshold = 16;
+
+// the operands of an operation or the arguments of a call are
+// evaluated concurrently when their estimated cost, in units of about
+// one arithmetic operation, is at least this
+constexpr double parallel_cost = 1 << 16;
+
+// the estimated cost of calling a predefined function, on top of
+// evaluating its arguments
+constexpr double call_cost = 16;
+
+
+/**
+ * Return the value of a compiled expression.
+ */
+Real evaluate(const Node& n, Frame& f) {
+	// the profiler is checked here, rather than at every Node, so that
+	// it costs nothing while it's off
+	if (profile_enabled && recording) {
+		return evaluate<true>(n, f);
+	}
+
+	return evaluate<false>(n, f);
+}
+
+
+/**
+ * Return the value of a compiled expression, recording the time of
+ * every Node if profiled.
+ */
+template <bool profiled>
+Real evaluate(const Node& n, Frame& f) {
+	using std::pow;
+	using std::fmod;
+
+	Profile_scope scope{ n, 1, profiled };
+	auto value = [&f](const Node& operand) {
+		return evaluate<profiled>(operand, f);
+	};
+
+	if (n.parallel && !in_worker && !recording) {
+		return evaluate_parallel(n, f);
+	}
+
+	switch (n.type) {
+	case Node_type::number:
+		return n.value;
+	case Node_type::previous:
+		return f.prev;
+	case Node_type::local:
+		return f.locals[n.slot];
+	case Node_type::negate:
+		return -value(n.children[0]);
+	case Node_type::add:
+		return value(n.children[0]) + value(n.children[1]);
+	case Node_type::subtract:
+		return value(n.children[0]) - value(n.children[1]);
+	case Node_type::multiply:
+		return value(n.children[0]) * value(n.children[1]);
+	case Node_type::divide:
+	case Node_type::mod: {
+		auto r = value(n.children[1]);
+		if (r == 0) {
+			throw Unsupported_operand{ "Can't divide or mod by 0." };
+		}
+
+		if (n.type == Node_type::divide) {
+			return value(n.children[0]) / r;
+		} else {
+			return fmod(value(n.children[0]), r);
+		}
+	}
+	case Node_type::power:
+		return pow(value(n.children[0]), value(n.children[1]));
+	case Node_type::less:
+		return value(n.children[0]) < value(n.children[1]);
+	case Node_type::less_equal:
+		return value(n.children[0]) <= value(n.children[1]);
+	case Node_type::greater:
+		return value(n.children[0]) > value(n.children[1]);
+	case Node_type::greater_equal:
+		return value(n.children[0]) >= value(n.children[1]);
+	case Node_type::equal:
+		return value(n.children[0]) == value(n.children[1]);
+	case Node_type::not_equal:
+		return value(n.children[0]) != value(n.children[1]);
+	case Node_type::factorial:
+		return factorial(value(n.children[0]));
+	case Node_type::select:
+		if (value(n.children[0]) != 0) {
+			return value(n.children[1]);
+		}
+		return value(n.children[2]);
+	case Node_type::call: {
+		Memory_hold held;
+		return n.func(arguments(n, f, held));
+	}
+	case Node_type::sum:
+	case Node_type::product:
+		return reduce(n, f);
+	case Node_type::integral:
+		return integrate(n, f);
+	case Node_type::root:
+		return solve(n, f);
+	case Node_type::bind:
+		f.locals[n.slot] = value(n.children[0]);
+		return value(n.children[1]);
+	case Node_type::polynomial:
+		return polynomial(n, value(n.children[0]));
+	case Node_type::vector:
+	case Node_type::each:
+		throw Unsupported_operand{ "a vector isn't a number" };
+	default:
+		throw Syntax_error{ "a range is only allowed as an argument" };
+	}
+}
+
+
+/**
+ * Float factorial.
+ */
+Real factorial(Real n) {
+	using std::tgamma;
+
+	return tgamma(n + 1);
+}
+
+
+/**
+ * Evaluate the arguments of a function call. A range or each argument
+ * is expanded into all of its values, which are held until the call
+ * returns.
+ */
+vector<Real> arguments(const Node& c, Frame& f, Memory_hold& held) {
+	vector<Real> args;
+	args.reserve(c.children.size());
+
+	for (const auto& arg : c.children) {
+		if (arg.type == Node_type::range) {
+			expand(arg, f, args, held);
+		} else if (arg.type == Node_type::each) {
+			expand_each(arg, f, args, held);
+		} else {
+			args.push_back(evaluate(arg, f));
+		}
+	}
+
+	return args;
+}
+
+
+vector<Real> arguments(const Node& c, Frame& f) {
+	Memory_hold held;
+	return arguments(c, f, held);
+}
+
+
+/**
+ * Return the value of an each: its body evaluated at every element of
+ * its vectors.
+ */
+vector<Real> elements(const Node& each, Frame& f) {
+	Memory_hold held;
+	vector<Real> values;
+	expand_each(each, f, values, held);
+
+	return values;
+}
+
+
+/**
+ * Append all the values of a range to args, once they are known to
+ * fit the budget.
+ */
+void expand(const Node& range, Frame& f, vector<Real>& args,
+		Memory_hold& held) {
+	auto lo = evaluate(range.children[0], f);
+	auto count = steps(lo, evaluate(range.children[1], f));
+	spend(count);
+	held.add(count, sizeof(Real));
+
+	// without a memory limit, a range too large to hold fails here
+	try {
+		args.reserve(args.size() + static_cast<std::size_t>(count));
+	} catch (std::exception&) {		// bad_alloc or length_error
+		throw Unsupported_operand{ "range too large" };
+	}
+
+	for (ull i = 0; i < count; ++i) {
+		args.push_back(lo + i);
+	}
+}
+
+
+/**
+ * Append the body of an each evaluated at every element of its
+ * vectors to args, which all have as many elements, a block at a
+ * time if the body can be: each vector is then a column read where it
+ * is.
+ */
+void expand_each(const Node& each, Frame& f, vector<Real>& args,
+		Memory_hold& held) {
+
+	vector<std::size_t> slots;
+	vector<const Real*> columns;
+	for (std::size_t i = 1; i < each.children.size(); ++i) {
+		slots.push_back(each.children[i].slot);
+		columns.push_back(each.children[i].elements->data());
+	}
+
+	auto count = each.children[1].elements->size();
+	held.add(count, sizeof(Real));
+
+	auto first = args.size();
+	args.resize(first + count);
+	evaluate_columns(each.children[0], f, slots, columns, count,
+		args.data() + first, each.parallel);
+}
+
+
+/**
+ * Is an argument expanded into any number of values?
+ */
+bool is_expanded(const Node& arg) {
+	return arg.type == Node_type::range || arg.type == Node_type::each;
+}
+
+
+/**
+ * Return the number of values in the range lo..hi, i.e., lo,
+ * lo + 1, ... up to and including hi. A range with more values than
+ * a Real can count apart, or than fit in a ull, is an error.
+ */
+ull steps(Real lo, Real hi) {
+	using std::floor;
+
+	if (!(hi >= lo)) {	// also catches NaN
+		return 0;
+	}
+
+	constexpr auto bits = std::min(std::numeric_limits<Real>::digits, 63);
+	auto span = floor(hi - lo);
+	if (!(span < std::ldexp(Real{ 1 }, bits))) {	// also catches inf
+		throw Unsupported_operand{ "range too large" };
+	}
+
+	return static_cast<ull>(span) + 1;
+}
+
+
+/**
+ * Return the sum or product of a reduction's body over every value
+ * of its index variable. The values are generated one at a time;
+ * nothing is stored for them.
+ */
+Real reduce(const Node& r, Frame& f) {
+	auto lo = evaluate(r.children[0], f);
+	auto count = steps(lo, evaluate(r.children[1], f));
+
+	if (count >= parallel_threshold && !in_worker && !recording) {
+		return reduce_parallel(r, f, lo, count);
+	}
+
+	return reduce(r, f, lo, 0, count);
+}
+
+
+/**
+ * Reduce the body over the steps [first, last) of the range starting
+ * at lo.
+ */
+Real reduce(const Node& r, Frame& f, Real lo, ull first,
+		ull last) {
+
+	const auto& body = r.children[2];
+
+	auto depth = (last - first >= block_threshold) ? block_depth(body) : 0;
+	if (depth > 0) {
+		vector<Real> buffer((depth + 2) * block_size);
+		auto values = buffer.data();
+		auto out = values + block_size;
+
+		// the body's other index variables keep their values
+		vector<const Real*> columns(f.locals.size());
+		columns[r.slot] = values;
+
+		// the terms are combined in the same order as below, so the
+		// result is the same
+		Real acc = (r.type == Node_type::sum) ? 0 : 1;
+		for (auto i = first; i < last; i += block_size) {
+			auto count = static_cast<std::size_t>(
+				std::min<ull>(block_size, last - i));
+			spend(count);
+			for (std::size_t j = 0; j < count; ++j) {
+				values[j] = lo + (i + j);
+			}
+
+			evaluate_block(body, f, columns.data(), count, out,
+				out + block_size);
+
+			for (std::size_t j = 0; j < count; ++j) {
+				if (r.type == Node_type::sum) {
+					acc += out[j];
+				} else {
+					acc *= out[j];
+				}
+			}
+		}
+
+		return acc;
+	}
+
+	// steps are spent a block at a time here too
+	Real acc = (r.type == Node_type::sum) ? 0 : 1;
+	for (auto i = first; i < last; ) {
+		auto stop = std::min<ull>(last, i + block_size);
+		spend(stop - i);
+
+		if (r.type == Node_type::sum) {
+			for (; i < stop; ++i) {
+				f.locals[r.slot] = lo + i;
+				acc += evaluate(body, f);
+			}
+		} else {
+			for (; i < stop; ++i) {
+				f.locals[r.slot] = lo + i;
+				acc *= evaluate(body, f);
+			}
+		}
+	}
+
+	return acc;
+}
+
+
+/**
+ * Reduce a large range by splitting it into a fixed number of
+ * segments which are reduced concurrently, each thread with its own
+ * copy of the frame.
+ */
+Real reduce_parallel(const Node& r, const Frame& f, Real lo,
+		ull count) {
+
+	std::array<Real, reduction_segments> partial{};
+	std::array<std::exception_ptr, reduction_segments> error{};
+
+	auto size = (count + reduction_segments - 1) / reduction_segments;
+	for_each_task(reduction_segments, f, [&](std::size_t s, Frame& local) {
+		auto first = std::min(count, s * size);
+		auto last = std::min(count, first + size);
+
+		try {
+			partial[s] = reduce(r, local, lo, first, last);
+		} catch (...) {
+			error[s] = std::current_exception();
+		}
+	});
+
+	Real result = (r.type == Node_type::sum) ? 0 : 1;
+	for (std::size_t s = 0; s < reduction_segments; ++s) {
+		if (error[s]) {
+			std::rethrow_exception(error[s]);
+		}
+
+		if (r.type == Node_type::sum) {
+			result += partial[s];
+		} else {
+			result *= partial[s];
+		}
+	}
+
+	return result;
+}
+
+
+/**
+ * Is this an operation whose left operand may continue a chain of
+ * operations which is evaluated concurrently, like a + b - c * d?
+ */
+bool is_chain(Node_type t) {
+	return t == Node_type::add || t == Node_type::subtract ||
+		t == Node_type::multiply;
+}
+
+
+/**
+ * Does an expression call no impure function anywhere?
+ */
+bool is_pure(const Node& n) {
+	return !n.impure && std::all_of(n.children.begin(), n.children.end(),
+		[](const Node& c) { return is_pure(c); });
+}
+
+
+/**
+ * Evaluate the operands of a chain of operations, or the arguments of
+ * a call, concurrently, and then combine them exactly as evaluate
+ * would have: in the same order, so the result doesn't depend on how
+ * many threads were used. If more than one operand fails, the error
+ * is the one evaluate would have reported. An integral evaluates its
+ * integrand concurrently itself.
+ */
+Real evaluate_parallel(const Node& n, Frame& f) {
+	if (n.type == Node_type::integral) {
+		return integrate(n, f, true);
+	}
+
+	// the operations of the chain, from the last applied to the first,
+	// and the operands, in the order evaluate reaches them
+	vector<const Node*> links;
+	vector<const Node*> operands;
+	if (n.type == Node_type::call) {
+		for (const auto& c : n.children) {
+			operands.push_back(&c);
+		}
+	} else {
+		auto link = &n;
+		for (; is_chain(link->type); link = &link->children[0]) {
+			links.push_back(link);
+			operands.push_back(&link->children[1]);
+		}
+
+		operands.push_back(link);
+		std::reverse(operands.begin(), operands.end());
+	}
+
+	vector<Real> values(operands.size());
+	vector<std::exception_ptr> errors(operands.size());
+	for_each_task(operands.size(), f, [&](std::size_t i, Frame& local) {
+		if (is_expanded(*operands[i])) {
+			return;
+		}
+
+		try {
+			values[i] = evaluate(*operands[i], local);
+		} catch (...) {
+			errors[i] = std::current_exception();
+		}
+	});
+
+	for (const auto& e : errors) {
+		if (e) {
+			std::rethrow_exception(e);
+		}
+	}
+
+	if (n.type == Node_type::call) {
+		Memory_hold held;
+		vector<Real> args;
+		args.reserve(values.size());
+		for (std::size_t i = 0; i < values.size(); ++i) {
+			if (operands[i]->type == Node_type::range) {
+				expand(*operands[i], f, args, held);
+			} else if (operands[i]->type == Node_type::each) {
+				expand_each(*operands[i], f, args, held);
+			} else {
+				args.push_back(values[i]);
+			}
+		}
+
+		return n.func(args);
+	}
+
+	auto result = values[0];
+	for (std::size_t i = 1; i < values.size(); ++i) {
+		switch (links[links.size() - i]->type) {
+		case Node_type::add:
+			result += values[i];
+			break;
+		case Node_type::subtract:
+			result -= values[i];
+			break;
+		case Node_type::multiply:
+			result *= values[i];
+			break;
+		default:
+			break;
+		}
+	}
+
+	return result;
+}
+
+
+/**
+ * Call work(i, frame) for every i in [0, count), spread over the
+ * threads of the pool; each thread passes its own copy of the frame.
+ * Nothing evaluated by work is split across threads again.
+ */
+template <typename Work>
+void for_each_task(std::size_t count, const Frame& f, Work work) {
+	std::atomic<std::size_t> next{ 0 };
+
+	// the workers spend from the caller's budget
+	auto shared = budget;
+	auto helpers = std::min(count, thread_count());
+	run_on_pool(helpers > 0 ? helpers - 1 : 0, [&]() {
+		in_worker = true;
+		budget = shared;
+		Frame local = f;
+
+		for (auto i = next++; i < count; i = next++) {
+			work(i, local);
+		}
+	});
+
+	in_worker = false;
+}
+
+
+/**
+ * Mark the chains of operations and the calls whose operands cost
+ * enough to be worth evaluating concurrently, and return the
+ * estimated cost of evaluating the expression. A chain is marked at
+ * its top only.
+ */
+double mark_parallel(Node& n) {
+	double cost = 1;
+	std::size_t operands = n.children.size();
+
+	switch (n.type) {
+	case Node_type::add: case Node_type::subtract:
+	case Node_type::multiply: {
+		// walk down the chain in a loop, since it may be very long
+		operands = 1;
+		auto link = &n;
+		for (; is_chain(link->type); link = &link->children[0]) {
+			link->parallel = false;
+			cost += 1 + mark_parallel(link->children[1]);
+			++operands;
+		}
+
+		cost += mark_parallel(*link);
+		break;
+	}
+	case Node_type::sum:
+	case Node_type::product: {
+		const auto& lo = n.children[0];
+		const auto& hi = n.children[1];
+		auto body = mark_parallel(n.children[2]);
+		cost += mark_parallel(n.children[0]) + mark_parallel(n.children[1]);
+
+		// the body is evaluated once for every step, if that is known;
+		// not by steps, since a range too large is only an error if it
+		// is evaluated
+		auto span = static_cast<double>(hi.value - lo.value);
+		if (lo.type == Node_type::number && hi.type == Node_type::number &&
+				span >= 0) {
+			cost += body * (std::floor(span) + 1);
+		} else {
+			cost += body;
+		}
+		break;
+	}
+	case Node_type::integral:
+	case Node_type::root: {
+		// an integrand is evaluated at dozens of points at least, and
+		// they are evaluated concurrently if a block of them costs
+		// enough; a root takes a few dozen steps, one after another
+		auto body = mark_parallel(n.children[2]);
+		cost += mark_parallel(n.children[0]) + mark_parallel(n.children[1]) +
+			mark_parallel(n.children[3]);
+		if (n.type == Node_type::integral) {
+			cost += body * 4 * rule_points;
+			n.parallel = (body * block_size >= parallel_cost);
+		} else {
+			cost += body * 32;
+			n.parallel = false;
+		}
+
+		return cost;
+	}
+	case Node_type::call:
+		cost += call_cost;
+		for (auto& c : n.children) {
+			cost += mark_parallel(c);
+		}
+		break;
+	case Node_type::each: {
+		// the body is evaluated once for every element, a block of
+		// elements per thread
+		auto count = static_cast<double>(n.children[1].elements->size());
+		cost += mark_parallel(n.children[0]) * count;
+		n.parallel = (cost >= parallel_cost && count > block_size);
+
+		return cost;
+	}
+	case Node_type::select:
+		// only one of the values is evaluated
+		cost += mark_parallel(n.children[0]) + std::max(
+			mark_parallel(n.children[1]), mark_parallel(n.children[2]));
+		break;
+	default:
+		for (auto& c : n.children) {
+			cost += mark_parallel(c);
+		}
+		break;
+	}
+
+	n.parallel = (operands > 1 && cost >= parallel_cost &&
+		(is_chain(n.type) || n.type == Node_type::call));
+
+	return cost;
+}
+
+
+/**
+ * Return how many blocks of scratch space evaluate_block needs for
+ * the given expression, or 0 if it can only be evaluated one value at
+ * a time, because it contains a reduction, an inlined call, a call
+ * to a function without a batch version, or a choice between values
+ * which call an impure function.
+ */
+std::size_t block_depth(const Node& n) {
+	switch (n.type) {
+	case Node_type::number:
+	case Node_type::previous:
+	case Node_type::local:
+		return 1;
+	case Node_type::negate:
+	case Node_type::add: case Node_type::subtract:
+	case Node_type::multiply: case Node_type::divide:
+	case Node_type::mod: case Node_type::power:
+	case Node_type::less: case Node_type::less_equal:
+	case Node_type::greater: case Node_type::greater_equal:
+	case Node_type::equal: case Node_type::not_equal:
+	case Node_type::factorial: case Node_type::polynomial:
+		break;
+	case Node_type::call:
+		if (n.batch && n.children.size() == 1) {
+			break;
+		}
+		return 0;
+	case Node_type::select: {
+		// both values are evaluated for the whole block, so neither may
+		// have a visible effect; the second needs one more block, which
+		// holds it while the first is in out
+		auto c = block_depth(n.children[0]);
+		auto a = block_depth(n.children[1]);
+		auto b = block_depth(n.children[2]);
+		if (c == 0 || a == 0 || b == 0 || !is_pure(n.children[1]) ||
+				!is_pure(n.children[2])) {
+			return 0;
+		}
+
+		return std::max({ c, a, b + 1 }) + 1;
+	}
+	default:
+		return 0;
+	}
+
+	std::size_t depth = 0;
+	for (const auto& c : n.children) {
+		auto d = block_depth(c);
+		if (d == 0) {
+			return 0;
+		}
+
+		depth = std::max(depth, d);
+	}
+
+	return depth + 1;
+}
+
+
+/**
+ * Evaluate an expression count times at once, one operation at a time
+ * over the whole block, so that each operation is a simple loop. An
+ * index variable whose slot has a column takes its values from that
+ * column; the others keep the value they have in the frame. Each
+ * level of the expression uses one block of scratch space.
+ */
+void evaluate_block(const Node& n, Frame& f, const Real* const* columns,
+		std::size_t count, Real* out, Real* scratch) {
+
+	using std::pow;
+	using std::fmod;
+	using std::tgamma;
+
+	Profile_scope scope{ n, count };
+	auto next = scratch + block_size;
+	switch (n.type) {
+	case Node_type::number:
+		std::fill(out, out + count, n.value);
+		return;
+	case Node_type::previous:
+		std::fill(out, out + count, f.prev);
+		return;
+	case Node_type::local:
+		if (columns[n.slot]) {
+			std::copy(columns[n.slot], columns[n.slot] + count, out);
+		} else {
+			std::fill(out, out + count, f.locals[n.slot]);
+		}
+		return;
+	case Node_type::negate:
+		evaluate_block(n.children[0], f, columns, count, out,
+			scratch);
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = -out[i];
+		}
+		return;
+	case Node_type::factorial:
+		evaluate_block(n.children[0], f, columns, count, out,
+			scratch);
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = tgamma(out[i] + 1);
+		}
+		return;
+	case Node_type::call:
+		evaluate_block(n.children[0], f, columns, count, scratch,
+			next);
+		n.batch(scratch, out, count);
+		return;
+	case Node_type::polynomial:
+		evaluate_block(n.children[0], f, columns, count, scratch,
+			next);
+		polynomial_block(n, scratch, out, count);
+		return;
+	case Node_type::select:
+		select_block(n, f, columns, count, out, scratch);
+		return;
+	default:
+		break;
+	}
+
+	// a binary operation: the right operand goes into scratch, and
+	// is evaluated first, as evaluate does
+	evaluate_block(n.children[1], f, columns, count, scratch,
+		next);
+
+	if (n.type == Node_type::divide || n.type == Node_type::mod) {
+		if (std::find(scratch, scratch + count, 0.0) != scratch + count) {
+			throw Unsupported_operand{ "Can't divide or mod by 0." };
+		}
+	}
+
+	evaluate_block(n.children[0], f, columns, count, out, next);
+
+	switch (n.type) {
+	case Node_type::add:
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] += scratch[i];
+		}
+		break;
+	case Node_type::subtract:
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] -= scratch[i];
+		}
+		break;
+	case Node_type::multiply:
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] *= scratch[i];
+		}
+		break;
+	case Node_type::divide:
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] /= scratch[i];
+		}
+		break;
+	case Node_type::mod:
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = fmod(out[i], scratch[i]);
+		}
+		break;
+	case Node_type::power:
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = pow(out[i], scratch[i]);
+		}
+		break;
+	case Node_type::less:
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = out[i] < scratch[i];
+		}
+		break;
+	case Node_type::less_equal:
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = out[i] <= scratch[i];
+		}
+		break;
+	case Node_type::greater:
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = out[i] > scratch[i];
+		}
+		break;
+	case Node_type::greater_equal:
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = out[i] >= scratch[i];
+		}
+		break;
+	case Node_type::equal:
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = out[i] == scratch[i];
+		}
+		break;
+	case Node_type::not_equal:
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = out[i] != scratch[i];
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+
+/**
+ * Evaluate an expression at each of the given values of one index
+ * variable, into out, as reduce evaluates its body: a block at a time
+ * if it can be, and split across threads if asked to. The other index
+ * variables keep their values.
+ */
+void evaluate_at(const Node& n, Frame& f, std::size_t slot,
+		const vector<Real>& values, vector<Real>& out, bool parallel) {
+
+	evaluate_columns(n, f, { slot }, { values.data() }, values.size(),
+		out.data(), parallel);
+}
+
+
+/**
+ * Evaluate an expression count times into out, the i-th time with the
+ * index variable in each of the given slots set to the i-th of its
+ * values, a block at a time if it can be, and split across threads if
+ * asked to. The other index variables keep their values.
+ */
+void evaluate_columns(const Node& n, Frame& f,
+		const vector<std::size_t>& slots, const vector<const Real*>& values,
+		std::size_t count, Real* out, bool parallel) {
+
+	auto depth = block_depth(n);
+	auto run = [&](std::size_t first, std::size_t last, Frame& local) {
+		spend(last - first);
+		if (depth == 0) {
+			for (auto i = first; i < last; ++i) {
+				for (std::size_t s = 0; s < slots.size(); ++s) {
+					local.locals[slots[s]] = values[s][i];
+				}
+				out[i] = evaluate(n, local);
+			}
+			return;
+		}
+
+		vector<Real> scratch(depth * block_size);
+		vector<const Real*> columns(local.locals.size());
+		for (auto i = first; i < last; i += block_size) {
+			for (std::size_t s = 0; s < slots.size(); ++s) {
+				columns[slots[s]] = values[s] + i;
+			}
+			evaluate_block(n, local, columns.data(),
+				std::min(block_size, last - i), out + i, scratch.data());
+		}
+	};
+
+	auto tasks = (count + block_size - 1) / block_size;
+	if (!parallel || tasks < 2 || in_worker || recording) {
+		run(0, count, f);
+		return;
+	}
+
+	// a block of values per task; if more than one fails, the error
+	// is the one evaluating them in order would have reported
+	vector<std::exception_ptr> errors(tasks);
+	for_each_task(tasks, f, [&](std::size_t t, Frame& local) {
+		try {
+			run(t * block_size, std::min(count, (t + 1) * block_size),
+				local);
+		} catch (...) {
+			errors[t] = std::current_exception();
+		}
+	});
+
+	for (const auto& e : errors) {
+		if (e) {
+			std::rethrow_exception(e);
+		}
+	}
+}
+
+
+/**
+ * Evaluate a select over a block without branching on each value: the
+ * condition and both values are evaluated for the whole block, and
+ * each result is then picked from one or the other. If a value the
+ * block doesn't need fails, e.g. 1 / k where k is 0 and isn't chosen,
+ * each result is evaluated again one at a time, which evaluates only
+ * the value chosen, as evaluate does.
+ */
+void select_block(const Node& n, Frame& f, const Real* const* columns,
+		std::size_t count, Real* out, Real* scratch) {
+
+	auto next = scratch + block_size;
+	auto condition = scratch;
+	evaluate_block(n.children[0], f, columns, count, condition, next);
+
+	try {
+		auto otherwise = next;
+		evaluate_block(n.children[1], f, columns, count, out, next);
+		evaluate_block(n.children[2], f, columns, count, otherwise,
+			next + block_size);
+
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = (condition[i] != 0) ? out[i] : otherwise[i];
+		}
+	} catch (Calc_cli_exception&) {
+		auto locals = f.locals;
+		try {
+			for (std::size_t i = 0; i < count; ++i) {
+				for (std::size_t s = 0; s < locals.size(); ++s) {
+					if (columns[s]) {
+						f.locals[s] = columns[s][i];
+					}
+				}
+
+				const auto& chosen = n.children[(condition[i] != 0) ? 1 : 2];
+				out[i] = evaluate(chosen, f);
+			}
+		} catch (...) {
+			f.locals = std::move(locals);
+			throw;
+		}
+
+		f.locals = std::move(locals);
+	}
+}
+
+
+/**
+ * Return the number of Nodes in a compiled expression.
+ */
+std::size_t size(const Node& n) {
+	std::size_t s = 1;
+	for (const auto& c : n.children) {
+		s += size(c);
+	}
+
+	return s;
+}
+
+
+/**
+ * Return how many slots a Frame needs to evaluate the given
+ * expression.
+ */
+std::size_t frame_size(const Node& n) {
+	std::size_t s = 0;
+	switch (n.type) {
+	case Node_type::local:
+	case Node_type::sum:
+	case Node_type::product:
+	case Node_type::integral:
+	case Node_type::root:
+	case Node_type::bind:
+	case Node_type::vector:
+		s = n.slot + 1;
+		break;
+	default:
+		break;
+	}
+
+	for (const auto& c : n.children) {
+		s = std::max(s, frame_size(c));
+	}
+
+	return s;
+}
+
+
+/**
+ * Return how many Nodes deep an expression is. It is found without
+ * recursion, so that it can be checked before anything recurses over
+ * an expression too deep to.
+ */
+std::size_t depth(const Node& n) {
+	std::size_t deepest = 0;
+
+	vector<std::pair<const Node*, std::size_t>> open{ { &n, 1 } };
+	while (!open.empty()) {
+		auto node = open.back().first;
+		auto d = open.back().second;
+		open.pop_back();
+
+		deepest = std::max(deepest, d);
+		for (const auto& c : node->children) {
+			open.emplace_back(&c, d + 1);
+		}
+	}
+
+	return deepest;
+}
+
+
+/**
+ * Replace every part of an expression which only depends on
+ * constants by its value. A part whose evaluation fails is left as it
+ * is, so the error is reported only if it is ever evaluated.
+ */
+void fold(Node& n) {
+	for (auto& c : n.children) {
+		fold(c);
+	}
+
+	switch (n.type) {
+	case Node_type::negate:
+	case Node_type::add: case Node_type::subtract:
+	case Node_type::multiply: case Node_type::divide:
+	case Node_type::mod: case Node_type::power:
+	case Node_type::less: case Node_type::less_equal:
+	case Node_type::greater: case Node_type::greater_equal:
+	case Node_type::equal: case Node_type::not_equal:
+	case Node_type::factorial: case Node_type::polynomial:
+		break;
+	case Node_type::call:
+		if (n.impure) {
+			return;
+		}
+		break;
+	case Node_type::select:
+		// a constant condition chooses its value once and for all
+		if (n.children[0].type == Node_type::number) {
+			auto chosen = std::move(
+				n.children[(n.children[0].value != 0) ? 1 : 2]);
+			n = std::move(chosen);
+		}
+		return;
+	default:
+		return;
+	}
+
+	for (const auto& c : n.children) {
+		if (c.type != Node_type::number) {
+			return;
+		}
+	}
+
+	try {
+		Frame constants{};
+		n = Node{ Node_type::number, evaluate(n, constants) };
+	} catch (Calc_cli_exception&) {
+	}
+}
+
+
+/**
+ * Copy a function body for use at a call site. A parameter for which
+ * an argument is given is replaced by it; every other index variable
+ * of the body is moved up by offset slots.
+ */
+Node substitute(const Node& body, const vector<const Node*>& args,
+		std::size_t offset) {
+
+	if (body.type == Node_type::local && body.slot < args.size() &&
+			args[body.slot]) {
+		return *args[body.slot];
+	}
+
+	Node n{ body.type, body.value, body.slot, body.func, body.deriv,
+		body.batch, body.name };
+	n.impure = body.impure;
+	n.parallel = body.parallel;
+	n.elements = body.elements;
+	switch (body.type) {
+	case Node_type::local:
+	case Node_type::sum:
+	case Node_type::product:
+	case Node_type::integral:
+	case Node_type::root:
+	case Node_type::bind:
+	case Node_type::vector:
+		n.slot += offset;
+		break;
+	default:
+		break;
+	}
+
+	n.children.reserve(body.children.size());
+	for (const auto& c : body.children) {
+		n.children.push_back(substitute(c, args, offset));
+	}
+
+	return n;
+}
@@ -0,0 +1,162 @@
+#pragma once
+#ifndef CALC_CLI_NODE_HPP
+#define CALC_CLI_NODE_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * node.hpp declares the Node type, which represents a compiled
+ * expression, the evaluate function that computes its value, and
+ * helpers for rewriting compiled expressions.
+ */
+
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+
+#include "../real/real.hpp"
+
+
+using Calc_func = std::function<Real(const std::vector<Real>&)>;
+
+// partial derivatives of a function with respect to each of its
+// arguments, at the given arguments
+using Calc_deriv =
+	std::function<std::vector<Real>(const std::vector<Real>&)>;
+
+// a function of one argument applied to n arguments at once: out[i]
+// is set to f(in[i]); in and out must not overlap
+using Calc_batch =
+	std::function<void(const Real* in, Real* out, std::size_t n)>;
+
+// how many arguments a function takes, from least to most
+struct Arity {
+	std::size_t least;
+	std::size_t most;
+};
+
+
+enum class Node_type {
+	number,				// a literal or an already defined variable
+	previous,			// the value of the previous calculation
+	local,				// an index variable bound by a reduction, or
+						// a parameter of a user-defined function
+	negate,
+	add, subtract, multiply, divide, mod, power,
+	less, less_equal, greater, greater_equal, equal, not_equal,
+						// 1 if the comparison holds, else 0
+	factorial,
+	select,				// { condition, if true, if false }; only the
+						// value chosen is evaluated
+	call,				// call to a predefined function
+	range,				// lo..hi; only valid as a function argument
+	sum, product,		// reduction over an index variable
+	integral,			// { lo, hi, integrand, tolerance } over an
+						// index variable
+	root,				// { lo, hi, expression, tolerance }: a value
+						// of an index variable at which the
+						// expression is 0
+	bind,				// evaluate { value, body } with value stored
+						// in a slot; used to inline function calls
+	vector,				// the elements of a vector, which are bound
+						// to a slot by the each holding it
+	each,				// { body, vectors... }: the body evaluated
+						// once for every element, with each vector's
+						// element in its slot; only valid as the
+						// whole expression or a function argument
+	polynomial			// { argument, coefficients... }, with the
+						// coefficients as numbers from the highest
+						// degree down; see find_polynomials
+};
+
+
+struct Node {
+	Node_type type;
+	Real value = 0;				// used only when type is
+								// Node_type::number
+	std::size_t slot = 0;		// index variable used by
+								// Node_type::local, sum, product,
+								// integral, root, bind and vector
+	Calc_func func{};			// used only when type is
+								// Node_type::call
+	Calc_deriv deriv{};			// derivatives of func, if known
+	Calc_batch batch{};			// batch version of func, if it has
+								// one
+	std::string name{};			// name of func, by which it is found
+								// again when a session is loaded, or
+								// of the index variable of a local,
+								// reduction, integral or root, to show
+								// it
+	std::vector<Node> children{};	// operands, arguments or, for a
+									// reduction, { lo, hi, body }
+	bool impure = false;		// a call which may give different
+								// results for the same arguments, so
+								// it is never folded
+	bool parallel = false;		// evaluate the operands of this chain
+								// of operations, the arguments of
+								// this call, the integrand of this
+								// integral at many points, or the
+								// body of this each at many elements,
+								// concurrently; see mark_parallel
+	std::shared_ptr<const std::vector<Real>> elements{};
+								// used only when type is
+								// Node_type::vector; shared by every
+								// copy, since they never change
+};
+
+
+/**
+ * A function defined by the user with "let f[x, y] = ...".
+ */
+struct User_func {
+	std::size_t arity;
+	Node body;					// parameters are the index variables
+								// in slots 0 .. arity - 1
+};
+
+
+/**
+ * Values an expression may read while it is evaluated.
+ */
+struct Frame {
+	Real prev;					// value of `_`
+	std::vector<Real> locals;	// current values of index variables
+};
+
+
+Real evaluate(const Node& node, Frame& frame);
+
+// the arguments a call passes to its function, with ranges and each
+// expanded into all of their values
+std::vector<Real> arguments(const Node& call, Frame& frame);
+
+// the value of an each, one element for every element of its vectors
+std::vector<Real> elements(const Node& each, Frame& frame);
+
+unsigned long long steps(Real lo, Real hi);
+
+std::size_t size(const Node& node);
+std::size_t frame_size(const Node& node);
+std::size_t depth(const Node& node);
+
+// evaluate_block works on at most this many values at a time
+constexpr std::size_t block_size = 256;
+
+std::size_t block_depth(const Node& node);
+void evaluate_block(const Node& node, Frame& frame,
+	const Real* const* columns, std::size_t count, Real* out,
+	Real* scratch);
+void evaluate_at(const Node& node, Frame& frame, std::size_t slot,
+	const std::vector<Real>& values, std::vector<Real>& out,
+	bool parallel);
+
+void fold(Node& node);
+double mark_parallel(Node& node);
+Node substitute(const Node& body, const std::vector<const Node*>& args,
+	std::size_t offset);
+
+
+#endif // !CALC_CLI_NODE_HPP
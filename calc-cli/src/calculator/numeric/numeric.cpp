@@ -0,0 +1,385 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * numeric.cpp defines integrate and solve from numeric.hpp.
+ *
+ * An integral is computed by adaptive quadrature: each piece of it is
+ * estimated by the 15-point Gauss-Kronrod rule, whose difference from
+ * the 7-point Gauss rule within it estimates the error, and the
+ * pieces whose errors are too large are halved until the total error
+ * is small enough. Every piece split in one round is evaluated at
+ * once, so the integrand is evaluated a block at a time, or across
+ * threads, as a reduction's body is.
+ *
+ * A root is found by Newton's method, kept within a bracket where the
+ * expression changes sign, and falling back to halving the bracket
+ * whenever a step would leave it or doesn't converge quickly. The
+ * derivative is computed with Duals; for an expression which can't be
+ * differentiated, the slope of the last two points is used instead.
+ */
+
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "numeric.hpp"
+#include "../dual/dual.hpp"
+#include "../limits/limits.hpp"
+#include "../exceptions/exceptions.hpp"
+
+
+using std::vector;
+using std::pair;
+
+using limits_of = std::numeric_limits<Real>;
+
+
+// a piece of an integral, with the estimates of the rule for it
+struct Piece {
+	Real lo;
+	Real hi;
+	Real value = 0;
+	Real error = 0;
+	Real magnitude = 0;		// the integral of the absolute value
+};
+
+
+Real tolerance(const Node& node, Frame& frame);
+void estimate(Piece& piece, const Real* values);
+
+
+const Real default_tolerance = std::max<Real>(1e-10,
+	64 * limits_of::epsilon());
+
+// an integral is given up on when it has this many pieces
+constexpr std::size_t max_pieces = 1 << 15;
+
+// a root is given up on after this many steps; halving alone finds it
+// well before then
+constexpr int max_steps = 200;
+
+
+// the nodes of the Kronrod rule on [-1, 1], from the outermost in;
+// every other one, from the second, is a node of the Gauss rule
+constexpr long double kronrod_nodes[8] = {
+	0.991455371120812639206854697526329L,
+	0.949107912342758524526189684047851L,
+	0.864864423359769072789712788640926L,
+	0.741531185599394439863864773280788L,
+	0.586087235467691130294144845693013L,
+	0.405845151377397166906606412076961L,
+	0.207784955007898467600689403773245L,
+	0.000000000000000000000000000000000L
+};
+
+constexpr long double kronrod_weights[8] = {
+	0.022935322010529224963732008058970L,
+	0.063092092629978553290700663189204L,
+	0.104790010322250183839876322541518L,
+	0.140653259715525918745189590510238L,
+	0.169004726639267902826583426598550L,
+	0.190350578064785409913256402421014L,
+	0.204432940075298892414161999234649L,
+	0.209482141084727828012999174891714L
+};
+
+constexpr long double gauss_weights[4] = {
+	0.129484966168869693270611432679082L,
+	0.279705391489276667901467771423780L,
+	0.381830050505118944950369775488975L,
+	0.417959183673469387755102040816327L
+};
+
+
+/**
+ * Put the points at which the rule evaluates an integrand on [lo, hi]
+ * into points, and the weight of each, if wanted, into weights: the
+ * middle first, then the others in pairs, from the outermost in.
+ */
+void rule(Real lo, Real hi, Real* points, Real* weights) {
+	auto middle = lo + (hi - lo) / 2;
+	auto half = (hi - lo) / 2;
+
+	points[0] = middle;
+	for (std::size_t j = 0; j < 7; ++j) {
+		auto offset = half * static_cast<Real>(kronrod_nodes[j]);
+		points[1 + 2 * j] = middle - offset;
+		points[2 + 2 * j] = middle + offset;
+	}
+
+	if (weights) {
+		weights[0] = half * static_cast<Real>(kronrod_weights[7]);
+		for (std::size_t j = 0; j < 7; ++j) {
+			weights[1 + 2 * j] = half * static_cast<Real>(
+				kronrod_weights[j]);
+			weights[2 + 2 * j] = weights[1 + 2 * j];
+		}
+	}
+}
+
+
+/**
+ * Return the integral of an expression over its variable between the
+ * bounds, to within the tolerance relative to its value, or to what
+ * rounding allows. The pieces the integral was split into are put in
+ * pieces, if wanted, so that the same rule can be applied again.
+ */
+Real integrate(const Node& n, Frame& f, bool parallel,
+		vector<pair<Real, Real>>* parts) {
+
+	using std::abs;
+	using std::isfinite;
+
+	auto lo = evaluate(n.children[0], f);
+	auto hi = evaluate(n.children[1], f);
+	auto tol = tolerance(n, f);
+	if (!isfinite(lo) || !isfinite(hi)) {
+		throw Unsupported_operand{ "the bounds of an integral must be "
+			"finite" };
+	}
+
+	const auto& body = n.children[2];
+	auto roundoff = 50 * limits_of::epsilon();
+
+	vector<Piece> pieces{ Piece{ lo, hi } };
+	vector<std::size_t> fresh{ 0 };		// pieces not yet estimated
+	vector<Real> points;
+	vector<Real> values;
+
+	Real value;
+	while (true) {
+		points.resize(fresh.size() * rule_points);
+		for (std::size_t i = 0; i < fresh.size(); ++i) {
+			const auto& p = pieces[fresh[i]];
+			rule(p.lo, p.hi, &points[i * rule_points], nullptr);
+		}
+
+		values.resize(points.size());
+		evaluate_at(body, f, n.slot, points, values, parallel);
+		for (std::size_t i = 0; i < fresh.size(); ++i) {
+			estimate(pieces[fresh[i]], &values[i * rule_points]);
+		}
+
+		// the pieces are always added in the same order, so the result
+		// doesn't depend on how many threads were used
+		value = 0;
+		Real error = 0;
+		Real magnitude = 0;
+		for (const auto& p : pieces) {
+			value += p.value;
+			error += p.error;
+			magnitude += p.magnitude;
+		}
+
+		// an integrand which is NaN or infinite somewhere gives that
+		if (!isfinite(value) || !isfinite(error)) {
+			break;
+		}
+
+		auto allowed = std::max(tol * abs(value), roundoff * magnitude);
+		if (error <= allowed) {
+			break;
+		}
+
+		// halve every piece with more than its share of the error
+		// allowed; the total is more, so at least one has
+		auto share = allowed / pieces.size();
+		vector<Piece> next;
+		next.reserve(pieces.size() * 2);
+		fresh.clear();
+		for (const auto& p : pieces) {
+			auto middle = p.lo + (p.hi - p.lo) / 2;
+			if (p.error <= share || middle == p.lo || middle == p.hi) {
+				next.push_back(p);
+				continue;
+			}
+
+			fresh.push_back(next.size());
+			next.push_back(Piece{ p.lo, middle });
+			fresh.push_back(next.size());
+			next.push_back(Piece{ middle, p.hi });
+		}
+
+		if (fresh.empty() || next.size() > max_pieces) {
+			throw Unsupported_operand{ "the integral doesn't converge" };
+		}
+
+		pieces = std::move(next);
+	}
+
+	if (parts) {
+		parts->clear();
+		for (const auto& p : pieces) {
+			parts->emplace_back(p.lo, p.hi);
+		}
+	}
+
+	return value;
+}
+
+
+/**
+ * Estimate the integral over a piece, its error and the integral of
+ * its absolute value, from the values of the integrand at the points
+ * given by rule. The error is scaled as QUADPACK's QK15 scales it,
+ * since the difference between the rules overstates it greatly.
+ */
+void estimate(Piece& p, const Real* values) {
+	using std::abs;
+	using std::pow;
+
+	auto half = (p.hi - p.lo) / 2;
+	auto weight = [](const long double* w, std::size_t j) {
+		return static_cast<Real>(w[j]);
+	};
+
+	auto middle = values[0];
+	auto kronrod = middle * weight(kronrod_weights, 7);
+	auto gauss = middle * weight(gauss_weights, 3);
+	auto absolute = abs(kronrod);
+	for (std::size_t j = 0; j < 7; ++j) {
+		auto pair = values[1 + 2 * j] + values[2 + 2 * j];
+		kronrod += weight(kronrod_weights, j) * pair;
+		absolute += weight(kronrod_weights, j) *
+			(abs(values[1 + 2 * j]) + abs(values[2 + 2 * j]));
+		if (j % 2 == 1) {
+			gauss += weight(gauss_weights, j / 2) * pair;
+		}
+	}
+
+	// how far the integrand strays from its mean
+	auto mean = kronrod / 2;
+	auto spread = weight(kronrod_weights, 7) * abs(middle - mean);
+	for (std::size_t j = 0; j < 7; ++j) {
+		spread += weight(kronrod_weights, j) *
+			(abs(values[1 + 2 * j] - mean) + abs(values[2 + 2 * j] - mean));
+	}
+
+	p.value = kronrod * half;
+	p.magnitude = absolute * abs(half);
+	spread *= abs(half);
+
+	auto error = abs((kronrod - gauss) * half);
+	if (spread != 0 && error != 0) {
+		error = spread * std::min<Real>(1, pow(200 * error / spread, 1.5));
+	}
+
+	auto epsilon = limits_of::epsilon();
+	if (p.magnitude > limits_of::min() / (50 * epsilon)) {
+		error = std::max(50 * epsilon * p.magnitude, error);
+	}
+
+	p.error = error;
+}
+
+
+/**
+ * Return a value of an expression's variable between the bounds at
+ * which the expression is 0, to within the tolerance relative to it,
+ * or 1 if it is smaller. The expression must change sign between the
+ * bounds.
+ */
+Real solve(const Node& n, Frame& f) {
+	using std::abs;
+
+	auto a = evaluate(n.children[0], f);
+	auto b = evaluate(n.children[1], f);
+	auto tol = tolerance(n, f);
+
+	const auto& body = n.children[2];
+	auto& x = f.locals[n.slot];
+
+	// the bracket is kept with the expression negative at a
+	x = a;
+	auto ga = evaluate(body, f);
+	x = b;
+	auto gb = evaluate(body, f);
+	if (ga == 0 || gb == 0) {
+		return (ga == 0) ? a : b;
+	}
+
+	if (!((ga < 0 && gb > 0) || (ga > 0 && gb < 0))) {
+		throw Unsupported_operand{ "the expression must change sign "
+			"between the bounds" };
+	}
+
+	if (ga > 0) {
+		std::swap(a, b);
+		std::swap(ga, gb);
+	}
+
+	// the expression is differentiated in a frame of its own, with
+	// only its variable seeded
+	bool differentiable = true;
+	Dual_frame duals{ Dual{ f.prev }, vector<Dual>(f.locals.size()) };
+	for (std::size_t i = 0; i < f.locals.size(); ++i) {
+		duals.locals[i] = Dual{ f.locals[i] };
+	}
+
+	// the last point, and the value there, to start from
+	auto last = a;
+	auto last_g = ga;
+	auto root = a + (b - a) / 2;
+	for (int step = 0; step < max_steps; ++step) {
+		spend(1);
+
+		Real g;
+		Real slope = 0;
+		if (differentiable) {
+			try {
+				duals.locals[n.slot] = seed(root, 0, 1);
+				auto d = evaluate(body, duals);
+				g = d.value;
+				slope = d.d.empty() ? 0 : d.d[0];
+			} catch (Calc_cli_exception&) {
+				// evaluated again below, to report a real error
+				differentiable = false;
+			}
+		}
+
+		if (!differentiable) {
+			x = root;
+			g = evaluate(body, f);
+			slope = (g - last_g) / (root - last);
+		}
+
+		if (g == 0) {
+			return root;
+		}
+
+		(g < 0 ? a : b) = root;
+
+		auto newton = root - g / slope;
+		auto inside = (newton > std::min(a, b) && newton < std::max(a, b));
+		auto next = (inside && abs(g) <= abs(last_g) / 2) ? newton
+			: a + (b - a) / 2;
+
+		auto close = tol * std::max<Real>(1, abs(root));
+		if (abs(next - root) <= close || abs(b - a) <= close ||
+				next == a || next == b) {
+			return next;
+		}
+
+		last = root;
+		last_g = g;
+		root = next;
+	}
+
+	return root;
+}
+
+
+/**
+ * Return the tolerance given to an integral or root.
+ */
+Real tolerance(const Node& n, Frame& f) {
+	auto tol = evaluate(n.children[3], f);
+	if (!(tol > 0)) {
+		throw Unsupported_operand{ "the tolerance must be positive" };
+	}
+
+	return tol;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#ifndef CALC_CLI_NUMERIC_HPP
+#define CALC_CLI_NUMERIC_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * numeric.hpp declares integrate and solve, which compute the value
+ * of an integral, or a root of an expression, from a compiled
+ * expression evaluated at as many values of its variable as it takes.
+ */
+
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+#include "../node/node.hpp"
+
+
+// the relative error allowed when none is given
+extern const Real default_tolerance;
+
+// the Gauss-Kronrod rule evaluates an integrand at this many points
+// of each piece of an integral
+constexpr std::size_t rule_points = 15;
+
+void rule(Real lo, Real hi, Real* points, Real* weights);
+
+Real integrate(const Node& integral, Frame& frame, bool parallel = false,
+	std::vector<std::pair<Real, Real>>* pieces = nullptr);
+Real solve(const Node& root, Frame& frame);
+
+
+#endif // !CALC_CLI_NUMERIC_HPP
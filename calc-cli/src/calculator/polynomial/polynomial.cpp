@@ -0,0 +1,331 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * polynomial.cpp defines the functions from polynomial.hpp. A
+ * Node_type::polynomial has its argument as its first child, and then
+ * its coefficients, as numbers, from the highest degree down.
+ */
+
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "polynomial.hpp"
+#include "../../utils/simd.hpp"
+
+
+using std::vector;
+
+
+/**
+ * A polynomial in at most one index variable, found in part of an
+ * expression.
+ */
+struct Terms {
+	const Node* variable = nullptr;	// the local it is in, or none if
+									// it is a constant
+	vector<Real> c;					// coefficients, lowest degree
+									// first
+};
+
+
+bool find(Node& node, Terms& terms);
+bool combine(const Node& operation, Terms& left, const Terms& right);
+std::size_t term_count(const vector<Real>& c);
+void rewrite(Node& node, const Terms& terms);
+
+template <typename V>
+V horner(const Node& poly, V x);
+
+
+/**
+ * Rewrite every polynomial of degree 2 or more in an index variable
+ * into a Node_type::polynomial, which takes a multiply-add per
+ * coefficient instead of a pow per term.
+ *
+ * Only a polynomial written out as a sum of terms is found: a product
+ * or power of sums, such as (x - 1) ^ 10, is left as it is, since
+ * multiplying it out would cancel away most of its digits near its
+ * roots. Numerator and denominator of a rational function are found
+ * apart. The value may differ in the last digits from evaluating the
+ * terms one by one, or where one of them overflows.
+ */
+void find_polynomials(Node& n) {
+	Terms t;
+	if (find(n, t)) {
+		rewrite(n, t);
+	}
+}
+
+
+/**
+ * Return whether the expression is a polynomial, as its terms. If it
+ * isn't, the largest polynomials within it are rewritten instead.
+ */
+bool find(Node& n, Terms& t) {
+	switch (n.type) {
+	case Node_type::number:
+		t.c.assign(1, n.value);
+		return true;
+	case Node_type::local:
+		t.variable = &n;
+		t.c = { 0, 1 };
+		return true;
+	case Node_type::negate:
+		if (!find(n.children[0], t)) {
+			return false;
+		}
+
+		for (auto& c : t.c) {
+			c = -c;
+		}
+		return true;
+	case Node_type::add: case Node_type::subtract:
+	case Node_type::multiply: case Node_type::divide:
+	case Node_type::power: {
+		Terms right;
+		bool left_found = find(n.children[0], t);
+		bool right_found = find(n.children[1], right);
+		if (left_found && right_found && combine(n, t, right)) {
+			return true;
+		}
+
+		if (left_found) {
+			rewrite(n.children[0], t);
+		}
+		if (right_found) {
+			rewrite(n.children[1], right);
+		}
+		return false;
+	}
+	case Node_type::polynomial:
+		// e.g. the body of an inlined function
+		if (n.children[0].type != Node_type::local) {
+			break;
+		}
+
+		t.variable = &n.children[0];
+		for (auto i = n.children.size(); i-- > 1; ) {
+			t.c.push_back(n.children[i].value);
+		}
+		return true;
+	default:
+		break;
+	}
+
+	for (auto& c : n.children) {
+		Terms inner;
+		if (find(c, inner)) {
+			rewrite(c, inner);
+		}
+	}
+
+	return false;
+}
+
+
+/**
+ * Apply an operation to the terms of its operands, into left, and
+ * return true, or return false and leave left as it was if the result
+ * isn't a polynomial that may be multiplied out: one in two index
+ * variables, a product of sums, a power of a sum or to other than a
+ * whole exponent, a division by other than a constant, or one whose
+ * degree is too high or a coefficient not finite.
+ */
+bool combine(const Node& n, Terms& left, const Terms& right) {
+	if (left.variable && right.variable &&
+			left.variable->slot != right.variable->slot) {
+		return false;
+	}
+
+	const auto& a = left.c;
+	const auto& b = right.c;
+	vector<Real> c;
+	switch (n.type) {
+	case Node_type::add:
+	case Node_type::subtract: {
+		c.resize(std::max(a.size(), b.size()));
+		for (std::size_t i = 0; i < c.size(); ++i) {
+			if (i >= b.size()) {
+				c[i] = a[i];
+			} else if (i >= a.size()) {
+				c[i] = (n.type == Node_type::add) ? b[i] : -b[i];
+			} else {
+				c[i] = (n.type == Node_type::add) ? a[i] + b[i]
+					: a[i] - b[i];
+			}
+		}
+		break;
+	}
+	case Node_type::multiply:
+		if (term_count(a) > 1 && term_count(b) > 1) {
+			return false;
+		}
+
+		c.resize(a.size() + b.size() - 1);
+		for (std::size_t i = 0; i < a.size(); ++i) {
+			for (std::size_t j = 0; j < b.size(); ++j) {
+				if (a[i] != 0 && b[j] != 0) {
+					c[i + j] += a[i] * b[j];
+				}
+			}
+		}
+		break;
+	case Node_type::divide:
+		if (right.variable || n.children[1].type != Node_type::number ||
+				b[0] == 0) {
+			return false;
+		}
+
+		for (auto v : a) {
+			c.push_back(v / b[0]);
+		}
+		break;
+	case Node_type::power: {
+		auto k = n.children[1].value;
+		if (right.variable || n.children[1].type != Node_type::number ||
+				k < 0 || k > max_degree || std::floor(k) != k ||
+				term_count(a) > 1) {
+			return false;
+		}
+
+		// a single term c x^d, or 0
+		auto d = a.size() - 1;
+		if (d * static_cast<std::size_t>(k) > max_degree) {
+			return false;
+		}
+
+		c.resize(d * static_cast<std::size_t>(k) + 1);
+		c.back() = std::pow(a.back(), k);
+		break;
+	}
+	default:
+		return false;
+	}
+
+	while (c.size() > 1 && c.back() == 0) {
+		c.pop_back();
+	}
+
+	if (c.size() > max_degree + 1 || !std::all_of(c.begin(), c.end(),
+			[](Real v) { return std::isfinite(v); })) {
+		return false;
+	}
+
+	left.c = std::move(c);
+	left.variable = left.variable ? left.variable : right.variable;
+	return true;
+}
+
+
+/**
+ * Return how many of the coefficients aren't 0.
+ */
+std::size_t term_count(const vector<Real>& c) {
+	return c.size() - std::count(c.begin(), c.end(), Real{ 0 });
+}
+
+
+/**
+ * Replace an expression by the polynomial it was found to be, if it is
+ * of degree 2 or more in an index variable; below that, it costs no
+ * more as it is.
+ */
+void rewrite(Node& n, const Terms& t) {
+	if (!t.variable || t.c.size() < 3) {
+		return;
+	}
+
+	Node p{ Node_type::polynomial };
+	p.children.reserve(t.c.size() + 1);
+	p.children.push_back(*t.variable);
+	for (auto i = t.c.size(); i-- > 0; ) {
+		p.children.push_back(Node{ Node_type::number, t.c[i] });
+	}
+
+	n = std::move(p);
+}
+
+
+#if defined(CALC_CLI_FLOAT)
+// a float has a fused multiply-add wherever a double does
+float multiply_add(float a, float b, float c) {
+#ifdef CALC_CLI_FMA
+	return std::fma(a, b, c);
+#else
+	return a * b + c;
+#endif
+}
+#elif defined(CALC_CLI_LONG_DOUBLE)
+// no processor has a fused multiply-add for long double
+long double multiply_add(long double a, long double b, long double c) {
+	return a * b + c;
+}
+#endif
+
+
+/**
+ * Return the value of a polynomial at x.
+ */
+Real polynomial(const Node& p, Real x) {
+	return horner(p, x);
+}
+
+
+/**
+ * Return the value of a polynomial at x, one value or a Vec of them,
+ * by Horner's scheme: a multiply-add per coefficient. Each waits for
+ * the one before, but the values of a block, or of one step of a
+ * reduction and the next, are independent, so the processor overlaps
+ * them; Estrin's scheme, which shortens the wait with more work,
+ * measured slower here at every degree.
+ */
+template <typename V>
+V horner(const Node& p, V x) {
+	const auto& c = p.children;
+	V r = c[1].value;
+	for (std::size_t i = 2; i < c.size(); ++i) {
+		r = multiply_add(r, x, V{ c[i].value });
+	}
+
+	return r;
+}
+
+
+/**
+ * Return the derivative of a polynomial at x, by Horner's scheme over
+ * the coefficients of the derivative, found on the way.
+ */
+Real slope(const Node& p, Real x) {
+	const auto& c = p.children;
+	Real d = 0;
+	auto r = c[1].value;
+	for (std::size_t i = 2; i < c.size(); ++i) {
+		d = multiply_add(d, x, r);
+		r = multiply_add(r, x, c[i].value);
+	}
+
+	return d;
+}
+
+
+/**
+ * Evaluate a polynomial at count values of x at once, into out, with
+ * exactly the same operations as polynomial does for each one: a Vec
+ * at a time when Real is double, the rest one by one.
+ */
+void polynomial_block(const Node& p, const Real* x, Real* out,
+		std::size_t count) {
+
+	std::size_t i = 0;
+#if defined(CALC_CLI_SIMD) && !defined(CALC_CLI_FLOAT) && \
+		!defined(CALC_CLI_LONG_DOUBLE)
+	for (; i + Vec::lanes <= count; i += Vec::lanes) {
+		horner(p, Vec::load(x + i)).store(out + i);
+	}
+#endif
+	for (; i < count; ++i) {
+		out[i] = polynomial(p, x[i]);
+	}
+}
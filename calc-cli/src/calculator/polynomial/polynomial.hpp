@@ -0,0 +1,32 @@
+#pragma once
+#ifndef CALC_CLI_POLYNOMIAL_HPP
+#define CALC_CLI_POLYNOMIAL_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * polynomial.hpp declares find_polynomials, which rewrites the
+ * polynomials in an index variable found in a compiled expression into
+ * Node_type::polynomial, and the functions that evaluate one by
+ * Horner's scheme.
+ */
+
+
+#include <cstddef>
+
+#include "../node/node.hpp"
+
+
+// a polynomial of higher degree than this is left as it is written
+constexpr std::size_t max_degree = 64;
+
+void find_polynomials(Node& node);
+
+Real polynomial(const Node& poly, Real x);
+Real slope(const Node& poly, Real x);
+void polynomial_block(const Node& poly, const Real* x, Real* out,
+	std::size_t count);
+
+
+#endif // !CALC_CLI_POLYNOMIAL_HPP
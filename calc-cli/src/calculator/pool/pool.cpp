@@ -0,0 +1,164 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * pool.cpp defines the thread count and the pool from pool.hpp.
+ */
+
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+#include "pool.hpp"
+
+
+// 0 until set, for as many threads as there are processors
+std::size_t threads_set = 0;
+
+
+class Pool {
+public:
+	Pool() = default;
+	~Pool();
+
+	Pool(const Pool&) = delete;
+	Pool& operator=(const Pool&) = delete;
+
+	void run(std::size_t helpers, const std::function<void()>& job);
+
+private:
+	std::mutex m;
+	std::condition_variable wake;		// a job was posted, or stopping
+	std::condition_variable done;		// a helper finished its part
+
+	std::vector<std::thread> threads;
+	const std::function<void()>* job = nullptr;
+	std::size_t wanted = 0;				// helpers yet to start the job
+	std::size_t running = 0;			// helpers running it
+	bool busy = false;
+	bool stopping = false;
+
+	void help();
+};
+
+
+Pool::~Pool() {
+	{
+		std::lock_guard<std::mutex> lock{ m };
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (auto& t : threads) {
+		t.join();
+	}
+}
+
+
+/**
+ * Run a job on this thread and on up to helpers threads of the pool,
+ * starting any the pool doesn't have yet.
+ */
+void Pool::run(std::size_t helpers, const std::function<void()>& work) {
+	if (helpers > 0) {
+		std::lock_guard<std::mutex> lock{ m };
+		if (busy || stopping) {
+			helpers = 0;
+		} else {
+			busy = true;
+			while (threads.size() < helpers) {
+				threads.emplace_back(&Pool::help, this);
+			}
+
+			job = &work;
+			wanted = helpers;
+		}
+	}
+
+	if (helpers == 0) {
+		work();
+		return;
+	}
+
+	wake.notify_all();
+	work();
+
+	// helpers which haven't started by now would find nothing left
+	std::unique_lock<std::mutex> lock{ m };
+	wanted = 0;
+	done.wait(lock, [this]() { return running == 0; });
+	job = nullptr;
+	busy = false;
+}
+
+
+/**
+ * Wait for jobs, and run each one posted while this thread is wanted.
+ */
+void Pool::help() {
+	std::unique_lock<std::mutex> lock{ m };
+	while (true) {
+		wake.wait(lock, [this]() { return stopping || wanted > 0; });
+		if (stopping) {
+			return;
+		}
+
+		--wanted;
+		++running;
+		auto work = job;
+
+		lock.unlock();
+		(*work)();
+		lock.lock();
+
+		if (--running == 0) {
+			done.notify_all();
+		}
+	}
+}
+
+
+// started when first needed, and stopped on exit
+Pool pool;
+
+
+/**
+ * Return how many threads to work with.
+ */
+std::size_t thread_count() {
+	if (threads_set != 0) {
+		return threads_set;
+	}
+
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+/**
+ * Set how many threads to work with from a setting such as "4".
+ * Return false if it isn't a whole number from 1 to 4096.
+ */
+bool set_thread_count(const std::string& setting) {
+	char* end;
+	auto count = std::strtoull(setting.c_str(), &end, 10);
+	if (setting.empty() || *end != '\0' || setting[0] == '-' ||
+			count == 0 || count > 4096) {
+		return false;
+	}
+
+	threads_set = static_cast<std::size_t>(count);
+	return true;
+}
+
+
+/**
+ * Run a job on this thread and on up to helpers threads of the pool.
+ */
+void run_on_pool(std::size_t helpers, const std::function<void()>& job) {
+	pool.run(helpers, job);
+}
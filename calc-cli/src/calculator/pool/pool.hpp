@@ -0,0 +1,40 @@
+#pragma once
+#ifndef CALC_CLI_POOL_HPP
+#define CALC_CLI_POOL_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * pool.hpp declares how many threads calc-cli works with, and the pool
+ * of threads which evaluates parts of one expression concurrently.
+ *
+ * An expression can be split across threads many times over, as a
+ * function whose body is a large reduction is called for every value
+ * of another; the threads are started once, the first time they are
+ * needed, and kept until calc-cli exits, so each split only wakes them.
+ */
+
+
+#include <string>
+#include <cstddef>
+#include <functional>
+
+
+// how many threads to work with: as many as there are processors,
+// unless set by --threads
+std::size_t thread_count();
+
+// set from a setting such as "4"; return false unless it is a whole
+// number from 1 to 4096
+bool set_thread_count(const std::string& setting);
+
+// run job on this thread and on as many as helpers threads of the
+// pool at once, and return once every one of them has returned. If
+// the pool is already running another job, as when several lines of a
+// script are evaluated at once, job runs on this thread only, so it
+// must be able to do all of the work alone
+void run_on_pool(std::size_t helpers, const std::function<void()>& job);
+
+
+#endif // !CALC_CLI_POOL_HPP
@@ -0,0 +1,507 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * profile.cpp defines the profiler from profile.hpp.
+ *
+ * The time of every recording is added to a tree of paths, shared by
+ * every thread, in which each subexpression is a child of the one it
+ * was evaluated in. Paths are cut off at max_depth, e.g. in a long
+ * chain of additions, with the time below counted as the self time of
+ * the deepest subexpression kept.
+ */
+
+
+#include <map>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+
+#include "profile.hpp"
+#include "../numeric/numeric.hpp"
+
+
+using std::string;
+using std::vector;
+
+using ull = unsigned long long;
+using std::chrono::nanoseconds;
+
+
+// deepest path kept in the profile
+constexpr std::size_t max_depth = 64;
+
+// a subexpression is shown by at most about this many characters of
+// its text, and this many levels of its operands
+constexpr std::size_t max_text = 80;
+constexpr std::size_t max_nesting = 6;
+
+
+struct Path {
+	string text;				// of the subexpression at its end
+	std::size_t parent = 0;
+	std::size_t depth = 0;
+	std::map<string, std::size_t> children{};
+	ull calls = 0;
+	nanoseconds self{};
+	nanoseconds total{};
+};
+
+
+void describe(const Node& node, string& text, std::size_t nesting);
+void describe_polynomial(const Node& poly, string& text,
+	std::size_t nesting);
+string describe(const Node& node);
+int precedence(const Node& node);
+
+std::size_t add_path(std::size_t parent, const string& text);
+
+
+bool profile_enabled = false;
+string profile_path;			// set before anything is evaluated
+
+std::mutex profile_lock;		// guards paths
+vector<Path> paths{ Path{ "", 0, 0 } };		// the first is the root
+
+thread_local Profile_recording* recording = nullptr;
+
+
+/**
+ * Start profiling every evaluation from now on; the profile is
+ * written to path by write_profile.
+ */
+void start_profiling(const string& path) {
+	profile_path = path;
+	profile_enabled = true;
+}
+
+
+bool is_profiling() {
+	return profile_enabled;
+}
+
+
+/**
+ * Write the profile to its file as folded stacks: one line per path,
+ * its subexpressions separated by semicolons, followed by its self
+ * time in nanoseconds. Return false if the file can't be written.
+ */
+bool write_profile() {
+	std::ofstream out{ profile_path, std::ios::trunc };
+
+	std::lock_guard<std::mutex> guard{ profile_lock };
+	for (std::size_t i = 1; i < paths.size(); ++i) {
+		if (paths[i].self.count() <= 0) {
+			continue;
+		}
+
+		vector<const string*> stack;
+		for (auto p = i; p != 0; p = paths[p].parent) {
+			stack.push_back(&paths[p].text);
+		}
+
+		for (auto t = stack.rbegin(); t != stack.rend(); ++t) {
+			out << ((t == stack.rbegin()) ? "" : ";") << **t;
+		}
+		out << ' ' << paths[i].self.count() << '\n';
+	}
+
+	return static_cast<bool>(out);
+}
+
+
+/**
+ * Return the count subexpressions with the most self time, most
+ * first. A subexpression reached along several paths is counted once,
+ * with the time of all of them; its total time leaves out paths within
+ * itself, which it includes already.
+ */
+vector<Hot_spot> hot_spots(std::size_t count) {
+	std::map<string, Hot_spot> by_text;
+	{
+		std::lock_guard<std::mutex> guard{ profile_lock };
+		for (std::size_t i = 1; i < paths.size(); ++i) {
+			const auto& p = paths[i];
+			auto& h = by_text[p.text];
+
+			h.expression = p.text;
+			h.calls += p.calls;
+			h.self += std::chrono::duration<double>(p.self).count();
+
+			auto outer = p.parent;
+			while (outer != 0 && paths[outer].text != p.text) {
+				outer = paths[outer].parent;
+			}
+			if (outer == 0) {
+				h.total += std::chrono::duration<double>(p.total).count();
+			}
+		}
+	}
+
+	vector<Hot_spot> hot;
+	for (auto& h : by_text) {
+		hot.push_back(std::move(h.second));
+	}
+
+	std::sort(hot.begin(), hot.end(),
+		[](const Hot_spot& a, const Hot_spot& b) {
+			return a.self > b.self; });
+	hot.resize(std::min(count, hot.size()));
+
+	return hot;
+}
+
+
+/**
+ * Return the time spent in every expression evaluated while
+ * profiling.
+ */
+double profiled_seconds() {
+	std::lock_guard<std::mutex> guard{ profile_lock };
+
+	nanoseconds total{};
+	for (auto c : paths[0].children) {
+		total += paths[c.second].total;
+	}
+
+	return std::chrono::duration<double>(total).count();
+}
+
+
+Profile_recording::Profile_recording() {
+	if (!profile_enabled || recording) {
+		return;
+	}
+
+	active = true;
+	entries.push_back(Entry{ nullptr, 0 });
+	recording = this;
+}
+
+
+/**
+ * Add the time of every Node evaluated to the profile.
+ */
+Profile_recording::~Profile_recording() {
+	if (!active) {
+		return;
+	}
+
+	recording = nullptr;
+
+	vector<Clock::duration> inner(entries.size());
+	for (std::size_t i = 1; i < entries.size(); ++i) {
+		inner[entries[i].parent] += entries[i].time;
+	}
+
+	// an Entry is always added after the one it is within
+	vector<std::size_t> path(entries.size(), 0);
+
+	std::lock_guard<std::mutex> guard{ profile_lock };
+	for (std::size_t i = 1; i < entries.size(); ++i) {
+		const auto& e = entries[i];
+		auto parent = path[e.parent];
+
+		if (paths[parent].depth < max_depth) {
+			path[i] = add_path(parent, describe(*e.node));
+			paths[path[i]].calls += e.calls;
+			paths[path[i]].total +=
+				std::chrono::duration_cast<nanoseconds>(e.time);
+		} else {
+			path[i] = parent;
+		}
+
+		paths[path[i]].self +=
+			std::chrono::duration_cast<nanoseconds>(e.time - inner[i]);
+	}
+}
+
+
+/**
+ * Note that evaluation of a Node has started, and return true, or
+ * return false if it isn't recorded: numbers and variables take less
+ * time than reading the clock, and an inlined call is shown as its
+ * body.
+ */
+bool Profile_recording::enter(const Node& n) {
+	switch (n.type) {
+	case Node_type::number:
+	case Node_type::previous:
+	case Node_type::local:
+	case Node_type::bind:
+		return false;
+	default:
+		break;
+	}
+
+	auto parent = open.empty() ? 0 : open.back().first;
+	auto i = index.emplace(Key{ parent, &n }, entries.size());
+	if (i.second) {
+		entries.push_back(Entry{ &n, parent });
+	}
+
+	open.emplace_back(i.first->second, Clock::now());
+	return true;
+}
+
+
+/**
+ * Note that evaluation of the Node entered last has finished, having
+ * computed the given number of values.
+ */
+void Profile_recording::leave(ull calls) {
+	auto& e = entries[open.back().first];
+	e.time += Clock::now() - open.back().second;
+	e.calls += calls;
+
+	open.pop_back();
+}
+
+
+/**
+ * Return the index of the path from parent to the subexpression with
+ * the given text, adding it if it's new.
+ */
+std::size_t add_path(std::size_t parent, const string& text) {
+	auto c = paths[parent].children.find(text);
+	if (c != paths[parent].children.end()) {
+		return c->second;
+	}
+
+	auto i = paths.size();
+	paths.push_back(Path{ text, parent, paths[parent].depth + 1 });
+	paths[parent].children.emplace(text, i);
+
+	return i;
+}
+
+
+/**
+ * Return the text of a subexpression, as it could have been typed,
+ * shortened to about max_text characters.
+ */
+string describe(const Node& n) {
+	string text;
+	describe(n, text, 0);
+
+	if (text.size() > max_text) {
+		text.resize(max_text);
+		text += "...";
+	}
+
+	return text;
+}
+
+
+/**
+ * Append the text of a subexpression to text, with no more than the
+ * given number of levels of operands above it, and only until the
+ * text is long enough.
+ */
+void describe(const Node& n, string& text, std::size_t nesting) {
+	if (text.size() > max_text) {
+		return;
+	}
+
+	if (nesting > max_nesting) {
+		text += "...";
+		return;
+	}
+
+	// an operand is put in parentheses if it binds less tightly than
+	// the grammar expects there
+	auto operand = [&](const Node& c, int least) {
+		bool parens = precedence(c) < least;
+		text += parens ? "(" : "";
+		describe(c, text, nesting + 1);
+		text += parens ? ")" : "";
+	};
+
+	auto list = [&](std::size_t first) {
+		for (auto i = first; i < n.children.size(); ++i) {
+			text += (i > first) ? ", " : "";
+			describe(n.children[i], text, nesting + 1);
+		}
+	};
+
+	const char* symbol = nullptr;
+	switch (n.type) {
+	case Node_type::number: {
+		std::ostringstream value;
+		value << n.value;
+		text += value.str();
+		return;
+	}
+	case Node_type::previous:
+		text += "_";
+		return;
+	case Node_type::local:
+		text += n.name.empty() ? "#" + std::to_string(n.slot) : n.name;
+		return;
+	case Node_type::negate:
+		text += "-";
+		operand(n.children[0], precedence(n) + 1);
+		return;
+	case Node_type::factorial:
+		operand(n.children[0], precedence(n) + 1);
+		text += "!";
+		return;
+	case Node_type::bind:
+		describe(n.children[1], text, nesting);
+		return;
+	case Node_type::each:
+		describe(n.children[0], text, nesting);
+		return;
+	case Node_type::vector:
+		text += n.name;
+		return;
+	case Node_type::polynomial:
+		describe_polynomial(n, text, nesting);
+		return;
+	case Node_type::call:
+		text += n.name + "[";
+		list(0);
+		text += "]";
+		return;
+	case Node_type::select:
+		text += "if[";
+		list(0);
+		text += "]";
+		return;
+	case Node_type::range:
+		describe(n.children[0], text, nesting + 1);
+		text += "..";
+		describe(n.children[1], text, nesting + 1);
+		return;
+	case Node_type::sum:
+	case Node_type::product:
+		text += (n.type == Node_type::sum) ? "sum[" : "product[";
+		if (n.name.empty()) {		// a range streamed through a call
+			describe(n.children[0], text, nesting + 1);
+			text += "..";
+			describe(n.children[1], text, nesting + 1);
+		} else {
+			text += n.name + ", ";
+			list(0);
+		}
+		text += "]";
+		return;
+	case Node_type::integral:
+	case Node_type::root: {
+		// the tolerance is left out unless it was given
+		const auto& tol = n.children[3];
+		bool given = tol.type != Node_type::number ||
+			tol.value != default_tolerance;
+
+		text += (n.type == Node_type::integral) ? "integrate[" : "solve[";
+		text += n.name + ", ";
+		for (std::size_t i = 0; i < (given ? 4 : 3); ++i) {
+			text += (i > 0) ? ", " : "";
+			describe(n.children[i], text, nesting + 1);
+		}
+		text += "]";
+		return;
+	}
+	case Node_type::add: symbol = " + "; break;
+	case Node_type::subtract: symbol = " - "; break;
+	case Node_type::multiply: symbol = " * "; break;
+	case Node_type::divide: symbol = " / "; break;
+	case Node_type::mod: symbol = " % "; break;
+	case Node_type::power: symbol = " ^ "; break;
+	case Node_type::less: symbol = " < "; break;
+	case Node_type::less_equal: symbol = " <= "; break;
+	case Node_type::greater: symbol = " > "; break;
+	case Node_type::greater_equal: symbol = " >= "; break;
+	case Node_type::equal: symbol = " == "; break;
+	case Node_type::not_equal: symbol = " != "; break;
+	}
+
+	// binary operations group from the left
+	operand(n.children[0], precedence(n));
+	text += symbol;
+	operand(n.children[1], precedence(n) + 1);
+}
+
+
+/**
+ * Append the text of a polynomial as the sum of its terms, from the
+ * highest degree down, leaving out those which are 0.
+ */
+void describe_polynomial(const Node& n, string& text,
+		std::size_t nesting) {
+
+	auto degree = n.children.size() - 2;
+	bool first = true;
+	for (std::size_t i = 1; i < n.children.size(); ++i, --degree) {
+		auto c = n.children[i].value;
+		if (c == 0) {
+			continue;
+		}
+
+		text += first ? (c < 0 ? "-" : "") : (c < 0 ? " - " : " + ");
+		first = false;
+
+		std::ostringstream value;
+		value << std::abs(c);
+		if (degree == 0 || std::abs(c) != 1) {
+			text += value.str();
+			text += (degree > 0) ? " * " : "";
+		}
+
+		if (degree > 0) {
+			bool parens = precedence(n.children[0]) < 5;
+			text += parens ? "(" : "";
+			describe(n.children[0], text, nesting + 1);
+			text += parens ? ")" : "";
+			text += (degree > 1) ? " ^ " + std::to_string(degree) : "";
+		}
+	}
+}
+
+
+/**
+ * Return how tightly a subexpression binds, following the grammar in
+ * calculator.cpp: the higher, the tighter.
+ */
+int precedence(const Node& n) {
+	switch (n.type) {
+	case Node_type::less: case Node_type::less_equal:
+	case Node_type::greater: case Node_type::greater_equal:
+	case Node_type::equal: case Node_type::not_equal:
+		return 0;
+	case Node_type::add: case Node_type::subtract:
+		return 1;
+	case Node_type::multiply: case Node_type::divide:
+	case Node_type::mod:
+		return 2;
+	case Node_type::negate:
+		return 3;
+	case Node_type::power:
+		return 4;
+	case Node_type::factorial:
+		return 5;
+	case Node_type::number:
+		return (n.value < 0) ? 3 : 6;
+	case Node_type::bind:
+		return precedence(n.children[1]);
+	case Node_type::each:
+		return precedence(n.children[0]);
+	case Node_type::polynomial: {
+		// a single term c * x ^ d binds as tightly as its operator
+		auto terms = std::count_if(n.children.begin() + 1, n.children.end(),
+			[](const Node& c) { return c.value != 0; });
+		auto c = std::find_if(n.children.begin() + 1, n.children.end(),
+			[](const Node& c) { return c.value != 0; });
+		if (terms > 1) {
+			return 1;
+		}
+
+		return (c->value < 0) ? 3 : (c->value != 1) ? 2 : 4;
+	}
+	default:
+		return 6;
+	}
+}
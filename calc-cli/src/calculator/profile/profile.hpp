@@ -0,0 +1,148 @@
+#pragma once
+#ifndef CALC_CLI_PROFILE_HPP
+#define CALC_CLI_PROFILE_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * profile.hpp declares the profiler, which attributes the time spent
+ * evaluating compiled expressions to their subexpressions and calls,
+ * and adds it up over every evaluation while calc-cli runs.
+ *
+ * An evaluation is recorded by a Profile_recording, and each Node
+ * evaluated in it by a Profile_scope, which does nothing unless a
+ * recording is under way on its thread. The time of a Node is the
+ * time between entering and leaving it; its self time leaves out the
+ * Nodes it evaluated, but not the numbers and variables it read, which
+ * aren't recorded. Each subexpression is known by its path from the
+ * expression evaluated, so the same text used in two places is
+ * counted separately, and the paths can be written as folded stacks
+ * for a flame graph.
+ */
+
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+
+#include "../node/node.hpp"
+
+
+// a subexpression, with the time spent in it over every path to it
+struct Hot_spot {
+	std::string expression;
+	unsigned long long calls;	// values computed, a block at a time
+								// or one at a time
+	double self;				// seconds, leaving out subexpressions
+	double total;				// seconds
+};
+
+
+void start_profiling(const std::string& path);
+bool is_profiling();
+
+bool write_profile();
+std::vector<Hot_spot> hot_spots(std::size_t count);
+double profiled_seconds();
+
+
+/**
+ * The evaluation of an expression, from being constructed to being
+ * destroyed, which is then added to the profile. It records nothing
+ * unless profiling has started, or if another recording is under way
+ * on the same thread, which then records the evaluation instead.
+ * While recording, evaluation stays on this thread, so that the time
+ * of each Node is all spent in it.
+ */
+class Profile_recording {
+public:
+	Profile_recording();
+	~Profile_recording();
+
+	Profile_recording(const Profile_recording&) = delete;
+	Profile_recording& operator=(const Profile_recording&) = delete;
+
+	bool enter(const Node& node);
+	void leave(unsigned long long calls);
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Entry {
+		const Node* node;
+		std::size_t parent;			// index of the Entry it is within
+		unsigned long long calls = 0;
+		Clock::duration time{};		// including subexpressions
+	};
+
+	struct Key {
+		std::size_t parent;
+		const Node* node;
+
+		bool operator==(const Key& other) const {
+			return parent == other.parent && node == other.node;
+		}
+	};
+
+	struct Key_hash {
+		std::size_t operator()(const Key& k) const {
+			return std::hash<const Node*>{}(k.node) ^
+				static_cast<std::size_t>(k.parent * 0x9e3779b97f4a7c15ull);
+		}
+	};
+
+	bool active = false;
+	std::vector<Entry> entries;		// the first is the whole evaluation,
+									// with no Node
+	std::unordered_map<Key, std::size_t, Key_hash> index;
+
+	// the Entries entered and not yet left, innermost last, with the
+	// time each was entered
+	std::vector<std::pair<std::size_t, Clock::time_point>> open;
+};
+
+
+// has profiling started? It starts before anything is evaluated, and
+// is checked before the recording, which costs more to read
+extern bool profile_enabled;
+
+// the recording under way on this thread, if any
+extern thread_local Profile_recording* recording;
+
+
+/**
+ * The evaluation of one Node, for count values at once, for the
+ * recording under way on this thread, if any. A scope constructed
+ * with profiled false does nothing, and compiles to nothing.
+ */
+class Profile_scope {
+public:
+	Profile_scope(const Node& node, unsigned long long count,
+			bool profiled = true)
+			:calls{ count } {
+		if (profiled && profile_enabled && recording) {
+			active = recording->enter(node);
+		}
+	}
+
+	~Profile_scope() {
+		if (active) {
+			recording->leave(calls);
+		}
+	}
+
+	Profile_scope(const Profile_scope&) = delete;
+	Profile_scope& operator=(const Profile_scope&) = delete;
+
+private:
+	unsigned long long calls;
+	bool active = false;
+};
+
+
+#endif // !CALC_CLI_PROFILE_HPP
@@ -0,0 +1,35 @@
+#pragma once
+#ifndef CALC_CLI_REAL_HPP
+#define CALC_CLI_REAL_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * real.hpp defines Real, the type of every number the calculator
+ * reads, stores and computes with. It is double unless the program is
+ * built with one of:
+ *
+ * CALC_CLI_FLOAT			float: half the memory, and twice the values
+ *							per SIMD register, for bulk work where six
+ *							or seven digits are enough
+ * CALC_CLI_LONG_DOUBLE		long double: extra digits where the
+ *							platform has them (not MSVC, where long
+ *							double is double)
+ */
+
+
+#if defined(CALC_CLI_FLOAT) && defined(CALC_CLI_LONG_DOUBLE)
+#error "define at most one of CALC_CLI_FLOAT and CALC_CLI_LONG_DOUBLE"
+#endif
+
+#if defined(CALC_CLI_FLOAT)
+using Real = float;
+#elif defined(CALC_CLI_LONG_DOUBLE)
+using Real = long double;
+#else
+using Real = double;
+#endif
+
+
+#endif // !CALC_CLI_REAL_HPP
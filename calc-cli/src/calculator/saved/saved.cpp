@@ -0,0 +1,562 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * saved.cpp defines Saved_session and save_session from saved.hpp.
+ */
+
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include "saved.hpp"
+
+
+using std::string;
+using std::vector;
+
+using u64 = std::uint64_t;
+
+
+static_assert(std::is_trivially_copyable<Running_stats>::value,
+	"statistics are saved as they are in memory");
+
+
+bool is_well_formed(std::uint32_t type, u64 children);
+
+u64 aligned(u64 offset);
+
+void add_order(const string& name,
+	const std::map<string, User_func>& functions,
+	std::set<string>& seen, vector<string>& order);
+void add_calls(const Node& node, std::set<string>& called);
+
+void add_records(const Node& node, vector<Node_record>& records,
+	string& names);
+
+
+Saved_session::Saved_session(const string& path)
+		:path{ path }, file{ path, File_access::random } {
+
+	if (!file) {
+		throw File_error{ "can't read " + path };
+	}
+
+	auto start = file.data();
+	auto size = static_cast<u64>(file.size());
+	if (size < sizeof(Session_header) || std::memcmp(start,
+			session_magic, sizeof(session_magic)) != 0) {
+		throw File_error{ path + " isn't a saved session" };
+	}
+
+	header = reinterpret_cast<const Session_header*>(start);
+	if (header->version != session_version ||
+			header->byte_order != byte_order_mark) {
+		throw File_error{ path + " was saved by another version of "
+			"calc-cli" };
+	}
+
+	if (header->real_size != sizeof(Real)) {
+		throw File_error{ path + " was saved with another number type" };
+	}
+
+	// every table lies within the file, where its entries can be read
+	auto fits = [size](u64 offset, u64 count, std::size_t entry,
+			std::size_t alignment) {
+		return offset % alignment == 0 && offset <= size &&
+			count <= (size - offset) / entry;
+	};
+
+	const auto& h = *header;
+	if (h.size != size ||
+			!fits(h.state, 1, sizeof(Session_state),
+				alignof(Session_state)) ||
+			!fits(h.variables, h.variable_count, sizeof(Variable_entry),
+				alignof(Variable_entry)) ||
+			!fits(h.vectors, h.vector_count, sizeof(Vector_entry),
+				alignof(Vector_entry)) ||
+			!fits(h.elements, h.element_count, sizeof(Real),
+				alignof(Real)) ||
+			!fits(h.functions, h.function_count, sizeof(Function_entry),
+				alignof(Function_entry)) ||
+			!fits(h.nodes, h.node_count, sizeof(Node_record),
+				alignof(Node_record)) ||
+			!fits(h.names, h.names_size, 1, 1)) {
+		throw damaged();
+	}
+
+	variables = reinterpret_cast<const Variable_entry*>(
+		start + h.variables);
+	vectors = reinterpret_cast<const Vector_entry*>(start + h.vectors);
+	elements = reinterpret_cast<const Real*>(start + h.elements);
+	functions = reinterpret_cast<const Function_entry*>(
+		start + h.functions);
+	nodes = reinterpret_cast<const Node_record*>(start + h.nodes);
+	names = start + h.names;
+}
+
+
+/**
+ * Find a variable by binary search, comparing names where they are in
+ * the file.
+ */
+const Real* Saved_session::find(const string& name) const {
+	auto end = variables + header->variable_count;
+	auto v = std::lower_bound(variables, end, name,
+		[this](const Variable_entry& entry, const string& n) {
+			return compare(n, entry.name, entry.length) > 0; });
+
+	return (v != end && compare(name, v->name, v->length) == 0)
+		? &v->value : nullptr;
+}
+
+
+/**
+ * Find a vector by binary search, as find does for a variable.
+ */
+std::shared_ptr<const vector<Real>> Saved_session::find_vector(
+		const string& name) const {
+	auto end = vectors + header->vector_count;
+	auto v = std::lower_bound(vectors, end, name,
+		[this](const Vector_entry& entry, const string& n) {
+			return compare(n, entry.name, entry.length) > 0; });
+
+	if (v == end || compare(name, v->name, v->length) != 0) {
+		return nullptr;
+	}
+
+	return vector_elements(static_cast<std::size_t>(v - vectors));
+}
+
+
+string Saved_session::variable_name(std::size_t i) const {
+	return name(variables[i].name, variables[i].length);
+}
+
+
+string Saved_session::vector_name(std::size_t i) const {
+	return name(vectors[i].name, vectors[i].length);
+}
+
+
+std::shared_ptr<const vector<Real>> Saved_session::vector_elements(
+		std::size_t i) const {
+	const auto& v = vectors[i];
+	if (v.first > header->element_count ||
+			v.count > header->element_count - v.first) {
+		throw damaged();
+	}
+
+	auto first = elements + v.first;
+	return std::make_shared<const vector<Real>>(first, first + v.count);
+}
+
+
+string Saved_session::function_name(std::size_t i) const {
+	return name(functions[i].name, functions[i].length);
+}
+
+
+/**
+ * Return the function at i, with each of its calls linked to the
+ * function it calls.
+ */
+User_func Saved_session::function(std::size_t i,
+		const Node_linker& link) const {
+
+	const auto& f = functions[i];
+	auto next = f.body;
+	User_func fn{ static_cast<std::size_t>(f.arity), node(next, link) };
+
+	// slots are numbered from 0, so a damaged one can make the frame
+	// too large to allocate
+	if (frame_size(fn.body) > fn.arity + size(fn.body)) {
+		throw damaged();
+	}
+
+	return fn;
+}
+
+
+Real Saved_session::previous() const {
+	Real prev;
+	std::memcpy(&prev, file.data() + header->state +
+		offsetof(Session_state, prev), sizeof(prev));
+
+	return prev;
+}
+
+
+Running_stats Saved_session::statistics() const {
+	Running_stats results;
+	std::memcpy(&results, file.data() + header->state +
+		offsetof(Session_state, results), sizeof(results));
+
+	return results;
+}
+
+
+/**
+ * Return the name at the given offset from the start of the names.
+ */
+string Saved_session::name(u64 offset, u64 length) const {
+	if (offset > header->names_size ||
+			length > header->names_size - offset) {
+		throw damaged();
+	}
+
+	return string(names + offset, static_cast<std::size_t>(length));
+}
+
+
+/**
+ * Compare a name with one in the file, as std::string::compare does.
+ */
+int Saved_session::compare(const string& n, u64 offset,
+		u64 length) const {
+	if (offset > header->names_size ||
+			length > header->names_size - offset) {
+		throw damaged();
+	}
+
+	return n.compare(0, n.size(), names + offset,
+		static_cast<std::size_t>(length));
+}
+
+
+/**
+ * Rebuild the Node whose record is at next, and its children, leaving
+ * next just past their records.
+ */
+Node Saved_session::node(u64& next, const Node_linker& link) const {
+	if (next >= header->node_count) {
+		throw damaged();
+	}
+
+	const auto& r = nodes[next++];
+	if (!is_well_formed(r.type, r.children) ||
+			r.children > header->node_count - next) {
+		throw damaged();
+	}
+
+	Node n{ static_cast<Node_type>(r.type), r.value,
+		static_cast<std::size_t>(r.slot) };
+	n.impure = (r.flags & impure_flag) != 0;
+	n.parallel = (r.flags & parallel_flag) != 0;
+
+	if (r.length > 0 || n.type == Node_type::call) {
+		n.name = name(r.name, r.length);
+	}
+
+	if (n.type == Node_type::call) {
+		link(n, n.name);
+	}
+
+	n.children.reserve(static_cast<std::size_t>(r.children));
+	for (u64 i = 0; i < r.children; ++i) {
+		n.children.push_back(node(next, link));
+	}
+
+	return n;
+}
+
+
+File_error Saved_session::damaged() const {
+	return File_error{ path + " is damaged" };
+}
+
+
+/**
+ * Write a session to a file: the variables and vectors, along with
+ * those of the session they were loaded with, if any, the user-defined
+ * functions,
+ * `_` and the statistics. The file is written beside path, then
+ * renamed, so that a session loaded from path is left as it was.
+ */
+void save_session(const string& path,
+		const std::map<string, Real>& variables,
+		const std::map<string, std::shared_ptr<const vector<Real>>>& vectors,
+		const Saved_session* loaded,
+		const std::map<string, User_func>& functions,
+		Real prev, const Running_stats& results) {
+
+	string names;
+	auto add_name = [&names](const string& name) {
+		auto offset = static_cast<u64>(names.size());
+		names += name;
+		return offset;
+	};
+
+	// merge the variables with the loaded ones; both are in order, and
+	// no name is in both
+	vector<Variable_entry> vars;
+	auto v = variables.begin();
+	std::size_t l = 0;
+	auto count = loaded ? loaded->variable_count() : 0;
+	while (v != variables.end() || l < count) {
+		bool from_map = (l == count) || (v != variables.end() &&
+			v->first < loaded->variable_name(l));
+
+		Variable_entry entry{};
+		if (from_map) {
+			entry.length = v->first.size();
+			entry.name = add_name(v->first);
+			entry.value = v->second;
+			++v;
+		} else {
+			auto name = loaded->variable_name(l);
+			entry.length = name.size();
+			entry.name = add_name(name);
+			entry.value = loaded->variable_value(l);
+			++l;
+		}
+
+		vars.push_back(entry);
+	}
+
+	// and the vectors the same way, with their elements
+	vector<Vector_entry> vecs;
+	vector<Real> elements;
+	auto add_vector = [&](const string& name, const vector<Real>& e) {
+		Vector_entry entry{};
+		entry.length = name.size();
+		entry.name = add_name(name);
+		entry.first = elements.size();
+		entry.count = e.size();
+		elements.insert(elements.end(), e.begin(), e.end());
+
+		vecs.push_back(entry);
+	};
+
+	auto w = vectors.begin();
+	l = 0;
+	count = loaded ? loaded->vector_count() : 0;
+	while (w != vectors.end() || l < count) {
+		if ((l == count) || (w != vectors.end() &&
+				w->first < loaded->vector_name(l))) {
+			add_vector(w->first, *w->second);
+			++w;
+		} else {
+			add_vector(loaded->vector_name(l), *loaded->vector_elements(l));
+			++l;
+		}
+	}
+
+	std::set<string> seen;
+	vector<string> order;
+	for (const auto& f : functions) {
+		add_order(f.first, functions, seen, order);
+	}
+
+	vector<Function_entry> fns;
+	vector<Node_record> records;
+	for (const auto& name : order) {
+		const auto& fn = functions.at(name);
+
+		Function_entry entry{};
+		entry.length = name.size();
+		entry.name = add_name(name);
+		entry.arity = fn.arity;
+		entry.body = records.size();
+		fns.push_back(entry);
+
+		add_records(fn.body, records, names);
+	}
+
+	Session_header header{};
+	std::memcpy(header.magic, session_magic, sizeof(session_magic));
+	header.version = session_version;
+	header.byte_order = byte_order_mark;
+	header.real_size = sizeof(Real);
+
+	header.state = aligned(sizeof(header));
+	header.variables = aligned(header.state + sizeof(Session_state));
+	header.variable_count = vars.size();
+	header.vectors = aligned(header.variables +
+		vars.size() * sizeof(Variable_entry));
+	header.vector_count = vecs.size();
+	header.elements = aligned(header.vectors +
+		vecs.size() * sizeof(Vector_entry));
+	header.element_count = elements.size();
+	header.functions = aligned(header.elements +
+		elements.size() * sizeof(Real));
+	header.function_count = fns.size();
+	header.nodes = aligned(header.functions +
+		fns.size() * sizeof(Function_entry));
+	header.node_count = records.size();
+	header.names = aligned(header.nodes +
+		records.size() * sizeof(Node_record));
+	header.names_size = names.size();
+	header.size = header.names + names.size();
+
+	string contents(static_cast<std::size_t>(header.size), '\0');
+	auto put = [&contents](u64 offset, const void* from, std::size_t n) {
+		// an empty table has nothing to copy, and maybe no data()
+		if (n > 0) {
+			std::memcpy(&contents[offset], from, n);
+		}
+	};
+
+	put(0, &header, sizeof(header));
+	put(header.state + offsetof(Session_state, prev), &prev,
+		sizeof(prev));
+	put(header.state + offsetof(Session_state, results), &results,
+		sizeof(results));
+	put(header.variables, vars.data(),
+		vars.size() * sizeof(Variable_entry));
+	put(header.vectors, vecs.data(), vecs.size() * sizeof(Vector_entry));
+	put(header.elements, elements.data(), elements.size() * sizeof(Real));
+	put(header.functions, fns.data(),
+		fns.size() * sizeof(Function_entry));
+	put(header.nodes, records.data(),
+		records.size() * sizeof(Node_record));
+	put(header.names, names.data(), names.size());
+
+	auto temporary = path + ".tmp";
+	std::ofstream out{ temporary, std::ios::binary | std::ios::trunc };
+	out.write(contents.data(), contents.size());
+	out.close();
+
+#ifdef _WIN32
+	bool written = out && MoveFileExA(temporary.c_str(), path.c_str(),
+		MOVEFILE_REPLACE_EXISTING);
+#else
+	bool written = out &&
+		std::rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+
+	if (!written) {
+		std::remove(temporary.c_str());
+		throw File_error{ "can't write " + path };
+	}
+}
+
+
+/**
+ * Can a Node of the given type, with the given number of children, be
+ * evaluated?
+ */
+bool is_well_formed(std::uint32_t type, u64 children) {
+	switch (static_cast<Node_type>(type)) {
+	case Node_type::number:
+	case Node_type::previous:
+	case Node_type::local:
+		return children == 0;
+	case Node_type::negate:
+	case Node_type::factorial:
+		return children == 1;
+	case Node_type::add:
+	case Node_type::subtract:
+	case Node_type::multiply:
+	case Node_type::divide:
+	case Node_type::mod:
+	case Node_type::power:
+	case Node_type::less:
+	case Node_type::less_equal:
+	case Node_type::greater:
+	case Node_type::greater_equal:
+	case Node_type::equal:
+	case Node_type::not_equal:
+	case Node_type::range:
+	case Node_type::bind:
+		return children == 2;
+	case Node_type::select:
+	case Node_type::sum:
+	case Node_type::product:
+		return children == 3;
+	case Node_type::integral:
+	case Node_type::root:
+		return children == 4;
+	case Node_type::polynomial:
+		return children >= 2;
+	case Node_type::call:
+		return true;
+	default:
+		return false;
+	}
+}
+
+
+/**
+ * Round an offset up to the next multiple of table_alignment.
+ */
+u64 aligned(u64 offset) {
+	return (offset + table_alignment - 1) / table_alignment *
+		table_alignment;
+}
+
+
+/**
+ * Add a function to order after the user-defined functions it calls,
+ * unless it has been seen already. Definitions can't be circular.
+ */
+void add_order(const string& name,
+		const std::map<string, User_func>& functions,
+		std::set<string>& seen, vector<string>& order) {
+
+	auto f = functions.find(name);
+	if (f == functions.end() || !seen.insert(name).second) {
+		return;
+	}
+
+	std::set<string> called;
+	add_calls(f->second.body, called);
+	for (const auto& c : called) {
+		add_order(c, functions, seen, order);
+	}
+
+	order.push_back(name);
+}
+
+
+/**
+ * Add the name of every function called in an expression to called.
+ */
+void add_calls(const Node& n, std::set<string>& called) {
+	if (n.type == Node_type::call) {
+		called.insert(n.name);
+	}
+
+	for (const auto& c : n.children) {
+		add_calls(c, called);
+	}
+}
+
+
+/**
+ * Append the records of a Node and its children, in preorder.
+ */
+void add_records(const Node& n, vector<Node_record>& records,
+		string& names) {
+
+	Node_record r{};
+	r.type = static_cast<std::uint32_t>(n.type);
+	r.flags = (n.impure ? impure_flag : 0) |
+		(n.parallel ? parallel_flag : 0);
+	r.slot = n.slot;
+	r.children = n.children.size();
+	r.value = n.value;
+
+	if (!n.name.empty()) {
+		r.name = names.size();
+		r.length = n.name.size();
+		names += n.name;
+	}
+
+	records.push_back(r);
+	for (const auto& c : n.children) {
+		add_records(c, records, names);
+	}
+}
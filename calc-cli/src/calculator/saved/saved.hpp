@@ -0,0 +1,219 @@
+#pragma once
+#ifndef CALC_CLI_SAVED_HPP
+#define CALC_CLI_SAVED_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * saved.hpp declares Saved_session, a calculator's state saved to a
+ * file and mapped back into memory, and save_session, which writes
+ * one.
+ *
+ * The file is laid out to be used where it is mapped, without being
+ * parsed or copied:
+ *
+ * Session_header	what the file holds, and where
+ * Session_state	`_` and the statistics
+ * Variable_entry	one per variable, sorted by name
+ * Vector_entry		one per variable whose value is a vector, sorted
+ *					by name
+ * Real				the elements of those vectors, one after another
+ * Function_entry	one per user-defined function, each after the
+ *					functions it calls
+ * Node_record		the compiled bodies of the functions, in preorder
+ * names			every name used above, one after another
+ *
+ * Offsets are counted in bytes from the start of the file, and each
+ * table starts at a multiple of table_alignment. Numbers are stored
+ * as Real, in the machine's byte order, so a file is only loaded by
+ * a build with the same Real, byte order and session_version.
+ */
+
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+#include "../node/node.hpp"
+#include "../stats/stats.hpp"
+#include "../exceptions/exceptions.hpp"
+#include "../../utils/mapped_file.hpp"
+
+
+constexpr char session_magic[8] = { 'c', 'a', 'l', 'c', 's', 'e', 's',
+	's' };
+
+// changes whenever the layout does, or the meaning of a Node_type
+constexpr std::uint32_t session_version = 5;
+
+// written as is, to tell the byte order a file was saved in
+constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+constexpr std::size_t table_alignment = 64;
+
+
+struct Session_header {
+	char magic[8];					// session_magic
+	std::uint32_t version;			// session_version
+	std::uint32_t byte_order;		// byte_order_mark
+	std::uint64_t real_size;		// sizeof(Real)
+	std::uint64_t size;				// of the whole file
+
+	std::uint64_t state;			// offset of the Session_state
+	std::uint64_t variables;		// offset of the Variable_entries
+	std::uint64_t variable_count;
+	std::uint64_t vectors;			// offset of the Vector_entries
+	std::uint64_t vector_count;
+	std::uint64_t elements;			// offset of their elements
+	std::uint64_t element_count;
+	std::uint64_t functions;		// offset of the Function_entries
+	std::uint64_t function_count;
+	std::uint64_t nodes;			// offset of the Node_records
+	std::uint64_t node_count;
+	std::uint64_t names;			// offset of the names
+	std::uint64_t names_size;
+};
+
+
+struct Session_state {
+	Real prev;
+	Running_stats results;
+};
+
+
+// a name is given by its offset from the start of the names, and its
+// length
+struct Variable_entry {
+	std::uint64_t name;
+	std::uint64_t length;
+	Real value;
+};
+
+
+struct Vector_entry {
+	std::uint64_t name;
+	std::uint64_t length;
+	std::uint64_t first;			// index of its first element
+	std::uint64_t count;			// how many elements it has
+};
+
+
+struct Function_entry {
+	std::uint64_t name;
+	std::uint64_t length;
+	std::uint64_t arity;
+	std::uint64_t body;				// index of its first Node_record
+};
+
+
+struct Node_record {
+	std::uint32_t type;				// a Node_type
+	std::uint32_t flags;			// impure_flag and parallel_flag
+	std::uint64_t slot;
+	std::uint64_t children;			// how many; the record of each
+									// child, and those of its own
+									// children, follow in order
+	std::uint64_t name;				// of the function called, for
+	std::uint64_t length;			// Node_type::call, or of an index
+									// variable
+	Real value;
+};
+
+constexpr std::uint32_t impure_flag = 1;
+constexpr std::uint32_t parallel_flag = 2;
+
+
+// give a call Node loaded from a file the function with the given
+// name, and whatever goes with it
+using Node_linker =
+	std::function<void(Node& call, const std::string& name)>;
+
+
+/**
+ * A saved session, mapped into memory. Its variables are looked up
+ * where they are in the file; its functions are compiled already, and
+ * only need to be linked to the functions they call.
+ */
+class Saved_session {
+public:
+	// map a file, throwing File_error if it can't be read or wasn't
+	// saved by this build
+	explicit Saved_session(const std::string& path);
+
+	Saved_session(const Saved_session&) = delete;
+	Saved_session& operator=(const Saved_session&) = delete;
+
+	// the value of the named variable, or nullptr if there is none
+	const Real* find(const std::string& name) const;
+
+	std::size_t variable_count() const {
+		return static_cast<std::size_t>(header->variable_count);
+	}
+
+	// variables are in order of their names
+	std::string variable_name(std::size_t i) const;
+
+	Real variable_value(std::size_t i) const {
+		return variables[i].value;
+	}
+
+	// the elements of the named vector, or nullptr if there is none;
+	// they are copied out of the file
+	std::shared_ptr<const std::vector<Real>> find_vector(
+		const std::string& name) const;
+
+	std::size_t vector_count() const {
+		return static_cast<std::size_t>(header->vector_count);
+	}
+
+	// vectors are in order of their names
+	std::string vector_name(std::size_t i) const;
+	std::shared_ptr<const std::vector<Real>> vector_elements(
+		std::size_t i) const;
+
+	std::size_t function_count() const {
+		return static_cast<std::size_t>(header->function_count);
+	}
+
+	// functions are in an order in which they can be defined
+	std::string function_name(std::size_t i) const;
+	User_func function(std::size_t i, const Node_linker& link) const;
+
+	Real previous() const;
+	Running_stats statistics() const;
+
+private:
+	std::string path;
+	Mapped_file file;
+
+	const Session_header* header = nullptr;
+	const Variable_entry* variables = nullptr;
+	const Vector_entry* vectors = nullptr;
+	const Real* elements = nullptr;
+	const Function_entry* functions = nullptr;
+	const Node_record* nodes = nullptr;
+	const char* names = nullptr;
+
+	std::string name(std::uint64_t offset, std::uint64_t length) const;
+	int compare(const std::string& name, std::uint64_t offset,
+		std::uint64_t length) const;
+	Node node(std::uint64_t& next, const Node_linker& link) const;
+	File_error damaged() const;
+};
+
+
+void save_session(const std::string& path,
+	const std::map<std::string, Real>& variables,
+	const std::map<std::string,
+		std::shared_ptr<const std::vector<Real>>>& vectors,
+	const Saved_session* loaded,
+	const std::map<std::string, User_func>& functions,
+	Real prev, const Running_stats& results);
+
+
+#endif // !CALC_CLI_SAVED_HPP
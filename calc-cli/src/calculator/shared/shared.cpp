@@ -0,0 +1,172 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * shared.cpp defines the classes from shared.hpp.
+ */
+
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shared.hpp"
+#include "../token/token.hpp"
+
+
+/**
+ * Return the current snapshot, and store its version, without taking
+ * the lock. The version is read first: a snapshot published in between
+ * is returned with the version before it, so it is only fetched again.
+ */
+std::shared_ptr<const Calculator> Shared_calculator::snapshot(
+		unsigned long long& version) const {
+
+	version = published.load(std::memory_order_acquire);
+	return std::atomic_load(&current);
+}
+
+
+/**
+ * Run a declaration, seeing prev as `_`, and publish the definitions
+ * it leaves as the new snapshot. Return its value. If the declaration
+ * fails, nothing is published.
+ *
+ * The declaration runs on a copy of the current snapshot without the
+ * lock, so that declarations which take long don't wait for each
+ * other. If another has been published meanwhile, the name it defines
+ * is copied into the newer snapshot instead; a script orders the
+ * lines declaring and using any one name, so that snapshot can only
+ * differ by names this declaration doesn't use.
+ */
+Real Shared_calculator::define(const std::string& input, Real prev,
+		std::shared_ptr<const std::vector<Real>>& elements,
+		std::string& function) {
+	unsigned long long seen;
+	auto base = snapshot(seen);
+
+	Calculator next = *base;
+	next.set_previous(prev);
+	auto result = next.evaluate(input);
+	elements = next.vector_result();
+	function = next.function_result();
+
+	// a declaration that succeeded starts with let and the name
+	auto name = tokenize(input)[1].name;
+
+	std::lock_guard<std::mutex> guard{ writing };
+	auto latest = std::atomic_load(&current);
+	if (latest != base) {
+		Calculator merged = *latest;
+		merged.copy_definition(next, name);
+		merged.set_previous(prev);
+		next = std::move(merged);
+	}
+
+	std::atomic_store(&current,
+		std::make_shared<const Calculator>(std::move(next)));
+	published.fetch_add(1, std::memory_order_release);
+
+	return result;
+}
+
+
+/**
+ * Load a saved session, and publish it as the new snapshot. If it
+ * can't be loaded, nothing is published.
+ */
+void Shared_calculator::load(const std::string& path) {
+	std::lock_guard<std::mutex> guard{ writing };
+
+	Calculator next = *std::atomic_load(&current);
+	next.load(path);
+
+	std::atomic_store(&current,
+		std::make_shared<const Calculator>(std::move(next)));
+	published.fetch_add(1, std::memory_order_release);
+}
+
+
+Shared_session::Shared_session(Shared_calculator& definitions)
+		:shared{ &definitions }, version{ 0 },
+		calc{ *definitions.snapshot(version) } {
+}
+
+
+/**
+ * Evaluate a statement. Declarations are published to every session;
+ * anything else is evaluated on this session's copy.
+ */
+Real Shared_session::evaluate(const std::string& input) {
+	refresh();
+
+	auto tokens = tokenize(input);
+	if (tokens.empty() || tokens.front().type != Token_type::let) {
+		return calc.evaluate(input);
+	}
+
+	std::shared_ptr<const std::vector<Real>> elements;
+	std::string function;
+	auto result = shared->define(input, calc.previous(), elements,
+		function);
+
+	refresh();
+	calc.set_previous(result);
+	calc.set_vector_result(std::move(elements));
+	calc.set_function_result(std::move(function));
+
+	return result;
+}
+
+
+Node Shared_session::compile(const std::string& input) {
+	refresh();
+	return calc.compile(input);
+}
+
+
+Real Shared_session::evaluate(const Node& exp) {
+	refresh();
+	return calc.evaluate(exp);
+}
+
+
+Dual Shared_session::differentiate(const std::string& input,
+		const std::vector<std::string>& wrt) {
+
+	refresh();
+	return calc.differentiate(input, wrt);
+}
+
+
+void Shared_session::load(const std::string& path) {
+	shared->load(path);
+	calc = *shared->snapshot(version);
+}
+
+
+Calculator& Shared_session::calculator() {
+	refresh();
+	return calc;
+}
+
+
+/**
+ * Catch up with the latest snapshot, if another has been published,
+ * keeping this session's `_`, last vector or function and statistics.
+ */
+void Shared_session::refresh() {
+	if (shared->version() == version) {
+		return;
+	}
+
+	auto prev = calc.previous();
+	auto shown = calc.vector_result();
+	auto defined = calc.function_result();
+	auto stats = calc.statistics();
+	calc = *shared->snapshot(version);
+	calc.set_previous(prev);
+	calc.set_vector_result(std::move(shown));
+	calc.set_function_result(std::move(defined));
+	calc.set_statistics(stats);
+}
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef CALC_CLI_SHARED_HPP
+#define CALC_CLI_SHARED_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * shared.hpp declares Shared_calculator, one set of definitions used
+ * by many threads at once, and Shared_session, through which a single
+ * thread uses it.
+ *
+ * Definitions are published as immutable snapshots: a declaration is
+ * run against a copy of the current snapshot, which then replaces it;
+ * only replacing it takes the lock.
+ * Every session evaluates on its own copy of the latest snapshot, and
+ * has its own `_`, so evaluating never waits for other threads. The
+ * snapshot is read through atomic operations on the shared_ptr, so
+ * fetching it after a new one has been published doesn't wait either.
+ */
+
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../calculator.hpp"
+
+
+class Shared_calculator {
+public:
+	explicit Shared_calculator(const Calculator& prototype)
+			:current{ std::make_shared<const Calculator>(prototype) } {
+	}
+
+	Shared_calculator(const Shared_calculator&) = delete;
+	Shared_calculator& operator=(const Shared_calculator&) = delete;
+
+	// how many snapshots have replaced the first one
+	unsigned long long version() const {
+		return published.load(std::memory_order_acquire);
+	}
+
+	std::shared_ptr<const Calculator> snapshot(
+		unsigned long long& version) const;
+
+	// run a declaration, setting elements to its value if that is a
+	// vector, and function to the function it defines, if any
+	Real define(const std::string& input, Real prev,
+		std::shared_ptr<const std::vector<Real>>& elements,
+		std::string& function);
+
+	// replace the definitions with those saved in a file
+	void load(const std::string& path);
+
+private:
+	std::mutex writing;		// held to replace current
+
+	// only read and written through std::atomic_load and atomic_store
+	std::shared_ptr<const Calculator> current;
+	std::atomic<unsigned long long> published{ 0 };
+};
+
+
+class Shared_session {
+public:
+	explicit Shared_session(Shared_calculator& definitions);
+
+	Real evaluate(const std::string& input);
+
+	// compile an expression once, to be evaluated any number of times;
+	// definitions can't change, so it stays valid in later snapshots
+	Node compile(const std::string& input);
+
+	Real evaluate(const Node& expression);
+
+	Dual differentiate(const std::string& input,
+		const std::vector<std::string>& wrt);
+
+	// load a saved session for every session, taking its `_` and
+	// statistics for this one
+	void load(const std::string& path);
+
+	// this session's copy of the latest snapshot, to use directly for
+	// anything but declarations, which it would keep to itself
+	Calculator& calculator();
+
+private:
+	Shared_calculator* shared;
+	unsigned long long version;
+
+	// a copy of the snapshot with the given version, along with this
+	// session's `_`
+	Calculator calc;
+
+	void refresh();
+};
+
+
+#endif // !CALC_CLI_SHARED_HPP
@@ -0,0 +1,151 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * stats.cpp defines the classes from stats.hpp.
+ */
+
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "stats.hpp"
+
+
+Quantile_estimator::Quantile_estimator(Real quantile)
+		:p{ quantile },
+		desired{ 1, 1 + 2 * quantile, 1 + 4 * quantile, 3 + 2 * quantile,
+			5 },
+		increments{ 0, quantile / 2, quantile, (1 + quantile) / 2, 1 } {
+}
+
+
+void Quantile_estimator::add(Real x) {
+	// the first five values are the markers
+	if (count < 5) {
+		heights[count++] = x;
+		if (count == 5) {
+			std::sort(heights.begin(), heights.end());
+		}
+
+		return;
+	}
+
+	// find k with heights[k] <= x < heights[k + 1], moving the outer
+	// markers if x lies beyond them
+	std::size_t k;
+	if (x < heights[0]) {
+		heights[0] = x;
+		k = 0;
+	} else if (x >= heights[4]) {
+		heights[4] = x;
+		k = 3;
+	} else {
+		k = std::upper_bound(heights.begin() + 1, heights.begin() + 4, x)
+			- heights.begin() - 1;
+	}
+
+	for (auto i = k + 1; i < 5; ++i) {
+		positions[i] += 1;
+	}
+
+	for (std::size_t i = 0; i < 5; ++i) {
+		desired[i] += increments[i];
+	}
+
+	// move each inner marker which is a whole position or more from
+	// where it should be, if it can move without passing a neighbour
+	for (std::size_t i = 1; i < 4; ++i) {
+		auto off = desired[i] - positions[i];
+		if ((off >= 1 && positions[i + 1] - positions[i] > 1) ||
+				(off <= -1 && positions[i - 1] - positions[i] < -1)) {
+			Real d = (off > 0) ? 1 : -1;
+
+			auto height = parabolic(i, d);
+			if (heights[i - 1] < height && height < heights[i + 1]) {
+				heights[i] = height;
+			} else {
+				heights[i] = linear(i, d);
+			}
+
+			positions[i] += d;
+		}
+	}
+
+	++count;
+}
+
+
+/**
+ * Return the estimate; with five values or fewer, the quantile itself,
+ * interpolating between the two nearest values. NaN if there are
+ * none.
+ */
+Real Quantile_estimator::estimate() const {
+	if (count > 5) {
+		return heights[2];
+	}
+
+	if (count == 0) {
+		return std::numeric_limits<Real>::quiet_NaN();
+	}
+
+	auto seen = heights;
+	std::sort(seen.begin(), seen.begin() + count);
+
+	Real h = (count - 1) * p;
+	auto lo = static_cast<std::size_t>(h);
+	if (lo + 1 == count) {
+		return seen[lo];
+	}
+
+	return seen[lo] + (h - lo) * (seen[lo + 1] - seen[lo]);
+}
+
+
+/**
+ * Return the new height of marker i, moved d positions, on the
+ * parabola through it and its neighbours.
+ */
+Real Quantile_estimator::parabolic(std::size_t i, Real d) const {
+	auto below = positions[i] - positions[i - 1];
+	auto above = positions[i + 1] - positions[i];
+
+	return heights[i] + d / (positions[i + 1] - positions[i - 1]) *
+		((below + d) * (heights[i + 1] - heights[i]) / above +
+		(above - d) * (heights[i] - heights[i - 1]) / below);
+}
+
+
+/**
+ * Return the new height of marker i, moved d positions, on the line
+ * to the neighbour it moves towards.
+ */
+Real Quantile_estimator::linear(std::size_t i, Real d) const {
+	auto j = (d > 0) ? i + 1 : i - 1;
+	return heights[i] + d * (heights[j] - heights[i]) /
+		(positions[j] - positions[i]);
+}
+
+
+void Running_stats::add(Real x) {
+	if (std::isnan(x)) {
+		return;
+	}
+
+	++n;
+	if (n == 1) {
+		least = greatest = x;
+	} else {
+		least = std::min(least, x);
+		greatest = std::max(greatest, x);
+	}
+
+	auto delta = x - average;
+	average += delta / n;
+	squares += delta * (x - average);
+
+	for (auto& q : quartiles) {
+		q.add(x);
+	}
+}
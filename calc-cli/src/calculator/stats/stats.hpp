@@ -0,0 +1,93 @@
+#pragma once
+#ifndef CALC_CLI_STATS_HPP
+#define CALC_CLI_STATS_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * stats.hpp declares Running_stats, which summarizes a stream of
+ * results one at a time, in a fixed amount of memory: the count,
+ * mean, variance, minimum and maximum exactly (Welford's method), and
+ * the quartiles approximately, with one P-square estimator each (Jain
+ * and Chlamtac, 1985).
+ */
+
+
+#include <array>
+#include <cstddef>
+
+#include "../real/real.hpp"
+
+
+/**
+ * An estimate of one quantile of the values seen so far, from five
+ * markers whose heights are adjusted as values arrive. It is exact
+ * until there are more than five values.
+ */
+class Quantile_estimator {
+public:
+	explicit Quantile_estimator(Real p);
+
+	void add(Real x);
+	Real estimate() const;
+
+private:
+	Real p;
+	std::size_t count = 0;
+
+	std::array<Real, 5> heights{};
+	std::array<Real, 5> positions{ 1, 2, 3, 4, 5 };
+	std::array<Real, 5> desired{};
+	std::array<Real, 5> increments{};
+
+	Real parabolic(std::size_t i, Real d) const;
+	Real linear(std::size_t i, Real d) const;
+};
+
+
+class Running_stats {
+public:
+	// results which aren't numbers are left out
+	void add(Real x);
+
+	std::size_t count() const {
+		return n;
+	}
+
+	Real mean() const {
+		return average;
+	}
+
+	// the sample variance; 0 for a single value
+	Real variance() const {
+		return (n > 1) ? squares / (n - 1) : 0;
+	}
+
+	Real min() const {
+		return least;
+	}
+
+	Real max() const {
+		return greatest;
+	}
+
+	// the quartiles, 1 to 3; 2 is the median
+	Real quartile(std::size_t i) const {
+		return quartiles[i - 1].estimate();
+	}
+
+private:
+	std::size_t n = 0;
+	Real average = 0;
+	Real squares = 0;		// sum of squared differences from the mean
+	Real least = 0;
+	Real greatest = 0;
+
+	std::array<Quantile_estimator, 3> quartiles{
+		Quantile_estimator{ 0.25 }, Quantile_estimator{ 0.5 },
+		Quantile_estimator{ 0.75 } };
+};
+
+
+#endif // !CALC_CLI_STATS_HPP
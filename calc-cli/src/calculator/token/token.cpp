@@ -7,10 +7,13 @@
 
 #include <vector>
 #include <string>
-#include <sstream>
 #include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
 
 #include "token.hpp"
+#include "../limits/limits.hpp"
 #include "../exceptions/exceptions.hpp"
 
 
@@ -18,14 +21,15 @@ using namespace std::literals::string_literals;
 
 using std::vector;
 using std::string;
-using std::istringstream;
-using std::isalpha;
 
 using ull = unsigned long long;
 
 
-double read_number(istringstream& source, char start);
-string read_name(istringstream& source);
+Real read_number(const string& source, std::size_t& i);
+string read_name(const string& source, std::size_t& i);
+std::size_t unmatched(const vector<Token>& tokens);
+void match(vector<Token>& tokens);
+Limit_exceeded over_limit(const char* what, std::size_t column);
 
 
 // how a variable definition starts
@@ -35,15 +39,36 @@ constexpr auto var_decl_start = "let";
 /**
  * Tokenize the given string into mathematical symbols and
  * floating-point literal.
+ *
+ * The string is scanned in place, rather than through a stream, which
+ * made tokenizing most of the cost of checking input. The limits on
+ * its length, on the number of tokens and on how deeply they nest are
+ * checked as it goes, so that nothing is parsed which is too large.
+ * Each closing bracket is matched to its opening one, so that the
+ * parser can skip what they enclose at once, rather than rescanning it
+ * at every level of nesting.
  */
 vector<Token> tokenize(const string& s) {
 	vector<Token> toks;
 
+	if (limits.input > 0 && s.size() > limits.input) {
+		throw over_limit("input is too long", limits.input + 1);
+	}
+
 	ull nesting = 0;	// are we inside a "(" .. ")", how deep?
 	ull fnesting = 0;	// are we inside a "[" .. "]", how deep?
+	ull depth = 0;		// inside how many of either, at most
+
+	for (std::size_t i = 0; i < s.size(); ) {
+		char token = s[i];
+		if (std::isspace(static_cast<unsigned char>(token))) {
+			++i;
+			continue;
+		}
+
+		auto column = i + 1;	// where it is, from 1
+		++i;
 
-	istringstream sin{ s };
-	for (char token; sin >> token; ) {
 		switch (token) {
 		case '+':
 			toks.push_back(Token{ Token_type::plus });
@@ -66,18 +91,22 @@ vector<Token> tokenize(const string& s) {
 		case '(':
 			toks.push_back(Token{ Token_type::p_open });
 			++nesting;
+			++depth;
 			break;
 		case ')':
 			toks.push_back(Token{ Token_type::p_close });
 			--nesting;
+			depth -= (depth > 0);
 			break;
 		case '[':
 			toks.push_back(Token{ Token_type::arg_delim_open });
 			++fnesting;
+			++depth;
 			break;
 		case ']':
 			toks.push_back(Token{ Token_type::arg_delim_close });
 			--fnesting;
+			depth -= (depth > 0);
 			break;
 		case ',':
 			toks.push_back(Token{ Token_type::arg_separator });
@@ -85,57 +114,149 @@ vector<Token> tokenize(const string& s) {
 		case '_':
 			toks.push_back(Token{ Token_type::previous });
 			break;
+		case '.':
+			if (i < s.size() && s[i] == '.') {
+				++i;
+				toks.push_back(Token{ Token_type::range });
+				break;
+			}
+			// a floating-point literal may start with a "."
+			[[fallthrough]];
 		case '0': case '1': case '2': case '3': case '4':
-		case '5': case '6': case '7': case '8': case '9':
-		case '.': {	// floating-point literal may start with a "."
-			sin.putback(token);
-			double n = read_number(sin, token);
+		case '5': case '6': case '7': case '8': case '9': {
+			i = column - 1;
+			Real n = read_number(s, i);
 
 			toks.push_back(Token{ Token_type::number, n });
 			break;
 		}
 		case '!':
-			toks.push_back(Token{ Token_type::factorial });
-			break;
 		case '=':
-			toks.push_back(Token{ Token_type::assignment });
+		case '<':
+		case '>': {
+			// "!=", "==", "<=" and ">=" are single tokens
+			bool with_equals = (i < s.size() && s[i] == '=');
+			i += with_equals;
+
+			Token_type type;
+			switch (token) {
+			case '!':
+				type = with_equals ? Token_type::not_equal
+					: Token_type::factorial;
+				break;
+			case '=':
+				type = with_equals ? Token_type::equal
+					: Token_type::assignment;
+				break;
+			case '<':
+				type = with_equals ? Token_type::less_equal
+					: Token_type::less;
+				break;
+			default:
+				type = with_equals ? Token_type::greater_equal
+					: Token_type::greater;
+				break;
+			}
+
+			toks.push_back(Token{ type });
 			break;
+		}
 		default:
-			if (isalpha(token)) {
+			if (std::isalpha(static_cast<unsigned char>(token))) {
 				// variable or "let"-variable definition
-				
-				sin.putback(token);
-				string name = read_name(sin);
-				if (name == "let") {
+
+				i = column - 1;
+				string name = read_name(s, i);
+				if (name == var_decl_start) {
 					toks.push_back(Token{ Token_type::let });
 				} else {
 					toks.push_back(
 						Token{ Token_type::variable, 0, name});
 				}
 			} else {
-				throw Unknown_token{ "unknown token" };
+				Unknown_token e{ "unknown token" };
+				e.locate(column);
+				throw e;
 			}
 		}
+
+		toks.back().column = column;
+
+		if (limits.tokens > 0 && toks.size() > limits.tokens) {
+			throw over_limit("too many tokens", column);
+		}
+
+		if (depth > max_depth ||
+				(limits.depth > 0 && depth > limits.depth)) {
+			throw over_limit("nested too deeply", column);
+		}
 	}
 
 	if (nesting || fnesting) {
-		throw Unbalanced_parentheses{ "unbalanced () or []" };
+		Unbalanced_parentheses e{ "unbalanced () or []" };
+		e.locate(unmatched(toks));
+		throw e;
 	}
 
+	match(toks);
 	return toks;
 }
 
 
+Real to_real(const char* s, char** end) {
+#if defined(CALC_CLI_FLOAT)
+	return std::strtof(s, end);
+#elif defined(CALC_CLI_LONG_DOUBLE)
+	return std::strtold(s, end);
+#else
+	return std::strtod(s, end);
+#endif
+}
+
+
 /**
- * Read and return a floating-point number from the given input
- * source.
+ * Read and return a floating-point number starting at i, moving i past
+ * it. A number is read exactly as a stream would read it: digits, a
+ * point and more digits, and an exponent; anything a stream would
+ * reject, including a number too large for a Real, is an error.
  */
-double read_number(istringstream& in, char) {
-	double n;
-	in >> n;
+Real read_number(const string& s, std::size_t& i) {
+	auto start = i;
+	auto digits = [&]() {
+		auto from = i;
+		while (i < s.size() && std::isdigit(static_cast<unsigned char>(s[i]))) {
+			++i;
+		}
+		return i > from;
+	};
+
+	bool mantissa = digits();
+	if (i < s.size() && s[i] == '.') {
+		++i;
+		mantissa = digits() || mantissa;
+	}
+
+	if (mantissa && i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+		++i;
+		if (i < s.size() && (s[i] == '+' || s[i] == '-')) {
+			++i;
+		}
+		digits();
+	}
 
-	if (!in) {
-		throw Bad_literal{ "not a valid number" };
+	string literal = s.substr(start, i - start);
+
+	char* end;
+	Real n = to_real(literal.c_str(), &end);
+	if (end != literal.c_str() + literal.size() || std::isinf(n)) {
+		Bad_literal e{ "not a valid number" };
+		e.locate(start + 1);
+		throw e;
+	}
+
+	// in "1..5", the literal "1." swallows the first dot of the range
+	if (i < s.size() && s[i] == '.' && s[i - 1] == '.') {
+		--i;
 	}
 
 	return n;
@@ -143,20 +264,109 @@ double read_number(istringstream& in, char) {
 
 
 /**
- * Read and return a variable name.
+ * Read and return a variable name starting at i, moving i past it.
  * 
  * A variable name consists of alphabetical characters and no spaces.
  * Unlike a variable name in C++, it can't contain underscore or
  * digits.
  */
-string read_name(istringstream& in) {
-	string name;
+string read_name(const string& s, std::size_t& i) {
+	auto start = i;
+	while (i < s.size() && std::isalpha(static_cast<unsigned char>(s[i]))) {
+		++i;
+	}
 
-	char c;
-	while (in.get(c) && isalpha(c)) {
-		name += c;
+	return s.substr(start, i - start);
+}
+
+
+/**
+ * Return the column of a bracket which isn't matched: the first
+ * closing one with nothing to close, or else the last opening one
+ * left open.
+ */
+std::size_t unmatched(const vector<Token>& toks) {
+	vector<std::size_t> parens;
+	vector<std::size_t> brackets;
+
+	for (const auto& t : toks) {
+		switch (t.type) {
+		case Token_type::p_open:
+			parens.push_back(t.column);
+			break;
+		case Token_type::arg_delim_open:
+			brackets.push_back(t.column);
+			break;
+		case Token_type::p_close:
+			if (parens.empty()) {
+				return t.column;
+			}
+			parens.pop_back();
+			break;
+		case Token_type::arg_delim_close:
+			if (brackets.empty()) {
+				return t.column;
+			}
+			brackets.pop_back();
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (parens.empty()) {
+		return brackets.back();
+	}
+
+	if (brackets.empty()) {
+		return parens.back();
 	}
-	in.putback(c);
 
-	return name;
+	return std::max(parens.back(), brackets.back());
+}
+
+
+/**
+ * Note in each closing bracket how far back the bracket it closes is.
+ * Brackets which don't nest properly, as in "([)]", are left alone,
+ * and are scanned token by token instead.
+ */
+void match(vector<Token>& toks) {
+	vector<std::size_t> open;
+
+	for (std::size_t i = 0; i < toks.size(); ++i) {
+		switch (toks[i].type) {
+		case Token_type::p_open:
+		case Token_type::arg_delim_open:
+			open.push_back(i);
+			break;
+		case Token_type::p_close:
+		case Token_type::arg_delim_close: {
+			auto opener = (toks[i].type == Token_type::p_close)
+				? Token_type::p_open : Token_type::arg_delim_open;
+			if (open.empty() || toks[open.back()].type != opener) {
+				for (auto& t : toks) {
+					t.opened = 0;
+				}
+				return;
+			}
+
+			toks[i].opened = i - open.back();
+			open.pop_back();
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+
+/**
+ * Return the error for going over a limit at the given column.
+ */
+Limit_exceeded over_limit(const char* what, std::size_t column) {
+	Limit_exceeded e{ what };
+	e.locate(column);
+	return e;
 }
@@ -13,10 +13,14 @@
 
 #include <vector>
 #include <string>
+#include <cstddef>
+
+#include "../real/real.hpp"
 
 
 enum class Token_type {
 	plus, minus, multiply, divide, mod, power,
+	less, less_equal, greater, greater_equal, equal, not_equal,
 	number,
 	p_open, p_close,	// parentheses
 	factorial,
@@ -27,15 +31,20 @@ enum class Token_type {
 	assignment,
 	arg_delim_open, arg_delim_close,	// used to delimit arguments
 										// to a function
-	arg_separator
+	arg_separator,
+	range				// separates the bounds of a range: lo..hi
 };
 
 
 struct Token {
 	Token_type type;
-	double value;		// used only when type is Token_type::number
-	std::string name;	// used only when type is
+	Real value = 0;		// used only when type is Token_type::number
+	std::string name{};	// used only when type is
 						// Token_type::variable
+	std::size_t column = 0;	// where it starts in the input, from 1
+	std::size_t opened = 0;	// for a closing bracket, how many tokens
+							// back the one it closes is; 0 if the
+							// brackets don't nest properly
 };
 
 
@@ -0,0 +1,77 @@
+#ifndef CALC_CLI_PLUGIN_H
+#define CALC_CLI_PLUGIN_H
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * calc_cli_plugin.h is all a plugin needs: a shared library which
+ * adds functions to calc-cli. It is plain C, so that a plugin can be
+ * written in any language which can export a C function.
+ *
+ * A plugin defines
+ *
+ *     CALC_CLI_PLUGIN_EXPORT const Calc_plugin* calc_cli_plugin(void)
+ *
+ * returning a Calc_plugin which lives as long as the process. Every
+ * function has a scalar entry point, called with arity arguments, and
+ * a function of one argument may also have a batch entry point, which
+ * calc-cli calls instead for whole blocks of arguments at a time,
+ * e.g. inside sum and product or over the rows of a table. A pure
+ * function of one argument without one is still evaluated a block at
+ * a time, by calling its scalar entry point for each argument.
+ *
+ * plugin/example/square.c is a plugin with one of each kind of
+ * function.
+ *
+ * Entry points may be called from several threads at once. They can't
+ * report errors; they should return NaN instead.
+ */
+
+
+#include <stddef.h>
+
+
+#define CALC_CLI_PLUGIN_VERSION 1
+
+#ifdef __cplusplus
+#define CALC_CLI_PLUGIN_C extern "C"
+#else
+#define CALC_CLI_PLUGIN_C
+#endif
+
+#ifdef _WIN32
+#define CALC_CLI_PLUGIN_EXPORT CALC_CLI_PLUGIN_C __declspec(dllexport)
+#else
+#define CALC_CLI_PLUGIN_EXPORT CALC_CLI_PLUGIN_C \
+	__attribute__((visibility("default")))
+#endif
+
+
+/* f(args[0], ..., args[arity - 1]) */
+typedef double (*Calc_plugin_scalar)(const double* args);
+
+/* out[i] = f(in[i]) for i < n; in and out don't overlap */
+typedef void (*Calc_plugin_batch)(const double* in, double* out,
+	size_t n);
+
+typedef struct {
+	const char* name;			/* letters only, like every function */
+	unsigned arity;
+	int pure;					/* nonzero if the result depends only on
+								   the arguments */
+	Calc_plugin_scalar scalar;
+	Calc_plugin_batch batch;	/* may be NULL; ignored unless arity
+								   is 1 */
+} Calc_plugin_function;
+
+typedef struct {
+	unsigned version;			/* CALC_CLI_PLUGIN_VERSION */
+	size_t count;
+	const Calc_plugin_function* functions;
+} Calc_plugin;
+
+typedef const Calc_plugin* (*Calc_plugin_entry)(void);
+
+
+#endif /* !CALC_CLI_PLUGIN_H */
@@ -0,0 +1,79 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * square.c is an example plugin, with a function of each kind:
+ *
+ *     square[x]    x^2, with a batch entry point
+ *     cube[x]      x^3, with only a scalar one
+ *     hypot[x, y]  sqrt(x^2 + y^2), of two arguments
+ *     calls[x]     x plus how many times calls has been called,
+ *                  including this one; impure, so never folded or
+ *                  cached
+ *
+ * Build it as a shared library, e.g. on Linux
+ *
+ *     cc -O2 -shared -fPIC -o square.so square.c -lm
+ *
+ * and load it with calc-cli --plugin ./square.so. tools/check_plugin.py
+ * builds it and checks how calc-cli calls each function.
+ */
+
+
+#include <math.h>
+
+#include "../calc_cli_plugin.h"
+
+
+static double square(const double* args) {
+	return args[0] * args[0];
+}
+
+static void square_batch(const double* in, double* out, size_t n) {
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		out[i] = in[i] * in[i];
+	}
+}
+
+
+static double cube(const double* args) {
+	return args[0] * args[0] * args[0];
+}
+
+
+static double hypotenuse(const double* args) {
+	return sqrt(args[0] * args[0] + args[1] * args[1]);
+}
+
+
+/* entry points may be called from several threads at once */
+static long long call_count = 0;
+
+static double calls(const double* args) {
+#ifdef _MSC_VER
+	long long n = _InterlockedIncrement64(&call_count);
+#else
+	long long n = __atomic_add_fetch(&call_count, 1, __ATOMIC_RELAXED);
+#endif
+
+	return args[0] + (double)n;
+}
+
+
+static const Calc_plugin_function functions[] = {
+	{ "square", 1, 1, square, square_batch },
+	{ "cube", 1, 1, cube, NULL },
+	{ "hypot", 2, 1, hypotenuse, NULL },
+	{ "calls", 1, 0, calls, NULL },
+};
+
+static const Calc_plugin plugin = {
+	CALC_CLI_PLUGIN_VERSION,
+	sizeof functions / sizeof functions[0],
+	functions
+};
+
+
+CALC_CLI_PLUGIN_EXPORT const Calc_plugin* calc_cli_plugin(void) {
+	return &plugin;
+}
@@ -0,0 +1,223 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * plugin.cpp defines load_plugin from plugin.hpp. A plugin's entry
+ * points are called directly on the calculator's numbers when those
+ * are doubles, and through a copy otherwise. A pure function of one
+ * argument without a batch entry point is given a batch version which
+ * calls its scalar entry point for each value in turn, so that blocks
+ * of values reach it without going through a Calc_func for each.
+ * Plugins are never unloaded, since their functions may be used until
+ * the end.
+ */
+
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <iostream>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "plugin.hpp"
+#include "calc_cli_plugin.h"
+#include "../utils/utils.hpp"
+#include "../utils/calc_consts.hpp"
+#include "../calculator/exceptions/exceptions.hpp"
+
+
+using std::string;
+using std::vector;
+
+
+// the name of the function every plugin exports
+constexpr auto entry_name = "calc_cli_plugin";
+
+
+Calc_plugin_entry find_entry(const string& path);
+bool is_name(const char* name);
+Calc_func scalar_func(Calc_plugin_scalar scalar, unsigned arity);
+Calc_batch batch_func(Calc_plugin_batch batch);
+Calc_batch scalar_batch(Calc_plugin_scalar scalar);
+
+
+/**
+ * Load the plugin at the given path, and add its functions. Return
+ * false, having explained why, if it can't be loaded or one of its
+ * functions clashes with a function already known.
+ */
+bool load_plugin(const string& path, Plugin_funcs& into) {
+	auto entry = find_entry(path);
+	if (!entry) {
+		return false;
+	}
+
+	auto plugin = entry();
+	if (!plugin || plugin->version != CALC_CLI_PLUGIN_VERSION) {
+		std::cerr << error << path << " was built for another version "
+			"of calc-cli\n";
+		return false;
+	}
+
+	auto predefined = get_funcs();
+	for (std::size_t i = 0; i < plugin->count; ++i) {
+		const auto& f = plugin->functions[i];
+		if (!is_name(f.name) || !f.scalar) {
+			std::cerr << error << path << " has a function without a "
+				"valid name or entry point\n";
+			return false;
+		}
+
+		string name{ f.name };
+		if (predefined.count(name) || into.funcs.count(name)) {
+			std::cerr << error << path << " redefines " << name << '\n';
+			return false;
+		}
+
+		into.funcs[name] = scalar_func(f.scalar, f.arity);
+		into.arities[name] = Arity{ f.arity, f.arity };
+		if (f.batch && f.arity == 1) {
+			into.batches[name] = batch_func(f.batch);
+		} else if (f.pure && f.arity == 1) {
+			into.batches[name] = scalar_batch(f.scalar);
+		}
+		if (!f.pure) {
+			into.impure.insert(name);
+		}
+	}
+
+	return true;
+}
+
+
+/**
+ * Open a shared library, and return its calc_cli_plugin function, or
+ * nullptr, having explained why, if it has none.
+ */
+Calc_plugin_entry find_entry(const string& path) {
+#ifdef _WIN32
+	auto library = LoadLibraryA(path.c_str());
+	if (!library) {
+		std::cerr << error << "can't load " << path << '\n';
+		return nullptr;
+	}
+
+	auto entry = reinterpret_cast<Calc_plugin_entry>(
+		GetProcAddress(library, entry_name));
+#else
+	auto library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (!library) {
+		std::cerr << error << "can't load " << path << ": " << dlerror()
+			<< '\n';
+		return nullptr;
+	}
+
+	auto entry = reinterpret_cast<Calc_plugin_entry>(
+		dlsym(library, entry_name));
+#endif
+
+	if (!entry) {
+		std::cerr << error << path << " isn't a calc-cli plugin\n";
+	}
+
+	return entry;
+}
+
+
+/**
+ * Can a function be called by this name, a group of letters?
+ */
+bool is_name(const char* name) {
+	if (!name || !*name) {
+		return false;
+	}
+
+	string s{ name };
+	return std::all_of(s.begin(), s.end(), [](char c) {
+		return std::isalpha(static_cast<unsigned char>(c)) != 0; });
+}
+
+
+Real call_scalar(Calc_plugin_scalar scalar, const vector<double>& args) {
+	return scalar(args.data());
+}
+
+template <typename T>
+T call_scalar(Calc_plugin_scalar scalar, const vector<T>& args) {
+	vector<double> converted(args.begin(), args.end());
+	return static_cast<T>(scalar(converted.data()));
+}
+
+
+void call_batch(Calc_plugin_batch batch, const double* in, double* out,
+		std::size_t n) {
+	batch(in, out, n);
+}
+
+template <typename T>
+void call_batch(Calc_plugin_batch batch, const T* in, T* out,
+		std::size_t n) {
+	vector<double> converted(in, in + n);
+	vector<double> results(n);
+	batch(converted.data(), results.data(), n);
+
+	std::copy(results.begin(), results.end(), out);
+}
+
+
+void call_each(Calc_plugin_scalar scalar, const double* in, double* out,
+		std::size_t n) {
+	for (std::size_t i = 0; i < n; ++i) {
+		out[i] = scalar(in + i);
+	}
+}
+
+template <typename T>
+void call_each(Calc_plugin_scalar scalar, const T* in, T* out,
+		std::size_t n) {
+	for (std::size_t i = 0; i < n; ++i) {
+		double x = static_cast<double>(in[i]);
+		out[i] = static_cast<T>(scalar(&x));
+	}
+}
+
+
+/**
+ * Return a Calc_func calling a plugin's scalar entry point.
+ */
+Calc_func scalar_func(Calc_plugin_scalar scalar, unsigned arity) {
+	return [scalar, arity](const vector<Real>& args) {
+		if (args.size() != arity) {
+			throw Unsupported_operand{ "invalid number of arguments" };
+		}
+
+		return call_scalar(scalar, args);
+	};
+}
+
+
+/**
+ * Return a Calc_batch calling a plugin's batch entry point.
+ */
+Calc_batch batch_func(Calc_plugin_batch batch) {
+	return [batch](const Real* in, Real* out, std::size_t n) {
+		call_batch(batch, in, out, n);
+	};
+}
+
+
+/**
+ * Return a Calc_batch calling a plugin's scalar entry point, of one
+ * argument, once for each value.
+ */
+Calc_batch scalar_batch(Calc_plugin_scalar scalar) {
+	return [scalar](const Real* in, Real* out, std::size_t n) {
+		call_each(scalar, in, out, n);
+	};
+}
@@ -0,0 +1,34 @@
+#pragma once
+#ifndef CALC_CLI_PLUGIN_HPP
+#define CALC_CLI_PLUGIN_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * plugin.hpp declares load_plugin, which adds the functions of a
+ * plugin, a shared library written against calc_cli_plugin.h, to
+ * those the calculator knows.
+ */
+
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "../calculator/node/node.hpp"
+
+
+// the functions added by every plugin loaded so far
+struct Plugin_funcs {
+	std::map<std::string, Calc_func> funcs;
+	std::map<std::string, Calc_batch> batches;
+	std::set<std::string> impure;
+	std::map<std::string, Arity> arities;
+};
+
+
+bool load_plugin(const std::string& path, Plugin_funcs& into);
+
+
+#endif // !CALC_CLI_PLUGIN_HPP
@@ -0,0 +1,473 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * server.cpp defines the server and client from server.hpp.
+ *
+ * The server runs a single-threaded event loop over poll(). Every
+ * connection is a session with its own Calculator, copied from an
+ * already set up prototype, and its own cache of compiled
+ * expressions, so repeating an expression skips tokenizing and
+ * compiling it.
+ *
+ * Every line is answered with exactly one line: the commands answer
+ * what the REPL prints, its lines joined by "; ", and a blank line
+ * answers an empty one. quit closes the connection once the lines
+ * before it are answered. save and load are refused, since they would
+ * let any client write and read the server's files.
+ *
+ * While one line is being evaluated, no other client is answered, so
+ * unless --limit time is given, each line may take at most
+ * server_seconds.
+ */
+
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <cctype>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#include "server.hpp"
+#include "../calculator/limits/limits.hpp"
+#include "../calculator/exceptions/exceptions.hpp"
+#include "../utils/utils.hpp"
+#include "../utils/calc_consts.hpp"
+
+
+using std::string;
+using std::vector;
+
+
+// a session's cache is emptied once it holds this many expressions
+constexpr std::size_t cache_limit = 1024;
+
+// how much is read from a socket at a time
+constexpr std::size_t chunk_size = 4096;
+
+// without --limit input, the longest line a client may send; the rest
+// of a longer one isn't kept
+constexpr std::size_t line_limit = 1 << 20;
+
+// nothing more is read from a client while this much of its answers is
+// waiting to be sent, so one which doesn't read them can't take up
+// any amount of memory
+constexpr std::size_t out_limit = 1 << 20;
+
+// without --limit time, the most seconds a line may take
+constexpr double server_seconds = 10;
+
+
+struct Session {
+	Calculator calc;
+	std::map<string, Node> cache{};	// compiled expressions by input
+
+	string in{};	// received, but not yet complete lines
+	string out{};	// answers not yet sent
+
+	bool skipping = false;	// the rest of a line too long is dropped
+	bool closing = false;	// the client has sent everything, or quit;
+							// close once every answer is sent
+
+	// whether to read more from the client
+	bool reading() const {
+		return !closing && out.size() < out_limit;
+	}
+};
+
+
+bool is_declaration(const string& input);
+string reply(Session& session, const string& input);
+
+
+#ifndef _WIN32
+
+int listen_on(const string& path);
+bool set_nonblocking(int fd);
+bool receive(int fd, Session& session);
+void answer_lines(Session& session);
+void queue_reply(Session& session, string line);
+bool send_out(int fd, Session& session);
+bool write_all(int fd, const string& data);
+
+
+/**
+ * Serve clients on the given socket until the process is stopped.
+ */
+int serve(const string& path, const Calculator& prototype) {
+	signal(SIGPIPE, SIG_IGN);
+
+	if (limits.seconds == 0) {
+		limits.seconds = server_seconds;
+	}
+
+	int listener = listen_on(path);
+	if (listener < 0) {
+		std::cerr << error << "can't listen on " << path << ": "
+			<< std::strerror(errno) << '\n';
+		return 1;
+	}
+
+	// fds[0] is the listener; the rest are clients, with their
+	// sessions at the same positions in sessions
+	vector<pollfd> fds{ { listener, POLLIN, 0 } };
+	vector<Session> sessions(1, Session{ prototype });
+
+	while (true) {
+		if (poll(fds.data(), fds.size(), -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			std::cerr << error << std::strerror(errno) << '\n';
+			return 1;
+		}
+
+		for (std::size_t i = fds.size(); i > 1; --i) {
+			auto& p = fds[i - 1];
+			auto& s = sessions[i - 1];
+
+			bool open = !(p.revents & (POLLERR | POLLNVAL));
+			if (open && s.reading() && (p.revents & (POLLIN | POLLHUP))) {
+				open = receive(p.fd, s);
+			}
+			if (open && !s.out.empty()) {
+				open = send_out(p.fd, s);
+			}
+			if (s.closing && s.out.empty()) {
+				open = false;
+			}
+
+			if (!open) {
+				close(p.fd);
+				fds.erase(fds.begin() + (i - 1));
+				sessions.erase(sessions.begin() + (i - 1));
+				continue;
+			}
+
+			// at the end of its input, a socket is always readable, so
+			// it is only polled for that while more is to be read
+			p.events = !s.reading() ? POLLOUT
+				: s.out.empty() ? POLLIN : (POLLIN | POLLOUT);
+		}
+
+		if (fds[0].revents & POLLIN) {
+			for (int c; (c = accept(listener, nullptr, nullptr)) >= 0; ) {
+				if (!set_nonblocking(c)) {
+					close(c);
+					continue;
+				}
+
+				fds.push_back({ c, POLLIN, 0 });
+				sessions.push_back(Session{ prototype });
+			}
+		}
+	}
+}
+
+
+/**
+ * Send every line of the standard input to the server on the given
+ * socket, and print its answers.
+ */
+int connect_to(const string& path) {
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		std::cerr << error << "socket path is too long\n";
+		return 1;
+	}
+	path.copy(address.sun_path, path.size());
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address),
+			sizeof(address)) < 0) {
+		std::cerr << error << "can't connect to " << path << ": "
+			<< std::strerror(errno) << '\n';
+		return 1;
+	}
+
+	string received;
+	char buffer[chunk_size];
+	for (string line; std::getline(std::cin, line); ) {
+		if (!write_all(fd, line + '\n') || line == quit) {
+			break;
+		}
+
+		auto end = received.find('\n');
+		while (end == string::npos) {
+			auto n = read(fd, buffer, sizeof(buffer));
+			if (n <= 0) {
+				std::cerr << error << "connection closed\n";
+				close(fd);
+				return 1;
+			}
+
+			received.append(buffer, n);
+			end = received.find('\n');
+		}
+
+		std::cout << received.substr(0, end + 1) << std::flush;
+		received.erase(0, end + 1);
+	}
+
+	close(fd);
+	return 0;
+}
+
+
+/**
+ * Return a non-blocking socket listening on the given path; a stale
+ * socket file left there is replaced.
+ */
+int listen_on(const string& path) {
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	path.copy(address.sun_path, path.size());
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	unlink(path.c_str());
+	if (bind(fd, reinterpret_cast<sockaddr*>(&address),
+			sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0 ||
+			!set_nonblocking(fd)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+
+bool set_nonblocking(int fd) {
+	int flags = fcntl(fd, F_GETFL, 0);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) >= 0;
+}
+
+
+/**
+ * Read what a client has sent, and answer every complete line, until
+ * it has sent nothing more, or too many answers are waiting to be sent.
+ * At the end of its input, a last line without a newline is answered
+ * too, as the REPL would, and the session is closing. Return false if
+ * the connection is broken.
+ */
+bool receive(int fd, Session& s) {
+	char buffer[chunk_size];
+
+	while (s.reading()) {
+		auto n = read(fd, buffer, sizeof(buffer));
+		if (n == 0) {
+			if (!s.in.empty() && !s.skipping) {
+				queue_reply(s, std::move(s.in));
+			}
+
+			s.in.clear();
+			s.closing = true;
+			return true;
+		} else if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+
+		s.in.append(buffer, n);
+		answer_lines(s);
+	}
+
+	return true;
+}
+
+
+/**
+ * Answer every complete line received. A line longer than the limit
+ * on input is answered with an error as soon as it is too long, and
+ * the rest of it is dropped as it arrives.
+ */
+void answer_lines(Session& s) {
+	std::size_t start = 0;
+	for (auto end = s.in.find('\n'); end != string::npos && !s.closing;
+			end = s.in.find('\n', start)) {
+
+		if (!s.skipping) {
+			queue_reply(s, s.in.substr(start, end - start));
+		}
+
+		s.skipping = false;
+		start = end + 1;
+	}
+	s.in.erase(0, start);
+
+	// nothing after quit is answered
+	if (s.closing) {
+		s.in.clear();
+		return;
+	}
+
+	auto most = (limits.input > 0) ? limits.input : line_limit;
+	if (s.in.size() > most) {
+		if (!s.skipping) {
+			s.out += error;
+			s.out += "input is too long\n";
+		}
+
+		s.skipping = true;
+		s.in.clear();
+	}
+}
+
+
+/**
+ * Queue the answer to a line, or if it is quit, close the session
+ * once the answers before it are sent.
+ */
+void queue_reply(Session& s, string line) {
+	if (!line.empty() && line.back() == '\r') {
+		line.pop_back();
+	}
+
+	if (line == quit) {
+		s.closing = true;
+		return;
+	}
+
+	s.out += reply(s, line);
+	s.out += '\n';
+}
+
+
+/**
+ * Send as much of the pending answers as the socket takes. Return
+ * false if the connection is broken.
+ */
+bool send_out(int fd, Session& s) {
+	while (!s.out.empty()) {
+		auto n = write(fd, s.out.data(), s.out.size());
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+
+		s.out.erase(0, n);
+	}
+
+	return true;
+}
+
+
+bool write_all(int fd, const string& data) {
+	for (std::size_t sent = 0; sent < data.size(); ) {
+		auto n = write(fd, data.data() + sent, data.size() - sent);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+
+		sent += n;
+	}
+
+	return true;
+}
+
+#else
+
+int serve(const string&, const Calculator&) {
+	std::cerr << error << "server mode isn't supported on Windows\n";
+	return 1;
+}
+
+int connect_to(const string&) {
+	std::cerr << error << "client mode isn't supported on Windows\n";
+	return 1;
+}
+
+#endif // !_WIN32
+
+
+/**
+ * Does the input define something rather than being an expression?
+ */
+bool is_declaration(const string& input) {
+	auto start = input.find_first_not_of(" \t");
+	return start != string::npos && input.compare(start, 3, "let") == 0
+		&& !std::isalpha(static_cast<unsigned char>(
+			start + 3 < input.size() ? input[start + 3] : ' '));
+}
+
+
+/**
+ * Return the line the REPL would print for the given input, with the
+ * lines a command prints joined into one. An expression is compiled
+ * only the first time a session sees it.
+ */
+string reply(Session& s, const string& input) {
+	std::ostringstream line;
+
+	if (is_command(input, s.calc)) {
+		if (input.rfind(save, 0) == 0 || input.rfind(load, 0) == 0) {
+			return string{ error } + "save and load aren't available on "
+				"a server";
+		}
+
+		respond(input, s.calc, line, line);
+
+		auto text = line.str();
+		while (!text.empty() && text.back() == '\n') {
+			text.pop_back();
+		}
+		for (auto i = text.find('\n'); i != string::npos;
+				i = text.find('\n', i)) {
+			text.replace(i, 1, "; ");
+		}
+
+		return text;
+	}
+
+	try {
+		Real result;
+		if (is_declaration(input)) {
+			result = s.calc.evaluate(input);
+		} else {
+			auto c = s.cache.find(input);
+			if (c == s.cache.end()) {
+				if (s.cache.size() >= cache_limit) {
+					s.cache.clear();
+				}
+
+				c = s.cache.emplace(input, s.calc.compile(input)).first;
+			}
+
+			result = s.calc.evaluate(c->second);
+		}
+
+		line << answer;
+		display_value(result, s.calc, line);
+	} catch (Calc_cli_exception& e) {
+		line << error << e.what();
+	}
+
+	return line.str();
+}
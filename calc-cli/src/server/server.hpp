@@ -0,0 +1,28 @@
+#pragma once
+#ifndef CALC_CLI_SERVER_HPP
+#define CALC_CLI_SERVER_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * server.hpp declares a server which keeps calculators running for
+ * clients connected over a UNIX domain socket, and the client used to
+ * talk to it.
+ *
+ * The protocol is line based: the client sends one input per line,
+ * and the server answers every line with one line, either the
+ * result or an error message, exactly as the REPL would print them.
+ */
+
+
+#include <string>
+
+#include "../calculator/calculator.hpp"
+
+
+int serve(const std::string& socket_path, const Calculator& prototype);
+int connect_to(const std::string& socket_path);
+
+
+#endif // !CALC_CLI_SERVER_HPP
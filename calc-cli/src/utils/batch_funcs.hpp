@@ -0,0 +1,40 @@
+#pragma once
+#ifndef CALC_CLI_BATCH_FUNCS_HPP
+#define CALC_CLI_BATCH_FUNCS_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * batch_funcs.hpp declares batch versions of the predefined functions
+ * of one argument, which reductions use to apply a function to many
+ * values at once.
+ *
+ * With Precision::exact, a batch function gives exactly what the
+ * function from calc_funcs.hpp gives. With Precision::fast, the
+ * trigonometric, hyperbolic, logarithmic and root functions are
+ * approximated by polynomials evaluated several values at a time
+ * with SSE2 or AVX2; see batch_funcs.cpp for their error bounds.
+ * They compute in double whatever Real is, so they are no more
+ * accurate than that with long double.
+ */
+
+
+#include <map>
+#include <string>
+
+#include "../calculator/node/node.hpp"
+
+
+enum class Precision {
+	exact,
+	fast
+};
+
+
+std::map<std::string, Calc_batch> get_batch_funcs(Precision precision);
+
+Calc_func scalar(const Calc_batch& batch);
+
+
+#endif // !CALC_CLI_BATCH_FUNCS_HPP
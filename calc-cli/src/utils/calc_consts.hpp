@@ -6,6 +6,8 @@
 #include <map>
 #include <string>
 
+#include "../calculator/real/real.hpp"
+
 
 constexpr auto prompt = "> ";
 constexpr auto answer = "= ";
@@ -13,17 +15,40 @@ constexpr auto error = "Error: ";
 constexpr auto quit = "quit";
 constexpr auto clear = "clear";
 constexpr auto help = "help";
+constexpr auto memo = "memo";
+constexpr auto stats = "stats";
+constexpr auto profile = "profile";
+constexpr auto gradient = "gradient[";
+constexpr auto save = "save";
+constexpr auto load = "load";
+
+// command-line options
+constexpr auto server_option = "--server";
+constexpr auto client_option = "--client";
+constexpr auto script_option = "--script";
+constexpr auto validate_option = "--validate";
+constexpr auto csv_option = "--csv";
+constexpr auto binary_option = "--binary";
+constexpr auto fast_math_option = "--fast-math";
+constexpr auto memo_option = "--memo";
+constexpr auto raw_output_option = "--raw-output";
+constexpr auto stats_option = "--stats";
+constexpr auto plugin_option = "--plugin";
+constexpr auto load_option = "--load";
+constexpr auto profile_option = "--profile";
+constexpr auto limit_option = "--limit";
+constexpr auto threads_option = "--threads";
 
 
 /**
  * Return a map<name, value> of useful mathematical constants.
  */
-std::map<std::string, double> get_consts() {
-	constexpr double pi = 3.14159;
-	constexpr double e = 2.71828;
-	constexpr double phi = 1.61803;
+inline std::map<std::string, Real> get_consts() {
+	constexpr Real pi = 3.14159;
+	constexpr Real e = 2.71828;
+	constexpr Real phi = 1.61803;
 
-	const std::map<std::string, double> consts{
+	const std::map<std::string, Real> consts{
 		{"pi", pi},
 		{"e", e},
 		{"phi", phi}
@@ -5,12 +5,14 @@
 
 #include <vector>
 #include <cmath>
+#include <limits>
+#include <algorithm>
 
 #include "../calculator/calculator.hpp"
 #include "../calculator/exceptions/exceptions.hpp"
 
 
-bool check_args(const std::vector<double> args, std::size_t n,
+bool check_args(const std::vector<Real> args, std::size_t n,
 		bool should_throw = true) {
 
 	if (args.size() != n) {
@@ -26,53 +28,116 @@ bool check_args(const std::vector<double> args, std::size_t n,
 }
 
 
-double sin_func(const std::vector<double> args);
-double cos_func(const std::vector<double> args);
-double tan_func(const std::vector<double> args);
-double csc_func(const std::vector<double> args);
-double sec_func(const std::vector<double> args);
-double cot_func(const std::vector<double> args);
-
-double asin_func(const std::vector<double> args);
-double acos_func(const std::vector<double> args);
-double atan_func(const std::vector<double> args);
-double acsc_func(const std::vector<double> args);
-double asec_func(const std::vector<double> args);
-double acot_func(const std::vector<double> args);
-
-double sinh_func(const std::vector<double> args);
-double cosh_func(const std::vector<double> args);
-double tanh_func(const std::vector<double> args);
-double csch_func(const std::vector<double> args);
-double sech_func(const std::vector<double> args);
-double coth_func(const std::vector<double> args);
-
-double asinh_func(const std::vector<double> args);
-double acosh_func(const std::vector<double> args);
-double atanh_func(const std::vector<double> args);
-double acsch_func(const std::vector<double> args);
-double asech_func(const std::vector<double> args);
-double acoth_func(const std::vector<double> args);
-
-double d_func(const std::vector<double> args);
-double r_func(const std::vector<double> args);
-
-double ln_func(const std::vector<double> args);
-double log_func(const std::vector<double> args);
-double log2_func(const std::vector<double> args);
-
-double sqrt_func(const std::vector<double> args);
-double cbrt_func(const std::vector<double> args);
-
-double abs_func(const std::vector<double> args);
-double round_func(const std::vector<double> args);
-
-double sum_func(const std::vector<double> args);
-double average_func(const std::vector<double> args);
-
-double factorial_func(const std::vector<double> args);
-double permutation_func(const std::vector<double> args);
-double combination_func(const std::vector<double> args);
+Real sin_func(const std::vector<Real> args);
+Real cos_func(const std::vector<Real> args);
+Real tan_func(const std::vector<Real> args);
+Real csc_func(const std::vector<Real> args);
+Real sec_func(const std::vector<Real> args);
+Real cot_func(const std::vector<Real> args);
+
+Real asin_func(const std::vector<Real> args);
+Real acos_func(const std::vector<Real> args);
+Real atan_func(const std::vector<Real> args);
+Real acsc_func(const std::vector<Real> args);
+Real asec_func(const std::vector<Real> args);
+Real acot_func(const std::vector<Real> args);
+
+Real sinh_func(const std::vector<Real> args);
+Real cosh_func(const std::vector<Real> args);
+Real tanh_func(const std::vector<Real> args);
+Real csch_func(const std::vector<Real> args);
+Real sech_func(const std::vector<Real> args);
+Real coth_func(const std::vector<Real> args);
+
+Real asinh_func(const std::vector<Real> args);
+Real acosh_func(const std::vector<Real> args);
+Real atanh_func(const std::vector<Real> args);
+Real acsch_func(const std::vector<Real> args);
+Real asech_func(const std::vector<Real> args);
+Real acoth_func(const std::vector<Real> args);
+
+Real d_func(const std::vector<Real> args);
+Real r_func(const std::vector<Real> args);
+
+Real ln_func(const std::vector<Real> args);
+Real log_func(const std::vector<Real> args);
+Real log2_func(const std::vector<Real> args);
+
+Real sqrt_func(const std::vector<Real> args);
+Real cbrt_func(const std::vector<Real> args);
+
+Real abs_func(const std::vector<Real> args);
+Real round_func(const std::vector<Real> args);
+
+Real sum_func(const std::vector<Real> args);
+Real product_func(const std::vector<Real> args);
+Real average_func(const std::vector<Real> args);
+
+Real min_func(const std::vector<Real> args);
+Real max_func(const std::vector<Real> args);
+Real median_func(const std::vector<Real> args);
+Real percentile_func(const std::vector<Real> args);
+Real variance_func(const std::vector<Real> args);
+
+Real factorial_func(const std::vector<Real> args);
+Real permutation_func(const std::vector<Real> args);
+Real combination_func(const std::vector<Real> args);
+
+
+std::vector<Real> sin_deriv(const std::vector<Real> args);
+std::vector<Real> cos_deriv(const std::vector<Real> args);
+std::vector<Real> tan_deriv(const std::vector<Real> args);
+std::vector<Real> csc_deriv(const std::vector<Real> args);
+std::vector<Real> sec_deriv(const std::vector<Real> args);
+std::vector<Real> cot_deriv(const std::vector<Real> args);
+
+std::vector<Real> asin_deriv(const std::vector<Real> args);
+std::vector<Real> acos_deriv(const std::vector<Real> args);
+std::vector<Real> atan_deriv(const std::vector<Real> args);
+std::vector<Real> acsc_deriv(const std::vector<Real> args);
+std::vector<Real> asec_deriv(const std::vector<Real> args);
+std::vector<Real> acot_deriv(const std::vector<Real> args);
+
+std::vector<Real> sinh_deriv(const std::vector<Real> args);
+std::vector<Real> cosh_deriv(const std::vector<Real> args);
+std::vector<Real> tanh_deriv(const std::vector<Real> args);
+std::vector<Real> csch_deriv(const std::vector<Real> args);
+std::vector<Real> sech_deriv(const std::vector<Real> args);
+std::vector<Real> coth_deriv(const std::vector<Real> args);
+
+std::vector<Real> asinh_deriv(const std::vector<Real> args);
+std::vector<Real> acosh_deriv(const std::vector<Real> args);
+std::vector<Real> atanh_deriv(const std::vector<Real> args);
+std::vector<Real> acsch_deriv(const std::vector<Real> args);
+std::vector<Real> asech_deriv(const std::vector<Real> args);
+std::vector<Real> acoth_deriv(const std::vector<Real> args);
+
+std::vector<Real> d_deriv(const std::vector<Real> args);
+std::vector<Real> r_deriv(const std::vector<Real> args);
+
+std::vector<Real> ln_deriv(const std::vector<Real> args);
+std::vector<Real> log_deriv(const std::vector<Real> args);
+std::vector<Real> log2_deriv(const std::vector<Real> args);
+
+std::vector<Real> sqrt_deriv(const std::vector<Real> args);
+std::vector<Real> cbrt_deriv(const std::vector<Real> args);
+
+std::vector<Real> abs_deriv(const std::vector<Real> args);
+std::vector<Real> round_deriv(const std::vector<Real> args);
+
+std::vector<Real> sum_deriv(const std::vector<Real> args);
+std::vector<Real> product_deriv(const std::vector<Real> args);
+std::vector<Real> average_deriv(const std::vector<Real> args);
+
+std::vector<Real> min_deriv(const std::vector<Real> args);
+std::vector<Real> max_deriv(const std::vector<Real> args);
+std::vector<Real> median_deriv(const std::vector<Real> args);
+std::vector<Real> percentile_deriv(const std::vector<Real> args);
+std::vector<Real> variance_deriv(const std::vector<Real> args);
+
+std::vector<Real> factorial_deriv(const std::vector<Real> args);
+std::vector<Real> permutation_deriv(const std::vector<Real> args);
+std::vector<Real> combination_deriv(const std::vector<Real> args);
 
 
 /**
@@ -122,8 +187,15 @@ std::map<std::string, Calc_func> get_funcs() {
 		{ "round", round_func },
 
 		{ "sum", sum_func },
+		{ "product", product_func },
 		{ "average", average_func },
 
+		{ "min", min_func },
+		{ "max", max_func },
+		{ "median", median_func },
+		{ "percentile", percentile_func },
+		{ "variance", variance_func },
+
 		{ "factorial", factorial_func },
 		{ "combination", combination_func },
 		{ "permutation", permutation_func },
@@ -133,182 +205,287 @@ std::map<std::string, Calc_func> get_funcs() {
 }
 
 
-double sin_func(const std::vector<double> args) {
+/**
+ * Return a map<name, partial derivatives> for every function from
+ * get_funcs().
+ */
+std::map<std::string, Calc_deriv> get_derivs() {
+	const std::map<std::string, Calc_deriv> derivs{
+		{ "sin", sin_deriv },
+		{ "cos", cos_deriv },
+		{ "tan", tan_deriv },
+		{ "csc", csc_deriv },
+		{ "sec", sec_deriv },
+		{ "cot", cot_deriv },
+
+		{ "asin", asin_deriv },
+		{ "acos", acos_deriv },
+		{ "atan", atan_deriv },
+		{ "acsc", acsc_deriv },
+		{ "asec", asec_deriv },
+		{ "acot", acot_deriv },
+
+		{ "sinh", sinh_deriv },
+		{ "cosh", cosh_deriv },
+		{ "tanh", tanh_deriv },
+		{ "csch", csch_deriv },
+		{ "sech", sech_deriv },
+		{ "coth", coth_deriv },
+
+		{ "asinh", asinh_deriv },
+		{ "acosh", acosh_deriv },
+		{ "atanh", atanh_deriv },
+		{ "acsch", acsch_deriv },
+		{ "asech", asech_deriv },
+		{ "acoth", acoth_deriv },
+
+		{ "d", d_deriv },
+		{ "r", r_deriv },
+
+		{ "ln", ln_deriv },
+		{ "log", log_deriv },
+		{ "logb", log2_deriv },
+
+		{ "sqrt", sqrt_deriv },
+		{ "cbrt", cbrt_deriv },
+
+		{ "abs", abs_deriv },
+		{ "round", round_deriv },
+
+		{ "sum", sum_deriv },
+		{ "product", product_deriv },
+		{ "average", average_deriv },
+
+		{ "min", min_deriv },
+		{ "max", max_deriv },
+		{ "median", median_deriv },
+		{ "percentile", percentile_deriv },
+		{ "variance", variance_deriv },
+
+		{ "factorial", factorial_deriv },
+		{ "permutation", permutation_deriv },
+		{ "combination", combination_deriv },
+	};
+
+	return derivs;
+}
+
+
+/**
+ * Return how many arguments each function from get_funcs() takes.
+ */
+std::map<std::string, Arity> get_arities() {
+	constexpr auto any = std::numeric_limits<std::size_t>::max();
+
+	std::map<std::string, Arity> arities;
+	for (const auto& f : get_funcs()) {
+		arities[f.first] = Arity{ 1, 1 };
+	}
+
+	arities["sum"] = arities["product"] = Arity{ 0, any };
+	arities["average"] = arities["min"] = arities["max"] =
+		arities["median"] = Arity{ 1, any };
+	arities["percentile"] = arities["variance"] = Arity{ 2, any };
+	arities["combination"] = arities["permutation"] = Arity{ 2, 2 };
+
+	return arities;
+}
+
+
+/**
+ * Return the names of the functions from get_funcs() whose results
+ * depend only on their arguments, and which cost enough that caching
+ * their results pays when arguments repeat; those left out take about
+ * as long as a cache lookup, or any number of arguments.
+ */
+std::vector<std::string> get_pure_funcs() {
+	return {
+		"sin", "cos", "tan", "csc", "sec", "cot",
+		"asin", "acos", "atan", "acsc", "asec", "acot",
+		"sinh", "cosh", "tanh", "csch", "sech", "coth",
+		"asinh", "acosh", "atanh", "acsch", "asech", "acoth",
+		"ln", "log", "logb", "cbrt",
+		"factorial", "combination", "permutation",
+	};
+}
+
+
+Real sin_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::sin(args[0]);
 }
 
-double cos_func(const std::vector<double> args) {
+Real cos_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::cos(args[0]);
 }
 
-double tan_func(const std::vector<double> args) {
+Real tan_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::tan(args[0]);
 }
 
-double csc_func(const std::vector<double> args) {
+Real csc_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return 1 / std::sin(args[0]);
 }
 
-double sec_func(const std::vector<double> args) {
+Real sec_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return 1 / std::cos(args[0]);
 }
 
-double cot_func(const std::vector<double> args) {
+Real cot_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return 1 / std::tan(args[0]);
 }
 
-double asin_func(const std::vector<double> args) {
+Real asin_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::asin(args[0]);
 }
 
-double acos_func(const std::vector<double> args) {
+Real acos_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::acos(args[0]);
 }
 
 
-double atan_func(const std::vector<double> args) {
+Real atan_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::atan(args[0]);
 }
 
-double acsc_func(const std::vector<double> args) {
+Real acsc_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::asin(1 / args[0]);
 }
 
-double asec_func(const std::vector<double> args) {
+Real asec_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::acos(1 / args[0]);
 }
 
-double acot_func(const std::vector<double> args) {
+Real acot_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::atan(1 / args[0]);
 }
 
-double sinh_func(const std::vector<double> args) {
+Real sinh_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::sinh(args[0]);
 }
 
-double cosh_func(const std::vector<double> args) {
+Real cosh_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::cosh(args[0]);
 }
 
 
-double tanh_func(const std::vector<double> args) {
+Real tanh_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::tanh(args[0]);
 }
 
-double csch_func(const std::vector<double> args) {
+Real csch_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return 1 / std::sinh(args[0]);
 }
 
-double sech_func(const std::vector<double> args) {
+Real sech_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return 1 / std::cosh(args[0]);
 }
 
-double coth_func(const std::vector<double> args) {
+Real coth_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return 1 / std::tanh(args[0]);
 }
 
-double asinh_func(const std::vector<double> args) {
+Real asinh_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::asinh(args[0]);
 }
 
-double acosh_func(const std::vector<double> args) {
+Real acosh_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::acosh(args[0]);
 }
 
 
-double atanh_func(const std::vector<double> args) {
+Real atanh_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::atanh(args[0]);
 }
 
-double acsch_func(const std::vector<double> args) {
+Real acsch_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::asinh(1 / args[0]);
 }
 
-double asech_func(const std::vector<double> args) {
+Real asech_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::acosh(1 / args[0]);
 }
 
-double acoth_func(const std::vector<double> args) {
+Real acoth_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::atanh(1 / args[0]);
 }
 
 
-double d_func(const std::vector<double> args) {
+Real d_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return args[0] * 57.2958;
 }
 
 
-double r_func(const std::vector<double> args) {
+Real r_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return args[0] * 0.0174533;
 }
 
 
-double ln_func(const std::vector<double> args) {
+Real ln_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::log(args[0]);
 }
 
-double log_func(const std::vector<double> args) {
+Real log_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::log10(args[0]);
 }
 
-double log2_func(const std::vector<double> args) {
+Real log2_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::log2(args[0]);
 }
 
 
-double sqrt_func(const std::vector<double> args) {
+Real sqrt_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::sqrt(args[0]);
 }
 
-double cbrt_func(const std::vector<double> args) {
+Real cbrt_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::cbrt(args[0]);
 }
 
 
-double abs_func(const std::vector<double> args) {
+Real abs_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::fabs(args[0]);
 }
 
-double round_func(const std::vector<double> args) {
+Real round_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::round(args[0]);
 }
 
 
-double sum_func(const std::vector<double> args) {
-	double s = 0;
+Real sum_func(const std::vector<Real> args) {
+	Real s = 0;
 	for (auto i : args) {
 		s += i;
 	}
@@ -316,7 +493,16 @@ double sum_func(const std::vector<double> args) {
 	return s;
 }
 
-double average_func(const std::vector<double> args) {
+Real product_func(const std::vector<Real> args) {
+	Real p = 1;
+	for (auto i : args) {
+		p *= i;
+	}
+
+	return p;
+}
+
+Real average_func(const std::vector<Real> args) {
 	if (check_args(args, 0, false)) {
 		throw Unsupported_operand{
 			"can't take average of zero numbers" };
@@ -326,21 +512,444 @@ double average_func(const std::vector<double> args) {
 }
 
 
-double factorial_func(const std::vector<double> args) {
+void check_numbers(const std::vector<Real>& args, std::size_t least,
+		const char* name) {
+	if (args.size() < least) {
+		throw Unsupported_operand{ std::string{ "can't take " } + name +
+			((least > 1) ? " of fewer than two numbers"
+				: " of zero numbers") };
+	}
+}
+
+Real min_func(const std::vector<Real> args) {
+	check_numbers(args, 1, "min");
+	return *std::min_element(args.begin(), args.end());
+}
+
+Real max_func(const std::vector<Real> args) {
+	check_numbers(args, 1, "max");
+	return *std::max_element(args.begin(), args.end());
+}
+
+
+/**
+ * The one or two order statistics making up the percentile at rank h,
+ * counted from 0. select_rank finds them in linear time, reordering
+ * values.
+ */
+struct Order_stats {
+	Real lo;
+	Real hi;
+	Real fraction;		// of the way from lo to hi
+};
+
+Order_stats select_rank(std::vector<Real>& values, Real h) {
+	auto i = static_cast<std::size_t>(h);
+	auto nth = values.begin() + i;
+	std::nth_element(values.begin(), nth, values.end());
+
+	// every value after the i-th is at least as large, so the next
+	// order statistic is the least of them
+	auto next = (i + 1 < values.size())
+		? *std::min_element(nth + 1, values.end()) : *nth;
+
+	return { *nth, next, h - i };
+}
+
+Real percentile_of(std::vector<Real> values, Real p) {
+	auto s = select_rank(values, (values.size() - 1) * p / 100);
+	return s.lo + s.fraction * (s.hi - s.lo);
+}
+
+Real median_func(const std::vector<Real> args) {
+	check_numbers(args, 1, "median");
+	return percentile_of(args, 50);
+}
+
+// percentile[p, x1, x2, ...], with p from 0 to 100, interpolating
+// between the two nearest values
+void check_percentile(const std::vector<Real>& args) {
+	check_numbers(args, 2, "percentile");
+	if (!(args[0] >= 0 && args[0] <= 100)) {
+		throw Unsupported_operand{
+			"percentile must be from 0 to 100" };
+	}
+}
+
+Real percentile_func(const std::vector<Real> args) {
+	check_percentile(args);
+	return percentile_of({ args.begin() + 1, args.end() }, args[0]);
+}
+
+// the sample variance
+Real variance_func(const std::vector<Real> args) {
+	check_numbers(args, 2, "variance");
+
+	Real mean = 0;
+	Real squares = 0;
+	std::size_t n = 0;
+	for (auto x : args) {
+		auto delta = x - mean;
+		mean += delta / ++n;
+		squares += delta * (x - mean);
+	}
+
+	return squares / (n - 1);
+}
+
+
+Real factorial_func(const std::vector<Real> args) {
 	check_args(args, 1);
 	return std::tgamma(args[0] + 1);
 }
 
 
-double permutation_func(const std::vector<double> args) {
+Real permutation_func(const std::vector<Real> args) {
 	check_args(args, 2);
 	return std::tgamma(args[0] + 1) / 
 		std::tgamma(args[0] - args[1] + 1);
 }
 
-double combination_func(const std::vector<double> args) {
+Real combination_func(const std::vector<Real> args) {
 	auto p = permutation_func(args);
 	return p / std::tgamma(args[1] + 1);
 }
 
+
+std::vector<Real> sin_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { std::cos(x) };
+}
+
+std::vector<Real> cos_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { -std::sin(x) };
+}
+
+std::vector<Real> tan_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / (std::cos(x) * std::cos(x)) };
+}
+
+std::vector<Real> csc_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { -1 / (std::sin(x) * std::tan(x)) };
+}
+
+std::vector<Real> sec_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { std::tan(x) / std::cos(x) };
+}
+
+std::vector<Real> cot_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { -1 / (std::sin(x) * std::sin(x)) };
+}
+
+
+std::vector<Real> asin_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / std::sqrt(1 - x * x) };
+}
+
+std::vector<Real> acos_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { -1 / std::sqrt(1 - x * x) };
+}
+
+std::vector<Real> atan_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / (1 + x * x) };
+}
+
+std::vector<Real> acsc_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { -1 / (std::fabs(x) * std::sqrt(x * x - 1)) };
+}
+
+std::vector<Real> asec_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / (std::fabs(x) * std::sqrt(x * x - 1)) };
+}
+
+std::vector<Real> acot_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { -1 / (1 + x * x) };
+}
+
+
+std::vector<Real> sinh_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { std::cosh(x) };
+}
+
+std::vector<Real> cosh_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { std::sinh(x) };
+}
+
+std::vector<Real> tanh_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 - std::tanh(x) * std::tanh(x) };
+}
+
+std::vector<Real> csch_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { -1 / (std::sinh(x) * std::tanh(x)) };
+}
+
+std::vector<Real> sech_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { -std::tanh(x) / std::cosh(x) };
+}
+
+std::vector<Real> coth_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { -1 / (std::sinh(x) * std::sinh(x)) };
+}
+
+
+std::vector<Real> asinh_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / std::sqrt(x * x + 1) };
+}
+
+std::vector<Real> acosh_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / std::sqrt(x * x - 1) };
+}
+
+std::vector<Real> atanh_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / (1 - x * x) };
+}
+
+std::vector<Real> acsch_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { -1 / (std::fabs(x) * std::sqrt(x * x + 1)) };
+}
+
+std::vector<Real> asech_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { -1 / (x * std::sqrt(1 - x * x)) };
+}
+
+std::vector<Real> acoth_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / (1 - x * x) };
+}
+
+
+std::vector<Real> d_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	return { 57.2958 };
+}
+
+std::vector<Real> r_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	return { 0.0174533 };
+}
+
+
+std::vector<Real> ln_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / x };
+}
+
+std::vector<Real> log_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / (x * std::log(Real{ 10 })) };
+}
+
+std::vector<Real> log2_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / (x * std::log(Real{ 2 })) };
+}
+
+
+std::vector<Real> sqrt_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / (2 * std::sqrt(x)) };
+}
+
+std::vector<Real> cbrt_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { 1 / (3 * std::cbrt(x) * std::cbrt(x)) };
+}
+
+
+std::vector<Real> abs_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { static_cast<Real>((x > 0) - (x < 0)) };
+}
+
+std::vector<Real> round_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	return { 0 };
+}
+
+
+std::vector<Real> sum_deriv(const std::vector<Real> args) {
+	return std::vector<Real>(args.size(), 1);
+}
+
+std::vector<Real> product_deriv(const std::vector<Real> args) {
+	// the product of all arguments but the i-th, without dividing by
+	// it, as it may be 0
+	std::vector<Real> d(args.size(), 1);
+
+	Real before = 1;
+	for (std::size_t i = 0; i < args.size(); ++i) {
+		d[i] = before;
+		before *= args[i];
+	}
+
+	Real after = 1;
+	for (std::size_t i = args.size(); i > 0; --i) {
+		d[i - 1] *= after;
+		after *= args[i - 1];
+	}
+
+	return d;
+}
+
+std::vector<Real> average_deriv(const std::vector<Real> args) {
+	if (check_args(args, 0, false)) {
+		throw Unsupported_operand{
+			"can't take average of zero numbers" };
+	}
+
+	return std::vector<Real>(args.size(), 1.0 / args.size());
+}
+
+
+std::vector<Real> min_deriv(const std::vector<Real> args) {
+	check_numbers(args, 1, "min");
+	std::vector<Real> d(args.size(), 0);
+	d[std::min_element(args.begin(), args.end()) - args.begin()] = 1;
+	return d;
+}
+
+std::vector<Real> max_deriv(const std::vector<Real> args) {
+	check_numbers(args, 1, "max");
+	std::vector<Real> d(args.size(), 0);
+	d[std::max_element(args.begin(), args.end()) - args.begin()] = 1;
+	return d;
+}
+
+
+/**
+ * The partial derivatives of the percentile p of values: the weights
+ * of the two values it interpolates between, and, in *dp, its rate of
+ * change with p.
+ */
+std::vector<Real> percentile_weights(const std::vector<Real>& values,
+		Real p, Real* dp) {
+
+	auto selected = values;
+	auto s = select_rank(selected, (values.size() - 1) * p / 100);
+
+	std::vector<Real> d(values.size(), 0);
+	auto lo = std::find(values.begin(), values.end(), s.lo);
+	d[lo - values.begin()] += 1 - s.fraction;
+
+	// with ties, the other value is a different argument
+	auto hi = std::find(values.begin(), values.end(), s.hi);
+	if (hi == lo && s.lo == s.hi) {
+		hi = std::find(lo + 1, values.end(), s.hi);
+	}
+	if (hi != values.end()) {
+		d[hi - values.begin()] += s.fraction;
+	}
+
+	if (dp) {
+		*dp = (s.hi - s.lo) * (values.size() - 1) / 100;
+	}
+
+	return d;
+}
+
+std::vector<Real> median_deriv(const std::vector<Real> args) {
+	check_numbers(args, 1, "median");
+	return percentile_weights(args, 50, nullptr);
+}
+
+std::vector<Real> percentile_deriv(const std::vector<Real> args) {
+	check_percentile(args);
+
+	Real dp;
+	auto d = percentile_weights({ args.begin() + 1, args.end() }, args[0],
+		&dp);
+	d.insert(d.begin(), dp);
+
+	return d;
+}
+
+std::vector<Real> variance_deriv(const std::vector<Real> args) {
+	check_numbers(args, 2, "variance");
+	auto mean = average_func(args);
+
+	std::vector<Real> d;
+	for (auto x : args) {
+		d.push_back(2 * (x - mean) / (args.size() - 1));
+	}
+
+	return d;
+}
+
+
+std::vector<Real> factorial_deriv(const std::vector<Real> args) {
+	check_args(args, 1);
+	Real x = args[0];
+	return { std::tgamma(x + 1) * digamma(x + 1) };
+}
+
+
+std::vector<Real> permutation_deriv(const std::vector<Real> args) {
+	auto p = permutation_func(args);
+	auto dn = digamma(args[0] + 1);
+	auto dnk = digamma(args[0] - args[1] + 1);
+
+	return { p * (dn - dnk), p * dnk };
+}
+
+std::vector<Real> combination_deriv(const std::vector<Real> args) {
+	auto c = combination_func(args);
+	auto dn = digamma(args[0] + 1);
+	auto dnk = digamma(args[0] - args[1] + 1);
+	auto dk = digamma(args[1] + 1);
+
+	return { c * (dn - dnk), c * (dnk - dk) };
+}
+
 #endif // !CALC_CLI_FUNCTIONS_HPP
@@ -0,0 +1,78 @@
+#pragma once
+#ifndef CALC_CLI_CHUNK_BUF_HPP
+#define CALC_CLI_CHUNK_BUF_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * chunk_buf.hpp defines Chunk_buf, which captures what would be
+ * printed, so that output produced out of order can be printed in
+ * order later.
+ */
+
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <streambuf>
+
+
+// a piece of output, and whether it belongs to the standard error
+struct Chunk {
+	std::string text;
+	bool error;
+};
+
+
+/**
+ * A stream buffer which records everything written to it as Chunks,
+ * so that the order of writes to the output and error streams is
+ * kept.
+ */
+class Chunk_buf : public std::streambuf {
+public:
+	Chunk_buf(std::vector<Chunk>& destination, bool is_error)
+			:chunks{ &destination }, error{ is_error } {
+	}
+
+	void redirect(std::vector<Chunk>& destination) {
+		chunks = &destination;
+	}
+
+protected:
+	std::streamsize xsputn(const char* s, std::streamsize n) override {
+		if (chunks->empty() || chunks->back().error != error) {
+			chunks->push_back(Chunk{ "", error });
+		}
+
+		chunks->back().text.append(s, static_cast<std::size_t>(n));
+		return n;
+	}
+
+	int_type overflow(int_type c) override {
+		if (!traits_type::eq_int_type(c, traits_type::eof())) {
+			char ch = traits_type::to_char_type(c);
+			xsputn(&ch, 1);
+		}
+
+		return traits_type::not_eof(c);
+	}
+
+private:
+	std::vector<Chunk>* chunks;
+	bool error;
+};
+
+
+/**
+ * Print chunks to the standard output and error.
+ */
+inline void print_chunks(const std::vector<Chunk>& chunks) {
+	for (const auto& c : chunks) {
+		(c.error ? std::cerr : std::cout) << c.text;
+	}
+}
+
+
+#endif // !CALC_CLI_CHUNK_BUF_HPP
@@ -0,0 +1,97 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * mapped_file.cpp defines Mapped_file from mapped_file.hpp.
+ */
+
+
+#include <string>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.hpp"
+
+
+using std::string;
+
+
+#ifdef _WIN32
+
+Mapped_file::Mapped_file(const string& path, File_access) {
+	auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return;
+	}
+
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(file, &size)) {
+		length = static_cast<std::size_t>(size.QuadPart);
+		opened = true;
+	}
+
+	// an empty file can't be mapped, and has nothing to map anyway
+	if (opened && length > 0) {
+		auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY,
+			0, 0, nullptr);
+		if (mapping) {
+			start = static_cast<const char*>(
+				MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(mapping);
+		}
+
+		opened = (start != nullptr);
+	}
+
+	CloseHandle(file);
+}
+
+Mapped_file::~Mapped_file() {
+	if (start) {
+		UnmapViewOfFile(start);
+	}
+}
+
+#else
+
+Mapped_file::Mapped_file(const string& path, File_access access) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+
+	struct stat s;
+	if (fstat(fd, &s) == 0) {
+		length = static_cast<std::size_t>(s.st_size);
+		opened = true;
+	}
+
+	// an empty file can't be mapped, and has nothing to map anyway
+	if (opened && length > 0) {
+		void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED) {
+			start = static_cast<const char*>(p);
+			madvise(p, length, (access == File_access::sequential)
+				? MADV_SEQUENTIAL : MADV_RANDOM);
+		}
+
+		opened = (start != nullptr);
+	}
+
+	close(fd);
+}
+
+Mapped_file::~Mapped_file() {
+	if (start) {
+		munmap(const_cast<char*>(start), length);
+	}
+}
+
+#endif // _WIN32
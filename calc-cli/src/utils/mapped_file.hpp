@@ -0,0 +1,56 @@
+#pragma once
+#ifndef CALC_CLI_MAPPED_FILE_HPP
+#define CALC_CLI_MAPPED_FILE_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * mapped_file.hpp declares Mapped_file, a file mapped into memory for
+ * reading, used by tables and saved sessions.
+ */
+
+
+#include <string>
+#include <cstddef>
+
+
+// how a mapped file will be read, as a hint to the system
+enum class File_access {
+	sequential,			// from start to end, once
+	random				// a little at a time, anywhere
+};
+
+
+/**
+ * A file mapped into memory for reading.
+ */
+class Mapped_file {
+public:
+	explicit Mapped_file(const std::string& path,
+		File_access access = File_access::sequential);
+	~Mapped_file();
+
+	Mapped_file(const Mapped_file&) = delete;
+	Mapped_file& operator=(const Mapped_file&) = delete;
+
+	explicit operator bool() const {
+		return opened;
+	}
+
+	const char* data() const {
+		return start;
+	}
+
+	std::size_t size() const {
+		return length;
+	}
+
+private:
+	bool opened = false;
+	const char* start = nullptr;
+	std::size_t length = 0;
+};
+
+
+#endif // !CALC_CLI_MAPPED_FILE_HPP
@@ -0,0 +1,189 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * memo.cpp defines the functions from memo.hpp.
+ *
+ * A cache is keyed on the exact bits of the arguments, so 0 and -0
+ * are different keys and NaN arguments are cached like any other. It
+ * is split into shards, each with its own lock, so that the threads of
+ * a parallel reduction rarely wait for each other; a shard is emptied
+ * once it holds its share of the cache's memory.
+ */
+
+
+#include <array>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+#include "memo.hpp"
+
+
+using std::vector;
+
+using ull = unsigned long long;
+
+
+// calls with more arguments than this aren't cached
+constexpr std::size_t max_args = 3;
+
+constexpr std::size_t shard_count = 16;
+
+// 64-bit words needed for the bits of a Real
+constexpr std::size_t words = (sizeof(Real) + 7) / 8;
+
+
+struct Key {
+	std::array<std::uint64_t, max_args * words> bits;
+	std::size_t count;		// number of arguments
+
+	bool operator==(const Key& other) const {
+		return count == other.count && bits == other.bits;
+	}
+};
+
+struct Key_hash {
+	std::size_t operator()(const Key& k) const {
+		std::uint64_t h = k.count;
+		for (auto b : k.bits) {
+			h = (h ^ b) * 0x9e3779b97f4a7c15ull;
+			h ^= h >> 29;
+		}
+
+		return static_cast<std::size_t>(h);
+	}
+};
+
+
+struct Shard {
+	std::mutex lock;		// guards everything below
+	std::unordered_map<Key, Real, Key_hash> values;
+	ull hits = 0;
+	ull misses = 0;
+};
+
+
+class Memo {
+public:
+	Memo(const std::string& function_name, std::size_t max_bytes)
+			:name{ function_name },
+			limit{ max_bytes / shard_count / entry_bytes } {
+	}
+
+	Real call(const Calc_func& func, const vector<Real>& args);
+
+	Memo_stats stats();
+
+private:
+	// roughly what an entry of an unordered_map costs: the key and
+	// value, the link to the next entry, the stored hash and a bucket
+	static constexpr std::size_t entry_bytes =
+		sizeof(std::pair<const Key, Real>) + 3 * sizeof(void*);
+
+	std::string name;
+	std::size_t limit;		// entries per shard
+	std::array<Shard, shard_count> shards;
+};
+
+
+// every cache made by memoize, for memo_stats
+std::mutex registry_lock;
+vector<std::shared_ptr<Memo>> registry;
+
+
+/**
+ * Return a Calc_func which gives the same results as func, looking
+ * them up in a cache of at most about max_bytes where possible.
+ * func must be pure: its result must depend only on its arguments.
+ */
+Calc_func memoize(const std::string& name, Calc_func func,
+		std::size_t max_bytes) {
+
+	auto memo = std::make_shared<Memo>(name, max_bytes);
+	{
+		std::lock_guard<std::mutex> guard{ registry_lock };
+		registry.push_back(memo);
+	}
+
+	return [memo, func](const vector<Real>& args) {
+		if (args.size() > max_args) {
+			return func(args);
+		}
+
+		return memo->call(func, args);
+	};
+}
+
+
+/**
+ * Return the counters of every cache made by memoize, in the order
+ * they were made.
+ */
+vector<Memo_stats> memo_stats() {
+	std::lock_guard<std::mutex> guard{ registry_lock };
+
+	vector<Memo_stats> stats;
+	for (const auto& m : registry) {
+		stats.push_back(m->stats());
+	}
+
+	return stats;
+}
+
+
+/**
+ * Return func(args), from the cache if it's there. Errors aren't
+ * cached.
+ */
+Real Memo::call(const Calc_func& func, const vector<Real>& args) {
+	Key key{ {}, args.size() };
+	for (std::size_t i = 0; i < args.size(); ++i) {
+		std::memcpy(&key.bits[i * words], &args[i], sizeof(Real));
+	}
+
+	auto hash = Key_hash{}(key);
+
+	// the map uses the low bits of the hash, so pick the shard by the
+	// high ones
+	auto& s = shards[(hash >> 32) % shard_count];
+	{
+		std::lock_guard<std::mutex> guard{ s.lock };
+
+		auto v = s.values.find(key);
+		if (v != s.values.end()) {
+			++s.hits;
+			return v->second;
+		}
+
+		++s.misses;
+	}
+
+	// compute without holding the lock, which other threads may need
+	auto result = func(args);
+
+	std::lock_guard<std::mutex> guard{ s.lock };
+	if (s.values.size() >= limit) {
+		s.values.clear();
+	}
+	s.values.emplace(key, result);
+
+	return result;
+}
+
+
+Memo_stats Memo::stats() {
+	Memo_stats total{ name, 0, 0, 0 };
+	for (auto& s : shards) {
+		std::lock_guard<std::mutex> guard{ s.lock };
+
+		total.hits += s.hits;
+		total.misses += s.misses;
+		total.entries += s.values.size();
+	}
+
+	return total;
+}
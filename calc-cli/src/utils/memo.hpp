@@ -0,0 +1,36 @@
+#pragma once
+#ifndef CALC_CLI_MEMO_HPP
+#define CALC_CLI_MEMO_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * memo.hpp declares memoize, which wraps a pure function in a bounded
+ * cache of its results, and memo_stats, which reports how well every
+ * such cache is doing.
+ */
+
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "../calculator/node/node.hpp"
+
+
+struct Memo_stats {
+	std::string name;
+	unsigned long long hits;
+	unsigned long long misses;
+	std::size_t entries;	// results held right now
+};
+
+
+Calc_func memoize(const std::string& name, Calc_func func,
+	std::size_t max_bytes);
+
+std::vector<Memo_stats> memo_stats();
+
+
+#endif // !CALC_CLI_MEMO_HPP
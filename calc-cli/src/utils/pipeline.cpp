@@ -0,0 +1,198 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * pipeline.cpp defines run_stream from utils.hpp, which handles
+ * input that doesn't come from a terminal in three stages, each on
+ * its own thread:
+ *
+ * reader		reads the input in large blocks and splits it into
+ *				batches of lines
+ * evaluator	responds to every line exactly as the REPL would,
+ *				capturing what would be printed
+ * writer		prints the captured output in order
+ *
+ * The stages are connected by Spsc_queues, so reading and printing
+ * overlap with calculating. The output, including prompts, is the
+ * same as if the lines had been typed into the REPL.
+ */
+
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <ostream>
+#include <iostream>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "utils.hpp"
+#include "spsc_queue.hpp"
+#include "chunk_buf.hpp"
+#include "calc_consts.hpp"
+
+
+using std::string;
+using std::vector;
+
+
+// a batch holds at most this many lines
+constexpr std::size_t batch_lines = 256;
+
+// how many batches may wait between two stages
+constexpr std::size_t queue_size = 16;
+
+// how much input is read at a time
+constexpr std::size_t read_size = 1 << 16;
+
+
+struct Batch {
+	vector<string> lines;
+	bool last;			// nothing follows this batch
+};
+
+
+struct Output {
+	vector<Chunk> chunks;
+	bool last;			// nothing follows this output
+	bool quit;			// the input asked to quit
+};
+
+
+void read_batches(Spsc_queue<Batch, queue_size>& batches);
+void write_outputs(Spsc_queue<Output, queue_size>& outputs);
+
+
+/**
+ * Respond to every line of the standard input. Return the exit code.
+ */
+int run_stream(Calculator& calc) {
+	Spsc_queue<Batch, queue_size> batches;
+	Spsc_queue<Output, queue_size> outputs;
+
+	std::thread reader{ read_batches, std::ref(batches) };
+	std::thread writer{ write_outputs, std::ref(outputs) };
+
+	vector<Chunk> scratch;
+	Chunk_buf out_buf{ scratch, false };
+	Chunk_buf err_buf{ scratch, true };
+	std::ostream out{ &out_buf };
+	std::ostream err{ &err_buf };
+
+	bool quit_seen = false;
+	for (bool done = false; !done; ) {
+		auto batch = batches.pop();
+
+		Output o{ {}, batch.last, false };
+		out_buf.redirect(o.chunks);
+		err_buf.redirect(o.chunks);
+
+		for (const auto& line : batch.lines) {
+			out << prompt;
+			if (!respond(line, calc, out, err)) {
+				o.last = o.quit = true;
+				break;
+			}
+		}
+
+		// the REPL prompts once more before it finds the end of input
+		if (batch.last && !o.quit) {
+			out << prompt;
+		}
+
+		done = o.last;
+		quit_seen = o.quit;
+		outputs.push(std::move(o));
+	}
+
+	writer.join();
+
+	if (quit_seen) {
+		// like the REPL, leave right away; the reader may still be
+		// waiting for input which will never be used
+		std::exit(0);
+	}
+
+	reader.join();
+	return 0;
+}
+
+
+/**
+ * Read the standard input into batches of lines. Whatever is
+ * available is used right away, so that a program writing one line
+ * at a time gets its answer without waiting for a full block.
+ */
+void read_batches(Spsc_queue<Batch, queue_size>& batches) {
+	vector<char> block(read_size);
+
+	Batch batch{ {}, false };
+	string partial;		// a line which continues in the next block
+
+	while (true) {
+#ifdef _WIN32
+		auto got = _read(0, block.data(),
+			static_cast<unsigned>(block.size()));
+#else
+		auto got = read(0, block.data(), block.size());
+#endif
+		if (got <= 0) {
+			break;
+		}
+
+		auto n = static_cast<std::size_t>(got);
+
+		std::size_t start = 0;
+		for (std::size_t i = 0; i < n; ++i) {
+			if (block[i] != '\n') {
+				continue;
+			}
+
+			partial.append(block.data() + start, i - start);
+			batch.lines.push_back(std::move(partial));
+			partial.clear();
+			start = i + 1;
+
+			if (batch.lines.size() == batch_lines) {
+				batches.push(std::move(batch));
+				batch = Batch{ {}, false };
+			}
+		}
+
+		partial.append(block.data() + start, n - start);
+
+		// don't hold back complete lines while waiting for input
+		if (!batch.lines.empty()) {
+			batches.push(std::move(batch));
+			batch = Batch{ {}, false };
+		}
+	}
+
+	// std::getline returns a last line even without a newline
+	if (!partial.empty()) {
+		batch.lines.push_back(std::move(partial));
+	}
+
+	batch.last = true;
+	batches.push(std::move(batch));
+}
+
+
+/**
+ * Print outputs in order, until the last one.
+ */
+void write_outputs(Spsc_queue<Output, queue_size>& outputs) {
+	for (bool done = false; !done; ) {
+		auto o = outputs.pop();
+
+		print_chunks(o.chunks);
+
+		// the REPL flushes whenever it waits for input
+		std::cout.flush();
+		done = o.last;
+	}
+}
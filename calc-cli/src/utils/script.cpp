@@ -0,0 +1,624 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * script.cpp defines run_script from utils.hpp, which runs a file of
+ * statements with independent statements evaluated concurrently, and
+ * prints exactly what running them one at a time would.
+ *
+ * Every line is parsed first, to find which lines must run before it:
+ *
+ * - a line which uses a name runs after the last earlier declaration
+ *   of that name, so it sees that declaration, or the error which left
+ *   the name undefined
+ * - a declaration of a name runs after every earlier line which uses
+ *   or declares it, so that none of them sees it too soon, and an
+ *   earlier declaration can make it a redeclaration
+ * - a line which reads `_` runs after every earlier line which can
+ *   set it; `_` is then the value of the last of those which succeeded
+ * - memo, stats, profile and save, which depend on everything before
+ *   them, and load, which changes everything after it, run after
+ *   every earlier line and before every later one
+ *
+ * Lines are then run on every processor as soon as the lines they
+ * depend on are done. Declarations are published through a
+ * Shared_calculator, so each line sees the definitions of exactly the
+ * lines it depends on, among others it doesn't use. The output of each
+ * line is captured and printed in order at the end.
+ *
+ * Given the variables wanted as outputs, only the lines their
+ * declarations need are run: the declarations they use, the lines
+ * whose `_` they read, a load before them, and so on back, with a save
+ * or load needing every line before it. A line which a needed one only
+ * must not overtake, such as one using a name it redeclares, is
+ * skipped like every other.
+ */
+
+
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <algorithm>
+#include <condition_variable>
+
+#include "utils.hpp"
+#include "chunk_buf.hpp"
+#include "calc_consts.hpp"
+#include "../calculator/pool/pool.hpp"
+#include "../calculator/shared/shared.hpp"
+#include "../calculator/token/token.hpp"
+#include "../calculator/exceptions/exceptions.hpp"
+
+
+using std::string;
+using std::vector;
+
+
+constexpr auto none = static_cast<std::size_t>(-1);
+
+
+struct Line {
+	string text{};
+
+	bool declaration = false;	// a let statement
+	bool reads_prev = false;	// uses `_`, or shows it
+	bool sets_prev = false;		// changes `_` if it succeeds
+	bool counted = false;		// its value is counted by stats
+	bool barrier = false;		// memo, stats, profile, save or load
+	bool loads = false;			// load
+	string name{};				// the name it declares, if any
+
+	vector<std::size_t> after{};	// lines this one depends on
+	vector<std::size_t> before{};	// lines depending on this one
+	std::size_t waiting = 0;		// of after, how many aren't done
+	vector<std::size_t> needs{};	// of after, those whose effects it
+									// uses, not only ones it mustn't
+									// overtake
+	bool needed = true;				// run at all; false if skipped
+
+	// filled in when the line has run
+	vector<Chunk> output{};
+	bool succeeded = false;
+	bool is_vector = false;		// its value was a vector, which leaves
+								// `_` as it was
+	Real prev_in = 0;			// `_` when it ran
+	Real value = 0;				// `_` after it, if it sets it
+	std::unique_ptr<Running_stats> loaded{};	// the statistics it loaded
+};
+
+
+vector<string> read_lines(std::istream& in);
+void add_dependencies(vector<Line>& lines, const Calculator& calc);
+std::size_t keep_needed(vector<Line>& lines,
+	const vector<std::size_t>& outputs);
+bool is_blank(const string& text);
+int print_outputs(const vector<Line>& lines,
+	const vector<string>& outputs, const vector<std::size_t>& declared);
+void run_line(vector<Line>& lines, std::size_t i, Real prev,
+	const Running_stats& stats, Shared_session& session);
+Real prev_before(const vector<Line>& lines, std::size_t i, Real prev);
+Running_stats stats_before(const vector<Line>& lines, std::size_t i,
+	const Running_stats& stats);
+
+
+/**
+ * Run every line of a file as the REPL would, printing the same
+ * output, prompts included, or, given outputs, only the lines the
+ * declarations of those variables need, printing their values and
+ * then, to the standard error, how many statements were skipped.
+ * Return the exit code.
+ */
+int run_script(const string& path, Calculator& calc,
+		const vector<string>& outputs) {
+
+	std::ifstream file{ path, std::ios::binary };
+	if (!file) {
+		std::cerr << error << "can't read " << path << '\n';
+		return 1;
+	}
+
+	vector<Line> lines;
+	for (auto& text : read_lines(file)) {
+		if (text == quit) {
+			break;
+		}
+
+		lines.push_back(Line{ std::move(text) });
+	}
+
+	add_dependencies(lines, calc);
+
+	// the last declaration of each output
+	vector<std::size_t> declared;
+	for (const auto& name : outputs) {
+		auto d = std::find_if(lines.rbegin(), lines.rend(),
+			[&](const Line& l) { return l.name == name; });
+		if (d == lines.rend()) {
+			std::cerr << error << "no variable " << name <<
+				" is declared in " << path << '\n';
+			return 1;
+		}
+
+		if (!d->sets_prev) {
+			std::cerr << error << name << " is a function\n";
+			return 1;
+		}
+
+		declared.push_back(
+			static_cast<std::size_t>(lines.rend() - d) - 1);
+	}
+
+	auto to_run = lines.size();
+	std::size_t skipped = 0;
+	if (!outputs.empty()) {
+		skipped = keep_needed(lines, declared);
+		to_run = static_cast<std::size_t>(std::count_if(lines.begin(),
+			lines.end(), [](const Line& l) { return l.needed; }));
+	}
+
+	Shared_calculator shared{ calc };
+	auto prev = calc.previous();
+	auto stats = calc.statistics();
+
+	std::mutex m;
+	std::condition_variable changed;
+	std::deque<std::size_t> ready;
+	std::size_t finished = 0;
+
+	for (std::size_t i = 0; i < lines.size(); ++i) {
+		if (lines[i].needed && lines[i].waiting == 0) {
+			ready.push_back(i);
+		}
+	}
+
+	auto worker = [&]() {
+		Shared_session session{ shared };
+
+		std::unique_lock<std::mutex> lock{ m };
+		while (true) {
+			changed.wait(lock, [&]() {
+				return !ready.empty() || finished == to_run; });
+			if (ready.empty()) {
+				return;
+			}
+
+			auto i = ready.front();
+			ready.pop_front();
+
+			lock.unlock();
+			run_line(lines, i, prev, stats, session);
+			lock.lock();
+
+			++finished;
+			for (auto j : lines[i].before) {
+				if (lines[j].needed && --lines[j].waiting == 0) {
+					ready.push_back(j);
+				}
+			}
+
+			changed.notify_all();
+		}
+	};
+
+	auto workers = std::min(to_run, thread_count());
+
+	vector<std::thread> threads;
+	for (std::size_t i = 1; i < workers; ++i) {
+		threads.emplace_back(worker);
+	}
+
+	worker();
+
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	if (!outputs.empty()) {
+		auto code = print_outputs(lines, outputs, declared);
+
+		auto total = static_cast<std::size_t>(std::count_if(lines.begin(),
+			lines.end(), [](const Line& l) { return !is_blank(l.text); }));
+		std::cerr << "skipped " << skipped << " of " << total <<
+			" statements\n";
+		return code;
+	}
+
+	for (const auto& l : lines) {
+		std::cout << prompt;
+		print_chunks(l.output);
+	}
+
+	// the REPL prompts once more, before it finds quit or the end of
+	// the input
+	std::cout << prompt;
+
+	std::cout.flush();
+	return 0;
+}
+
+
+/**
+ * Split the input into lines the same way run_stream does.
+ */
+vector<string> read_lines(std::istream& in) {
+	string all{ std::istreambuf_iterator<char>{ in },
+		std::istreambuf_iterator<char>{} };
+
+	vector<string> lines;
+	std::size_t start = 0;
+	for (auto end = all.find('\n'); end != string::npos;
+			end = all.find('\n', start)) {
+		lines.push_back(all.substr(start, end - start));
+		start = end + 1;
+	}
+
+	if (start < all.size()) {
+		lines.push_back(all.substr(start));
+	}
+
+	return lines;
+}
+
+
+/**
+ * Work out what each line does, and which earlier lines it must run
+ * after, given the variables defined before the first.
+ */
+void add_dependencies(vector<Line>& lines, const Calculator& calc) {
+	// the last declaration of each name, and the lines using it since
+	std::map<string, std::size_t> declared;
+	std::map<string, vector<std::size_t>> users;
+
+	std::size_t last_reader = none;
+	vector<std::size_t> setters;		// lines setting `_` since then
+
+	std::size_t last_barrier = none;
+	std::size_t last_load = none;
+	vector<std::size_t> since_barrier;
+
+	for (std::size_t i = 0; i < lines.size(); ++i) {
+		auto& l = lines[i];
+
+		vector<Token> tokens;
+		try {
+			tokens = tokenize(l.text);
+		} catch (Calc_cli_exception&) {
+			// the line fails the same way whatever runs before it
+		}
+
+		// a variable named save or load makes the line an expression
+		auto saves = is_file_command(l.text, save,
+			declared.count(save) || calc.has_variable(save));
+		auto loads = is_file_command(l.text, load,
+			declared.count(load) || calc.has_variable(load));
+
+		auto& after = l.after;
+		auto& needs = l.needs;
+		if (l.text == memo || l.text == stats || l.text == profile) {
+			l.barrier = true;
+			after = since_barrier;
+		} else if (saves || loads) {
+			l.barrier = true;
+			after = since_barrier;
+
+			// save keeps `_`, and load replaces it
+			l.loads = loads;
+			l.reads_prev = !l.loads;
+			l.sets_prev = l.loads;
+			tokens.clear();
+		} else if (l.text == clear || l.text == help) {
+			tokens.clear();
+		} else if (l.text.rfind(gradient, 0) == 0) {
+			l.sets_prev = true;
+		} else if (!tokens.empty() && tokens[0].type == Token_type::let) {
+			l.declaration = true;
+
+			bool function = tokens.size() > 2 &&
+				tokens[2].type == Token_type::arg_delim_open;
+			l.sets_prev = !function;
+		} else if (!tokens.empty()) {
+			l.sets_prev = true;
+			l.counted = true;
+		}
+
+		if (last_barrier != none) {
+			after.push_back(last_barrier);
+		}
+
+		// the definitions after a load are those it loaded
+		if (last_load != none) {
+			needs.push_back(last_load);
+		}
+
+		// the declared name, if any, is the second token
+		string name;
+		if (l.declaration && tokens.size() > 1 &&
+				tokens[1].type == Token_type::variable) {
+			name = tokens[1].name;
+		}
+		l.name = name;
+
+		for (std::size_t t = 0; t < tokens.size(); ++t) {
+			if (tokens[t].type == Token_type::previous) {
+				l.reads_prev = true;
+			}
+
+			if (tokens[t].type != Token_type::variable ||
+					(t == 1 && !name.empty())) {
+				continue;
+			}
+
+			auto d = declared.find(tokens[t].name);
+			if (d != declared.end()) {
+				after.push_back(d->second);
+				needs.push_back(d->second);
+			}
+
+			users[tokens[t].name].push_back(i);
+		}
+
+		if (!name.empty()) {
+			auto d = declared.find(name);
+			if (d != declared.end()) {
+				after.push_back(d->second);
+				needs.push_back(d->second);
+			}
+
+			auto& u = users[name];
+			after.insert(after.end(), u.begin(), u.end());
+			u.clear();
+
+			declared[name] = i;
+		}
+
+		if (l.reads_prev) {
+			if (last_reader != none) {
+				after.push_back(last_reader);
+				needs.push_back(last_reader);
+			}
+
+			after.insert(after.end(), setters.begin(), setters.end());
+			needs.insert(needs.end(), setters.begin(), setters.end());
+
+			last_reader = i;
+			setters.clear();
+		}
+
+		if (l.sets_prev) {
+			setters.push_back(i);
+		}
+
+		if (l.barrier) {
+			last_barrier = i;
+			last_load = l.loads ? i : last_load;
+			since_barrier.clear();
+		} else {
+			since_barrier.push_back(i);
+		}
+
+		// a line never waits for itself, nor twice for the same line
+		for (auto v : { &after, &needs }) {
+			std::sort(v->begin(), v->end());
+			v->erase(std::unique(v->begin(), v->end()), v->end());
+			v->erase(std::remove(v->begin(), v->end(), i), v->end());
+		}
+
+		// what a barrier does depends on everything before it
+		if (l.barrier) {
+			needs = after;
+		}
+
+		l.waiting = after.size();
+		for (auto j : after) {
+			lines[j].before.push_back(i);
+		}
+	}
+}
+
+
+/**
+ * Mark as needed only the lines of outputs and those they need, and
+ * back, and make each needed line wait only for needed lines. Return
+ * how many statements, not counting blank lines, are skipped.
+ *
+ * Anything a needed line could see of a skipped one, it only needed to
+ * not overtake: a skipped line which sets `_` is never between a
+ * needed one which reads it and the last earlier line which reads it,
+ * which is needed too, and so is every line before a needed save or
+ * load.
+ */
+std::size_t keep_needed(vector<Line>& lines,
+		const vector<std::size_t>& outputs) {
+
+	for (auto& l : lines) {
+		l.needed = false;
+	}
+
+	auto pending = outputs;
+	while (!pending.empty()) {
+		auto i = pending.back();
+		pending.pop_back();
+		if (lines[i].needed) {
+			continue;
+		}
+
+		lines[i].needed = true;
+		pending.insert(pending.end(), lines[i].needs.begin(),
+			lines[i].needs.end());
+	}
+
+	std::size_t skipped = 0;
+	for (auto& l : lines) {
+		l.waiting = static_cast<std::size_t>(std::count_if(
+			l.after.begin(), l.after.end(),
+			[&](std::size_t j) { return lines[j].needed; }));
+		skipped += !l.needed && !is_blank(l.text);
+	}
+
+	return skipped;
+}
+
+
+/**
+ * Return whether a line has nothing but spaces, so isn't a statement.
+ */
+bool is_blank(const string& text) {
+	return text.find_first_not_of(" \t\r") == string::npos;
+}
+
+
+/**
+ * Print each output as its name, then what its declaration printed,
+ * such as "x = 2". A variable declared more than once keeps its first
+ * value, which the later declarations fail to replace; if every one
+ * failed, the last one's error is printed. Return the exit code: 1 if
+ * any output has no value.
+ */
+int print_outputs(const vector<Line>& lines,
+		const vector<string>& outputs, const vector<std::size_t>& declared) {
+
+	auto code = 0;
+	for (std::size_t k = 0; k < outputs.size(); ++k) {
+		auto shown = declared[k];
+		for (std::size_t i = 0; i < declared[k]; ++i) {
+			if (lines[i].name == outputs[k] && lines[i].sets_prev &&
+					lines[i].succeeded) {
+				shown = i;
+				break;
+			}
+		}
+
+		std::cout << outputs[k] << ' ';
+		print_chunks(lines[shown].output);
+		code = lines[shown].succeeded ? code : 1;
+	}
+
+	std::cout.flush();
+	return code;
+}
+
+
+/**
+ * Return the value of `_` just before line i, which reads it: the
+ * value of the last line before it which set `_`, not counting those
+ * whose value was a vector. Each line which can set it is done by now,
+ * back to the previous line which read it, and knows what `_` was.
+ * prev is `_` before the first line.
+ */
+Real prev_before(const vector<Line>& lines, std::size_t i, Real prev) {
+	for (auto j = i; j > 0; ) {
+		const auto& l = lines[--j];
+		if (l.sets_prev && l.succeeded && !l.is_vector) {
+			return l.value;
+		}
+
+		if (l.reads_prev) {
+			return l.prev_in;
+		}
+	}
+
+	return prev;
+}
+
+
+/**
+ * Return the statistics just before line i, which depends on every
+ * line before it: those of the last session loaded before it, or
+ * stats, with the value of every line counted since added.
+ */
+Running_stats stats_before(const vector<Line>& lines, std::size_t i,
+		const Running_stats& stats) {
+
+	auto first = i;
+	while (first > 0 && !lines[first - 1].loaded) {
+		--first;
+	}
+
+	auto all = (first > 0) ? *lines[first - 1].loaded : stats;
+	for (auto j = first; j < i; ++j) {
+		if (lines[j].counted && lines[j].succeeded) {
+			all.add(lines[j].value);
+		}
+	}
+
+	return all;
+}
+
+
+/**
+ * Run line i, capturing its output. prev and stats are as they were
+ * before the first line.
+ */
+void run_line(vector<Line>& lines, std::size_t i, Real prev,
+		const Running_stats& stats, Shared_session& session) {
+
+	auto& l = lines[i];
+
+	if (l.reads_prev) {
+		prev = prev_before(lines, i, prev);
+	}
+	l.prev_in = prev;
+
+	Chunk_buf out_buf{ l.output, false };
+	Chunk_buf err_buf{ l.output, true };
+	std::ostream out{ &out_buf };
+	std::ostream err{ &err_buf };
+
+	if (l.declaration) {
+		// the same output as calculate, which shows answer first
+		try {
+			out << answer;
+			session.calculator().set_previous(prev);
+			l.value = session.evaluate(l.text);
+			l.succeeded = true;
+			l.is_vector = (session.calculator().vector_result() != nullptr);
+			display_value(l.value, session.calculator(), out);
+		} catch (Calc_cli_exception& e) {
+			err << error << e.what();
+		}
+
+		out << "\n";
+		return;
+	}
+
+	if (l.text == ::stats) {
+		display_stats(stats_before(lines, i, stats), out);
+		return;
+	}
+
+	if (l.loads) {
+		try {
+			session.load(file_name(l.text));
+
+			auto& calc = session.calculator();
+			l.value = calc.previous();
+			l.loaded = std::make_unique<Running_stats>(calc.statistics());
+			l.succeeded = true;
+		} catch (Calc_cli_exception& e) {
+			err << error << e.what() << '\n';
+		}
+
+		return;
+	}
+
+	auto& calc = session.calculator();
+	calc.set_previous(prev);
+	if (l.barrier) {
+		calc.set_statistics(stats_before(lines, i, stats));
+	}
+	respond(l.text, calc, out, err);
+
+	// a vector isn't counted, and doesn't set `_`, which is only known
+	// once it has run
+	l.value = calc.previous();
+	l.is_vector = l.counted && calc.vector_result();
+	l.counted = l.counted && !l.is_vector;
+	l.succeeded = std::none_of(l.output.begin(), l.output.end(),
+		[](const Chunk& c) { return c.error; });
+}
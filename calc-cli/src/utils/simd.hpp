@@ -0,0 +1,362 @@
+#pragma once
+#ifndef CALC_CLI_SIMD_HPP
+#define CALC_CLI_SIMD_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * simd.hpp defines Vec, several doubles processed together, along
+ * with the operations the fast functions in batch_funcs.cpp need.
+ * Each operation is also defined for plain doubles, so the same code
+ * computes one value or a Vec of them.
+ *
+ * A Vec holds four doubles when compiling for AVX2 (/arch:AVX2,
+ * -mavx2), and otherwise two, using SSE2, which every x64 processor
+ * has. Without either, CALC_CLI_SIMD isn't defined and only the
+ * double versions exist.
+ *
+ * CALC_CLI_FMA is defined when the processor has a fused multiply-add
+ * (-mfma, or /arch:AVX2, since every AVX2 processor has one), which
+ * then takes no longer than a multiply.
+ */
+
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#define CALC_CLI_SIMD
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CALC_CLI_SIMD
+#include <emmintrin.h>
+#endif
+
+#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define CALC_CLI_FMA
+#include <immintrin.h>
+#endif
+
+
+inline std::uint64_t to_bits(double x) {
+	std::uint64_t b;
+	std::memcpy(&b, &x, sizeof(b));
+
+	return b;
+}
+
+inline double from_bits(std::uint64_t b) {
+	double x;
+	std::memcpy(&x, &b, sizeof(x));
+
+	return x;
+}
+
+inline double select(bool condition, double a, double b) {
+	return condition ? a : b;
+}
+
+inline bool is_odd(std::uint64_t b) {
+	return (b & 1) != 0;
+}
+
+// a * b + c, rounded once if CALC_CLI_FMA is defined; otherwise
+// std::fma would be computed in software, so it is rounded twice
+inline double multiply_add(double a, double b, double c) {
+#ifdef CALC_CLI_FMA
+	return std::fma(a, b, c);
+#else
+	return a * b + c;
+#endif
+}
+
+
+#if defined(CALC_CLI_SIMD) && defined(__AVX2__)
+
+// the result of comparing two Vecs: all bits set in each lane where
+// the comparison holds
+struct Mask {
+	__m256d m;
+};
+
+// the bits of a Vec's doubles, as 64-bit integers
+struct Bits {
+	__m256i b;
+};
+
+struct Vec {
+	static constexpr std::size_t lanes = 4;
+
+	__m256d v;
+
+	Vec() :v{ _mm256_setzero_pd() } {
+	}
+
+	Vec(double x) :v{ _mm256_set1_pd(x) } {
+	}
+
+	explicit Vec(__m256d x) :v{ x } {
+	}
+
+	static Vec load(const double* p) {
+		return Vec{ _mm256_loadu_pd(p) };
+	}
+
+	void store(double* p) const {
+		_mm256_storeu_pd(p, v);
+	}
+};
+
+
+inline Vec operator+(Vec a, Vec b) { return Vec{ _mm256_add_pd(a.v, b.v) }; }
+inline Vec operator-(Vec a, Vec b) { return Vec{ _mm256_sub_pd(a.v, b.v) }; }
+inline Vec operator*(Vec a, Vec b) { return Vec{ _mm256_mul_pd(a.v, b.v) }; }
+inline Vec operator/(Vec a, Vec b) { return Vec{ _mm256_div_pd(a.v, b.v) }; }
+
+inline Vec operator-(Vec a) {
+	return Vec{ _mm256_xor_pd(a.v, _mm256_set1_pd(-0.0)) };
+}
+
+inline Vec& operator*=(Vec& a, Vec b) {
+	return a = a * b;
+}
+
+inline Vec multiply_add(Vec a, Vec b, Vec c) {
+#ifdef CALC_CLI_FMA
+	return Vec{ _mm256_fmadd_pd(a.v, b.v, c.v) };
+#else
+	return a * b + c;
+#endif
+}
+
+inline Mask operator<(Vec a, Vec b) {
+	return Mask{ _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ) };
+}
+
+inline Mask operator<=(Vec a, Vec b) {
+	return Mask{ _mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ) };
+}
+
+inline Mask operator>(Vec a, Vec b) {
+	return Mask{ _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ) };
+}
+
+inline Mask operator>=(Vec a, Vec b) {
+	return Mask{ _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ) };
+}
+
+inline Mask operator==(Vec a, Vec b) {
+	return Mask{ _mm256_cmp_pd(a.v, b.v, _CMP_EQ_OQ) };
+}
+
+inline Mask operator&&(Mask a, Mask b) {
+	return Mask{ _mm256_and_pd(a.m, b.m) };
+}
+
+inline Mask operator!(Mask a) {
+	return Mask{ _mm256_xor_pd(a.m,
+		_mm256_castsi256_pd(_mm256_set1_epi32(-1))) };
+}
+
+inline Vec select(Mask condition, Vec a, Vec b) {
+	return Vec{ _mm256_blendv_pd(b.v, a.v, condition.m) };
+}
+
+inline Vec sqrt(Vec a) {
+	return Vec{ _mm256_sqrt_pd(a.v) };
+}
+
+inline Vec fabs(Vec a) {
+	return Vec{ _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v) };
+}
+
+inline Vec copysign(Vec magnitude, Vec sign) {
+	auto s = _mm256_set1_pd(-0.0);
+	return Vec{ _mm256_or_pd(_mm256_andnot_pd(s, magnitude.v),
+		_mm256_and_pd(s, sign.v)) };
+}
+
+
+inline Bits to_bits(Vec x) {
+	return Bits{ _mm256_castpd_si256(x.v) };
+}
+
+inline Vec from_bits(Bits b) {
+	return Vec{ _mm256_castsi256_pd(b.b) };
+}
+
+inline Bits operator+(Bits a, std::uint64_t b) {
+	return Bits{ _mm256_add_epi64(a.b,
+		_mm256_set1_epi64x(static_cast<long long>(b))) };
+}
+
+inline Bits operator&(Bits a, std::uint64_t b) {
+	return Bits{ _mm256_and_si256(a.b,
+		_mm256_set1_epi64x(static_cast<long long>(b))) };
+}
+
+inline Bits operator|(Bits a, std::uint64_t b) {
+	return Bits{ _mm256_or_si256(a.b,
+		_mm256_set1_epi64x(static_cast<long long>(b))) };
+}
+
+inline Bits operator^(Bits a, Bits b) {
+	return Bits{ _mm256_xor_si256(a.b, b.b) };
+}
+
+inline Bits operator<<(Bits a, int n) {
+	return Bits{ _mm256_slli_epi64(a.b, n) };
+}
+
+inline Bits operator>>(Bits a, int n) {
+	return Bits{ _mm256_srli_epi64(a.b, n) };
+}
+
+inline Mask is_odd(Bits a) {
+	auto one = _mm256_set1_epi64x(1);
+	return Mask{ _mm256_castsi256_pd(
+		_mm256_cmpeq_epi64(_mm256_and_si256(a.b, one), one)) };
+}
+
+#elif defined(CALC_CLI_SIMD)
+
+// the result of comparing two Vecs: all bits set in each lane where
+// the comparison holds
+struct Mask {
+	__m128d m;
+};
+
+// the bits of a Vec's doubles, as 64-bit integers
+struct Bits {
+	__m128i b;
+};
+
+struct Vec {
+	static constexpr std::size_t lanes = 2;
+
+	__m128d v;
+
+	Vec() :v{ _mm_setzero_pd() } {
+	}
+
+	Vec(double x) :v{ _mm_set1_pd(x) } {
+	}
+
+	explicit Vec(__m128d x) :v{ x } {
+	}
+
+	static Vec load(const double* p) {
+		return Vec{ _mm_loadu_pd(p) };
+	}
+
+	void store(double* p) const {
+		_mm_storeu_pd(p, v);
+	}
+};
+
+
+inline Vec operator+(Vec a, Vec b) { return Vec{ _mm_add_pd(a.v, b.v) }; }
+inline Vec operator-(Vec a, Vec b) { return Vec{ _mm_sub_pd(a.v, b.v) }; }
+inline Vec operator*(Vec a, Vec b) { return Vec{ _mm_mul_pd(a.v, b.v) }; }
+inline Vec operator/(Vec a, Vec b) { return Vec{ _mm_div_pd(a.v, b.v) }; }
+
+inline Vec operator-(Vec a) {
+	return Vec{ _mm_xor_pd(a.v, _mm_set1_pd(-0.0)) };
+}
+
+inline Vec& operator*=(Vec& a, Vec b) {
+	return a = a * b;
+}
+
+inline Vec multiply_add(Vec a, Vec b, Vec c) {
+#ifdef CALC_CLI_FMA
+	return Vec{ _mm_fmadd_pd(a.v, b.v, c.v) };
+#else
+	return a * b + c;
+#endif
+}
+
+inline Mask operator<(Vec a, Vec b) { return Mask{ _mm_cmplt_pd(a.v, b.v) }; }
+inline Mask operator<=(Vec a, Vec b) { return Mask{ _mm_cmple_pd(a.v, b.v) }; }
+inline Mask operator>(Vec a, Vec b) { return Mask{ _mm_cmpgt_pd(a.v, b.v) }; }
+inline Mask operator>=(Vec a, Vec b) { return Mask{ _mm_cmpge_pd(a.v, b.v) }; }
+inline Mask operator==(Vec a, Vec b) { return Mask{ _mm_cmpeq_pd(a.v, b.v) }; }
+
+inline Mask operator&&(Mask a, Mask b) { return Mask{ _mm_and_pd(a.m, b.m) }; }
+
+inline Mask operator!(Mask a) {
+	return Mask{ _mm_xor_pd(a.m, _mm_castsi128_pd(_mm_set1_epi32(-1))) };
+}
+
+inline Vec select(Mask condition, Vec a, Vec b) {
+	return Vec{ _mm_or_pd(_mm_and_pd(condition.m, a.v),
+		_mm_andnot_pd(condition.m, b.v)) };
+}
+
+inline Vec sqrt(Vec a) {
+	return Vec{ _mm_sqrt_pd(a.v) };
+}
+
+inline Vec fabs(Vec a) {
+	return Vec{ _mm_andnot_pd(_mm_set1_pd(-0.0), a.v) };
+}
+
+inline Vec copysign(Vec magnitude, Vec sign) {
+	auto s = _mm_set1_pd(-0.0);
+	return Vec{ _mm_or_pd(_mm_andnot_pd(s, magnitude.v),
+		_mm_and_pd(s, sign.v)) };
+}
+
+
+inline Bits to_bits(Vec x) {
+	return Bits{ _mm_castpd_si128(x.v) };
+}
+
+inline Vec from_bits(Bits b) {
+	return Vec{ _mm_castsi128_pd(b.b) };
+}
+
+inline Bits operator+(Bits a, std::uint64_t b) {
+	return Bits{ _mm_add_epi64(a.b,
+		_mm_set1_epi64x(static_cast<long long>(b))) };
+}
+
+inline Bits operator&(Bits a, std::uint64_t b) {
+	return Bits{ _mm_and_si128(a.b,
+		_mm_set1_epi64x(static_cast<long long>(b))) };
+}
+
+inline Bits operator|(Bits a, std::uint64_t b) {
+	return Bits{ _mm_or_si128(a.b,
+		_mm_set1_epi64x(static_cast<long long>(b))) };
+}
+
+inline Bits operator^(Bits a, Bits b) {
+	return Bits{ _mm_xor_si128(a.b, b.b) };
+}
+
+inline Bits operator<<(Bits a, int n) {
+	return Bits{ _mm_slli_epi64(a.b, n) };
+}
+
+inline Bits operator>>(Bits a, int n) {
+	return Bits{ _mm_srli_epi64(a.b, n) };
+}
+
+inline Mask is_odd(Bits a) {
+	// SSE2 has no 64-bit comparison: compare the low halves, and copy
+	// each result over its whole lane
+	auto low = _mm_cmpeq_epi32(_mm_and_si128(a.b, _mm_set1_epi64x(1)),
+		_mm_set1_epi64x(1));
+	return Mask{ _mm_castsi128_pd(
+		_mm_shuffle_epi32(low, _MM_SHUFFLE(2, 2, 0, 0))) };
+}
+
+#endif // CALC_CLI_SIMD
+
+
+#endif // !CALC_CLI_SIMD_HPP
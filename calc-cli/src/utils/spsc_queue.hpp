@@ -0,0 +1,117 @@
+#pragma once
+#ifndef CALC_CLI_SPSC_QUEUE_HPP
+#define CALC_CLI_SPSC_QUEUE_HPP
+
+
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * spsc_queue.hpp defines Spsc_queue, a bounded lock-free queue for
+ * exactly one producer thread and one consumer thread. A side which
+ * has to wait for the other spins briefly, then blocks on a condition
+ * variable rather than polling.
+ */
+
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <condition_variable>
+
+
+template <typename T, std::size_t N>
+class Spsc_queue {
+public:
+	/**
+	 * Add an item, waiting while the queue is full. Only the
+	 * producer may call this.
+	 */
+	void push(T item) {
+		auto t = tail.load(std::memory_order_relaxed);
+		wait_until([this, t]() {
+			return t - head.load(std::memory_order_acquire) != N; });
+
+		slots[t % N] = std::move(item);
+		tail.store(t + 1, std::memory_order_release);
+		wake();
+	}
+
+	/**
+	 * Remove the oldest item, waiting while the queue is empty. Only
+	 * the consumer may call this.
+	 */
+	T pop() {
+		auto h = head.load(std::memory_order_relaxed);
+		wait_until([this, h]() {
+			return tail.load(std::memory_order_acquire) != h; });
+
+		T item = std::move(slots[h % N]);
+		head.store(h + 1, std::memory_order_release);
+		wake();
+
+		return item;
+	}
+
+private:
+	// times a side yields before it blocks
+	static constexpr int spins = 64;
+
+	std::array<T, N> slots;
+
+	// head and tail only ever grow; each is written by one side only,
+	// and they are kept on separate cache lines
+	alignas(64) std::atomic<std::size_t> head{ 0 };	// next to pop
+	alignas(64) std::atomic<std::size_t> tail{ 0 };	// next to push
+
+	// a side which has run out of spins blocks on changed, counted in
+	// sleepers, so that the other only takes the lock to wake it
+	alignas(64) std::atomic<int> sleepers{ 0 };
+	std::mutex m;
+	std::condition_variable changed;
+
+	/**
+	 * Wait until the other side has caught up: yield at first, then
+	 * block, so that a slow input doesn't keep a core busy.
+	 */
+	template <typename Ready>
+	void wait_until(Ready ready) {
+		for (int tries = 0; tries < spins; ++tries) {
+			if (ready()) {
+				return;
+			}
+			std::this_thread::yield();
+		}
+
+		std::unique_lock<std::mutex> lock{ m };
+		sleepers.fetch_add(1, std::memory_order_relaxed);
+
+		// pairs with the fence in wake: either this sees what the other
+		// side stored, or it sees this side sleeping
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		changed.wait(lock, ready);
+		sleepers.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Wake the other side, if it is blocked, after storing head or
+	 * tail.
+	 */
+	void wake() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleepers.load(std::memory_order_relaxed) == 0) {
+			return;
+		}
+
+		// once this has the lock, the sleeper is waiting on changed
+		// or hasn't checked ready yet
+		{
+			std::lock_guard<std::mutex> lock{ m };
+		}
+		changed.notify_all();
+	}
+};
+
+
+#endif // !CALC_CLI_SPSC_QUEUE_HPP
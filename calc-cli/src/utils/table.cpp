@@ -0,0 +1,514 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * table.cpp defines run_csv and run_binary from utils.hpp, which
+ * evaluate one compiled expression for every row of a table, with
+ * the table's columns as variables.
+ *
+ * The file is memory-mapped. A binary table is used in place, without
+ * copying; a CSV file is split into chunks at line ends, and the
+ * chunks are parsed with std::from_chars. Either way, chunks are
+ * parsed, evaluated and formatted on as many threads as there are
+ * processors, and each is written out, or summarized, and freed as soon
+ * as those before it have been. Only a few chunks are started ahead of
+ * the first one not yet written, so however large the table, only
+ * those few are held at once.
+ */
+
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <thread>
+#include <condition_variable>
+#include <charconv>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include "utils.hpp"
+#include "mapped_file.hpp"
+#include "calc_consts.hpp"
+#include "../calculator/pool/pool.hpp"
+#include "../calculator/limits/limits.hpp"
+#include "../calculator/profile/profile.hpp"
+#include "../calculator/exceptions/exceptions.hpp"
+
+
+using std::string;
+using std::vector;
+
+
+// a binary table is processed this many rows at a time
+constexpr std::size_t chunk_rows = 1 << 14;
+
+// a CSV file is split into chunks of about this many bytes
+constexpr std::size_t chunk_bytes = 1 << 20;
+
+// at most this many chunks per thread are started ahead of the first
+// one not yet written
+constexpr std::size_t chunks_ahead = 2;
+
+
+// what became of one chunk of a table
+struct Chunk_result {
+	vector<Real> rows;			// parsed values, when they aren't used
+								// in place
+	std::size_t count = 0;		// number of rows
+	string bad_row;				// why the row after them couldn't be
+								// parsed
+	string output;
+
+	// rows which failed to evaluate, and why
+	vector<std::pair<std::size_t, string>> errors;
+};
+
+
+// what has been written of a table so far
+struct Table_written {
+	Table_output output;
+	std::size_t rows = 0;
+	Running_stats stats;	// the results, for a summary
+};
+
+
+const char* after_line(const char* end, const char* last);
+bool parse_csv(const char* first, const char* last, std::size_t width,
+	Chunk_result& chunk);
+void evaluate_rows(const Node& exp, Real prev, const Real* rows,
+	std::size_t width, Chunk_result& chunk, bool raw_output);
+template <typename Work, typename Finish>
+void for_each_chunk(std::size_t count, Work work, Finish finish);
+Table_written start_writing(Table_output output);
+void write_chunk(const Chunk_result& chunk, Table_written& written);
+int finish_writing(const Table_written& written);
+
+
+/**
+ * Evaluate an expression for every row of a CSV file. The first line
+ * names the columns. Return the exit code.
+ */
+int run_csv(const string& path, const string& expression,
+		Calculator& calc, Table_output output) {
+
+	Mapped_file file{ path };
+	if (!file) {
+		std::cerr << error << "can't read " << path << '\n';
+		return 1;
+	}
+
+	auto first = file.data();
+	auto last = first + file.size();
+
+	auto header_end = std::find(first, last, '\n');
+	auto names = split_names(string(first, header_end));
+
+	Node exp;
+	try {
+		exp = calc.compile(expression, names);
+	} catch (Calc_cli_exception& e) {
+		std::cerr << error << e.what() << '\n';
+		return 1;
+	}
+
+	// chunks end just after a line end, or at the end of the file
+	vector<const char*> bounds{ after_line(header_end, last) };
+	while (bounds.back() != last) {
+		auto next = bounds.back() + std::min<std::size_t>(chunk_bytes,
+			last - bounds.back());
+		bounds.push_back(after_line(std::find(next, last, '\n'), last));
+	}
+
+	vector<Chunk_result> chunks(bounds.size() - 1);
+	auto prev = calc.previous();
+	auto written = start_writing(output);
+	bool bad = false;
+
+	for_each_chunk(chunks.size(), [&](std::size_t i) {
+		// the rows before one which can't be parsed are still written
+		auto& c = chunks[i];
+		parse_csv(bounds[i], bounds[i + 1], names.size(), c);
+		evaluate_rows(exp, prev, c.rows.data(), names.size(), c,
+			output != Table_output::text);
+
+		vector<Real>().swap(c.rows);
+	}, [&](std::size_t i) {
+		// moved out, so that it is freed once written
+		auto c = std::move(chunks[i]);
+		write_chunk(c, written);
+
+		if (!c.bad_row.empty()) {
+			std::fflush(stdout);
+			std::cerr << error << "row " << written.rows + 1 << ": "
+				<< c.bad_row << '\n';
+			bad = true;
+			return false;
+		}
+
+		return true;
+	});
+
+	return bad ? 1 : finish_writing(written);
+}
+
+
+/**
+ * Evaluate an expression for every row of a file of raw Reals in the
+ * machine's byte order, one row after the other. names, separated by
+ * commas, gives the columns. Return the exit code.
+ */
+int run_binary(const string& path, const string& names,
+		const string& expression, Calculator& calc, Table_output output) {
+
+	auto columns = split_names(names);
+
+	Node exp;
+	try {
+		exp = calc.compile(expression, columns);
+	} catch (Calc_cli_exception& e) {
+		std::cerr << error << e.what() << '\n';
+		return 1;
+	}
+
+	Mapped_file file{ path };
+	if (!file) {
+		std::cerr << error << "can't read " << path << '\n';
+		return 1;
+	}
+
+	auto row_size = columns.size() * sizeof(Real);
+	if (file.size() % row_size != 0) {
+		std::cerr << error << path << " doesn't hold whole rows of "
+			<< columns.size() << " numbers\n";
+		return 1;
+	}
+
+	// mapped memory starts at a page boundary, so it is aligned
+	auto rows = reinterpret_cast<const Real*>(file.data());
+	auto count = file.size() / row_size;
+
+	vector<Chunk_result> chunks((count + chunk_rows - 1) / chunk_rows);
+	auto prev = calc.previous();
+	auto written = start_writing(output);
+
+	for_each_chunk(chunks.size(), [&](std::size_t i) {
+		auto& c = chunks[i];
+		c.count = std::min(chunk_rows, count - i * chunk_rows);
+
+		evaluate_rows(exp, prev, rows + i * chunk_rows * columns.size(),
+			columns.size(), c, output != Table_output::text);
+	}, [&](std::size_t i) {
+		auto c = std::move(chunks[i]);
+		write_chunk(c, written);
+		return true;
+	});
+
+	return finish_writing(written);
+}
+
+
+/**
+ * Split a list of names separated by commas, dropping spaces around
+ * each name.
+ */
+vector<string> split_names(const string& names) {
+	vector<string> split;
+
+	std::size_t start = 0;
+	while (true) {
+		auto end = names.find(',', start);
+		auto name = names.substr(start, end - start);
+
+		name.erase(0, name.find_first_not_of(" \t"));
+		name.erase(name.find_last_not_of(" \t\r") + 1);
+		split.push_back(name);
+
+		if (end == string::npos) {
+			return split;
+		}
+
+		start = end + 1;
+	}
+}
+
+
+/**
+ * Return where the line ending at end (a newline, or last) is
+ * followed by the next one.
+ */
+const char* after_line(const char* end, const char* last) {
+	return (end == last) ? last : end + 1;
+}
+
+
+/**
+ * Parse the lines of a CSV file between first and last, each of which
+ * must hold width numbers, into chunk.rows. Empty lines are skipped.
+ * Return false, with the reason in chunk.bad_row, if a line doesn't
+ * fit; chunk.count rows before it have been parsed.
+ */
+bool parse_csv(const char* first, const char* last, std::size_t width,
+		Chunk_result& chunk) {
+
+	auto is_space = [](char c) { return c == ' ' || c == '\t'; };
+
+	for (auto line = first; line < last; ) {
+		auto end = std::find(line, last, '\n');
+		auto next = after_line(end, last);
+		if (end > line && end[-1] == '\r') {
+			--end;
+		}
+
+		auto p = std::find_if_not(line, end, is_space);
+		if (p == end) {
+			line = next;
+			continue;
+		}
+
+		for (std::size_t col = 0; col < width; ++col) {
+			p = std::find_if_not(p, end, is_space);
+
+			Real value;
+			auto parsed = std::from_chars(p, end, value);
+			if (parsed.ec != std::errc{}) {
+				chunk.bad_row = "not a valid number";
+				return false;
+			}
+
+			// a comma must follow every number but the last
+			p = std::find_if_not(parsed.ptr, end, is_space);
+			bool last_col = (col + 1 == width);
+			if (last_col ? (p != end) : (p == end || *p != ',')) {
+				chunk.bad_row = "expected " + std::to_string(width) +
+					" numbers separated by commas";
+				return false;
+			}
+
+			if (!last_col) {
+				++p;
+			}
+
+			chunk.rows.push_back(value);
+		}
+
+		++chunk.count;
+		line = next;
+	}
+
+	return true;
+}
+
+
+/**
+ * Evaluate exp for chunk.count rows of width values each, starting
+ * at rows, and format the results into chunk.output: as text, one
+ * line per row, or as raw Reals. A row whose evaluation fails gives
+ * NaN, and is listed in chunk.errors.
+ *
+ * If exp can be evaluated a block at a time, the rows are taken a
+ * block at a time, with each column copied out, so that batch
+ * functions see a whole column at once. A block which fails is
+ * evaluated again a row at a time, to find the rows to blame. Each row
+ * evaluated on its own is limited as one input is.
+ */
+void evaluate_rows(const Node& exp, Real prev, const Real* rows,
+		std::size_t width, Chunk_result& chunk, bool raw_output) {
+
+	Profile_recording profile;
+	Frame frame{ prev, vector<Real>(std::max(width, frame_size(exp))) };
+
+	auto depth = block_depth(exp);
+	vector<Real> buffer(depth > 0 ? (width + depth + 1) * block_size : 0);
+	vector<const Real*> columns(frame.locals.size());
+	for (std::size_t c = 0; c < width && depth > 0; ++c) {
+		columns[c] = buffer.data() + c * block_size;
+	}
+	auto out = buffer.data() + width * block_size;
+
+	if (raw_output) {
+		chunk.output.reserve(chunk.count * sizeof(Real));
+	}
+
+	auto evaluate_row = [&](std::size_t r) {
+		std::copy(rows + r * width, rows + (r + 1) * width,
+			frame.locals.begin());
+
+		try {
+			Evaluation_budget bounded;
+			return evaluate(exp, frame);
+		} catch (Calc_cli_exception& e) {
+			chunk.errors.emplace_back(r, e.what());
+			return std::numeric_limits<Real>::quiet_NaN();
+		}
+	};
+
+	for (std::size_t first = 0; first < chunk.count; ) {
+		auto count = depth > 0
+			? std::min(block_size, chunk.count - first) : 1;
+
+		bool whole = false;
+		if (depth > 0) {
+			for (std::size_t i = 0; i < count; ++i) {
+				for (std::size_t c = 0; c < width; ++c) {
+					buffer[c * block_size + i] = rows[(first + i) * width + c];
+				}
+			}
+
+			try {
+				evaluate_block(exp, frame, columns.data(), count, out,
+					out + block_size);
+				whole = true;
+			} catch (Calc_cli_exception&) {
+			}
+		}
+
+		for (std::size_t i = 0; i < count; ++i) {
+			auto result = whole ? out[i] : evaluate_row(first + i);
+			if (raw_output) {
+				chunk.output.append(
+					reinterpret_cast<const char*>(&result), sizeof(Real));
+				continue;
+			}
+
+			// the same format as printing to a stream with the default
+			// precision
+			char text[64];
+			auto written = std::to_chars(text, text + sizeof(text),
+				result, std::chars_format::general, 6);
+			chunk.output.append(text, written.ptr);
+			chunk.output += '\n';
+		}
+
+		first += count;
+	}
+}
+
+
+/**
+ * Call work(i) for every i in [0, count), spread over thread_count()
+ * threads, and then finish(i) for each i in order, as soon as work is
+ * done with it and with those before it; finish is called on one
+ * thread at a time. Only chunks_ahead chunks per thread are started
+ * ahead of the first one not yet finished. Once finish returns false,
+ * no more are started, nor finished.
+ */
+template <typename Work, typename Finish>
+void for_each_chunk(std::size_t count, Work work, Finish finish) {
+	auto workers = std::min(count, thread_count());
+	auto ahead = workers * chunks_ahead;
+
+	std::mutex m;
+	std::condition_variable changed;
+	std::size_t next = 0;			// the next chunk to start
+	std::size_t finished = 0;		// chunks finished, in order
+	vector<char> done(count);
+	bool finishing = false;			// a thread is calling finish
+	bool stopped = false;
+
+	auto worker = [&]() {
+		std::unique_lock<std::mutex> lock{ m };
+		while (true) {
+			changed.wait(lock, [&]() {
+				return stopped || next == count || next < finished + ahead;
+			});
+			if (stopped || next == count) {
+				return;
+			}
+
+			auto i = next++;
+			lock.unlock();
+			work(i);
+			lock.lock();
+			done[i] = true;
+
+			// whichever thread finds the next chunk to finish done
+			// finishes it, and any done after it
+			while (!finishing && !stopped && finished < count &&
+					done[finished]) {
+				finishing = true;
+				lock.unlock();
+				auto more = finish(finished);
+				lock.lock();
+
+				finishing = false;
+				stopped = !more;
+				++finished;
+				changed.notify_all();
+			}
+		}
+	};
+
+	vector<std::thread> threads;
+	for (std::size_t i = 1; i < workers; ++i) {
+		threads.emplace_back(worker);
+	}
+
+	worker();
+
+	for (auto& t : threads) {
+		t.join();
+	}
+}
+
+
+/**
+ * Get the standard output ready for a table's results, and return
+ * what has been written of it: nothing yet.
+ */
+Table_written start_writing(Table_output output) {
+#ifdef _WIN32
+	if (output == Table_output::raw) {
+		_setmode(_fileno(stdout), _O_BINARY);
+	}
+#endif
+
+	Table_written written;
+	written.output = output;
+	return written;
+}
+
+
+/**
+ * Write the output of a chunk to the standard output, or for a
+ * summary, add its results, which it holds as raw Reals, to the
+ * summary. Write the rows which failed to the standard error.
+ */
+void write_chunk(const Chunk_result& c, Table_written& written) {
+	if (written.output != Table_output::summary) {
+		std::fwrite(c.output.data(), 1, c.output.size(), stdout);
+	} else {
+		for (std::size_t i = 0; i < c.output.size(); i += sizeof(Real)) {
+			Real result;
+			std::memcpy(&result, c.output.data() + i, sizeof(Real));
+			written.stats.add(result);
+		}
+	}
+
+	for (const auto& e : c.errors) {
+		std::cerr << error << "row " << written.rows + e.first + 1 << ": "
+			<< e.second << '\n';
+	}
+
+	written.rows += c.count;
+}
+
+
+/**
+ * Write the summary, if that is the output, once every chunk has been
+ * written. Return the exit code.
+ */
+int finish_writing(const Table_written& written) {
+	if (written.output == Table_output::summary) {
+		display_stats(written.stats);
+	}
+
+	std::fflush(stdout);
+	return 0;
+}
@@ -8,17 +8,24 @@
 #include <map>
 #include <string>
 #include <cmath>
+#include <iomanip>
 #include <iostream>
 #include <vector>
+#include <cstdio>
 
 #ifdef _WIN32
 #include <Windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
 #endif
 
 #include "utils.hpp"
 #include "consts.hpp"
 #include "calc_consts.hpp"
 #include "calc_funcs.hpp"
+#include "memo.hpp"
+#include "../calculator/profile/profile.hpp"
 #include "../calculator/exceptions/exceptions.hpp"
 
 
@@ -27,7 +34,7 @@
  *
  * Taken from: https://stackoverflow.com/questions/5866529/how-do-we-clear-the-console-in-assembly/5866648#5866648
  */
-void clrscr() {
+void clrscr(std::ostream& out) {
 #ifdef _WIN32
 	COORD tl = { 0,0 };
 	CONSOLE_SCREEN_BUFFER_INFO s;
@@ -38,17 +45,138 @@ void clrscr() {
 	FillConsoleOutputAttribute(console, s.wAttributes, cells, tl, &written);
 	SetConsoleCursorPosition(console, tl);
 #else
-	std::cout << "\033[2J\033[1; 1H";
+	out << "\033[2J\033[1; 1H";
 #endif
 }
 
 
 /**
- * Display instructions on how to use calc-cli to the standard
- * output.
+ * Display instructions on how to use calc-cli.
+ */
+void display_help(std::ostream& out) {
+	out << "For help, see: " << README_URL << '\n';
+}
+
+
+/**
+ * Display how often each memoized function's cache had the result.
+ */
+void display_memo_stats(std::ostream& out) {
+	auto stats = memo_stats();
+	if (stats.empty()) {
+		out << "no functions are memoized; start with " << memo_option
+			<< '\n';
+		return;
+	}
+
+	for (const auto& s : stats) {
+		auto calls = s.hits + s.misses;
+		if (calls == 0) {
+			continue;
+		}
+
+		out << s.name << ": " << s.hits << " of " << calls
+			<< " calls cached (" << 100.0 * s.hits / calls << "%), "
+			<< s.entries << " results held\n";
+	}
+}
+
+
+/**
+ * Display the subexpressions which took the most time of their own,
+ * and write the whole profile to its file.
  */
-void display_help() {
-	std::cout << "For help, see: " << README_URL << '\n';
+void display_profile(std::ostream& out, std::ostream& err) {
+	// subexpressions shown
+	constexpr std::size_t shown = 10;
+
+	if (!is_profiling()) {
+		out << "nothing is profiled; start with " << profile_option
+			<< " <file>\n";
+		return;
+	}
+
+	auto total = profiled_seconds();
+	auto hot = hot_spots(shown);
+	if (hot.empty() || total <= 0) {
+		out << "nothing has been evaluated yet\n";
+	} else {
+		auto flags = out.flags();
+		out << std::fixed << std::setprecision(1)
+			<< "  self   total      values  subexpression\n";
+		for (const auto& h : hot) {
+			out << std::setw(5) << 100 * h.self / total << "%  "
+				<< std::setw(5) << 100 * h.total / total << "%  "
+				<< std::setw(10) << h.calls << "  " << h.expression
+				<< '\n';
+		}
+		out.flags(flags);
+	}
+
+	if (!write_profile()) {
+		err << error << "can't write the profile\n";
+	}
+}
+
+
+/**
+ * Display a summary of a series of results; the quartiles are
+ * estimates once there are more than five.
+ */
+void display_stats(const Running_stats& s, std::ostream& out) {
+	if (s.count() == 0) {
+		out << "no results to summarize\n";
+		return;
+	}
+
+	out << "count: " << s.count() << '\n'
+		<< "mean: " << s.mean() << '\n'
+		<< "variance: " << s.variance() << '\n'
+		<< "min: " << s.min() << '\n'
+		<< "max: " << s.max() << '\n'
+		<< "quartiles" << ((s.count() > 5) ? " (estimated)" : "") << ": "
+		<< s.quartile(1) << ", " << s.quartile(2) << ", "
+		<< s.quartile(3) << '\n';
+}
+
+
+/**
+ * Display the value of the statement the calculator evaluated last:
+ * the given value, or the elements of a vector, as in [1, 2, 3]. Only
+ * the ends of a long vector are shown, as in [1, 2, 3, ..., 5000]. A
+ * function declaration has no value, so the function is named instead,
+ * as in f[x] is defined.
+ */
+void display_value(Real value, const Calculator& calc,
+		std::ostream& out) {
+	// vectors with more elements than this are shortened, to this many
+	// at each end
+	constexpr std::size_t most = 1000;
+	constexpr std::size_t ends = 3;
+
+	if (!calc.function_result().empty()) {
+		out << calc.function_result() << " is defined";
+		return;
+	}
+
+	auto elements = calc.vector_result();
+	if (!elements) {
+		out << value;
+		return;
+	}
+
+	const auto& v = *elements;
+	out << '[';
+	for (std::size_t i = 0; i < v.size(); ++i) {
+		if (v.size() > most && i == ends) {
+			out << ", ...";
+			i = v.size() - ends - 1;
+			continue;
+		}
+
+		out << ((i > 0) ? ", " : "") << v[i];
+	}
+	out << ']';
 }
 
 
@@ -56,14 +184,168 @@ void display_help() {
  * Helper function to display the value of an expression, and handle
  * resulting exceptions.
  */
-void calculate(const std::string& input, Calculator& calc) {
+void calculate(const std::string& input, Calculator& calc,
+		std::ostream& out, std::ostream& err) {
+	try {
+		out << answer;
+		auto value = calc.evaluate(input);
+		display_value(value, calc, out);
+	} catch (Calc_cli_exception& e) {
+		err << error << e.what();
+	}
+
+	out << "\n";
+}
+
+
+/**
+ * Helper function to display the value of an expression and its
+ * partial derivatives, given input of the form:
+ * gradient[x, y] expression
+ */
+void differentiate(const std::string& input, Calculator& calc,
+		std::ostream& out, std::ostream& err) {
+	auto close = input.find(']');
+	if (close == std::string::npos) {
+		err << error << "] was not found\n";
+		return;
+	}
+
+	std::vector<std::string> wrt;
+	std::string names = input.substr(0, close);
+	for (auto i = names.find('['); i != std::string::npos; ) {
+		auto next = names.find(',', i + 1);
+		auto name = names.substr(i + 1, next - i - 1);
+
+		name.erase(0, name.find_first_not_of(' '));
+		name.erase(name.find_last_not_of(' ') + 1);
+		wrt.push_back(name);
+
+		i = next;
+	}
+
+	try {
+		auto result = calc.differentiate(input.substr(close + 1), wrt);
+
+		out << answer << result.value << '\n';
+		for (std::size_t i = 0; i < wrt.size(); ++i) {
+			out << "d/d" << wrt[i] << ' ' << answer
+				<< result.d[i] << '\n';
+		}
+	} catch (Calc_cli_exception& e) {
+		err << error << e.what() << '\n';
+	}
+}
+
+
+/**
+ * Helper function to save the session to a file, or load it from
+ * one, given input of the form:
+ * save file
+ * load file
+ */
+void save_or_load(const std::string& input, Calculator& calc,
+		std::ostream& err) {
 	try {
-		std::cout << answer << calc.evaluate(input);
+		if (input.rfind(save, 0) == 0) {
+			calc.save(file_name(input));
+		} else {
+			calc.load(file_name(input));
+		}
 	} catch (Calc_cli_exception& e) {
-		std::cerr << error << e.what();
+		err << error << e.what() << '\n';
+	}
+}
+
+
+/**
+ * Return the file named by a save or load command.
+ */
+std::string file_name(const std::string& command) {
+	auto start = command.find_first_not_of(" \t",
+		command.find_first_of(" \t"));
+	auto end = command.find_last_not_of(" \t");
+
+	return command.substr(start, end + 1 - start);
+}
+
+
+/**
+ * Return whether a line is the given command, save or load: the
+ * command, whitespace and a file name. It is an expression instead if
+ * the command is also the name of a variable, as in "save * 2" after
+ * "let save = 3", or if what follows could only continue one, as in
+ * "load + 1".
+ */
+bool is_file_command(const std::string& line, const std::string& command,
+		bool is_variable) {
+	if (line.compare(0, command.size(), command) != 0 ||
+			line.size() == command.size() ||
+			(line[command.size()] != ' ' && line[command.size()] != '\t')) {
+		return false;
 	}
 
-	std::cout << "\n";
+	// a path may start with "/" or ".", but not with an operator
+	auto first = line.find_first_not_of(" \t", command.size());
+	return first != std::string::npos && !is_variable &&
+		std::string{ "+-*^%!<>=,)]" }.find(line[first]) == std::string::npos;
+}
+
+
+/**
+ * Return whether a line is one of the commands, or blank, rather than
+ * an expression or declaration.
+ */
+bool is_command(const std::string& input, const Calculator& calc) {
+	return input.empty() || input == quit || input == clear ||
+		input == help || input == memo || input == profile ||
+		input == stats || input.rfind(gradient, 0) == 0 ||
+		is_file_command(input, save, calc.has_variable(save)) ||
+		is_file_command(input, load, calc.has_variable(load));
+}
+
+
+/**
+ * Produce the right output for one line of input. Return false if
+ * the input asks to quit.
+ */
+bool respond(const std::string& input, Calculator& calc,
+		std::ostream& out, std::ostream& err) {
+
+	if (!is_command(input, calc)) {
+		calculate(input, calc, out, err);
+		return true;
+	}
+
+	if (input.size() == 0) {
+		return true;
+	}
+	else if (input == quit) {
+		return false;
+	}
+	else if (input == clear) {
+		clrscr(out);
+	}
+	else if (input == help) {
+		display_help(out);
+	}
+	else if (input == memo) {
+		display_memo_stats(out);
+	}
+	else if (input == profile) {
+		display_profile(out, err);
+	}
+	else if (input == stats) {
+		display_stats(calc.statistics(), out);
+	}
+	else if (input.rfind(gradient, 0) == 0) {
+		differentiate(input, calc, out, err);
+	}
+	else {
+		save_or_load(input, calc, err);
+	}
+
+	return true;
 }
 
 
@@ -80,20 +362,19 @@ void run(Calculator& calc) {
 		std::exit(0);
 	}
 
-	if (input.size() == 0) {
-		return;
-	}
-	else if (input == quit) {
+	if (!respond(input, calc, std::cout, std::cerr)) {
 		std::exit(0);
 	}
-	else if (input == clear) {
-		clrscr();
-		return;
-	}
-	else if (input == help) {
-		display_help();
-		return;
-	}
+}
+
 
-	calculate(input, calc);
+/**
+ * Is the standard input a terminal, rather than a file or pipe?
+ */
+bool is_interactive() {
+#ifdef _WIN32
+	return _isatty(_fileno(stdin));
+#else
+	return isatty(fileno(stdin));
+#endif
 }
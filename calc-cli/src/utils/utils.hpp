@@ -12,19 +12,61 @@
 
 #include <map>
 #include <string>
+#include <vector>
+#include <iostream>
 
 #include "../calculator/calculator.hpp"
 
 
-void clrscr();
-void display_help();
+void clrscr(std::ostream& out = std::cout);
+void display_help(std::ostream& out = std::cout);
+void display_memo_stats(std::ostream& out = std::cout);
+void display_profile(std::ostream& out = std::cout,
+	std::ostream& err = std::cerr);
+void display_stats(const Running_stats& stats,
+	std::ostream& out = std::cout);
+void display_value(Real value, const Calculator& calc,
+	std::ostream& out = std::cout);
 
-std::map<std::string, double> get_consts();
+std::map<std::string, Real> get_consts();
 std::map<std::string, Calc_func> get_funcs();
+std::map<std::string, Calc_deriv> get_derivs();
+std::map<std::string, Arity> get_arities();
+std::vector<std::string> get_pure_funcs();
 
-double evaluate(const std::string& expression, Calculator& calc);
-void calculate(const std::string& input, Calculator& calc);
+Real evaluate(const std::string& expression, Calculator& calc);
+void calculate(const std::string& input, Calculator& calc,
+	std::ostream& out = std::cout, std::ostream& err = std::cerr);
+void differentiate(const std::string& input, Calculator& calc,
+	std::ostream& out = std::cout, std::ostream& err = std::cerr);
+void save_or_load(const std::string& input, Calculator& calc,
+	std::ostream& err = std::cerr);
+std::string file_name(const std::string& command);
+bool is_file_command(const std::string& line, const std::string& command,
+	bool is_variable);
+bool is_command(const std::string& input, const Calculator& calc);
+bool respond(const std::string& input, Calculator& calc,
+	std::ostream& out, std::ostream& err);
 void run(Calculator& calc);
 
+bool is_interactive();
+int run_stream(Calculator& calc);
+// with outputs, only the declarations of those variables, and the
+// lines they depend on, are run, and only their values printed
+int run_script(const std::string& path, Calculator& calc,
+	const std::vector<std::string>& outputs = {});
+int run_validate(const std::vector<std::string>& paths,
+	const Calculator& calc, const std::map<std::string, Arity>& arities);
+
+// what run_csv and run_binary print: a line of text for each row, a
+// raw Real for each row, or a summary of all rows
+enum class Table_output { text, raw, summary };
+
+int run_csv(const std::string& path, const std::string& expression,
+	Calculator& calc, Table_output output);
+int run_binary(const std::string& path, const std::string& names,
+	const std::string& expression, Calculator& calc, Table_output output);
+std::vector<std::string> split_names(const std::string& names);
+
 
 #endif // !CALC_CLI_UTILS_HPP
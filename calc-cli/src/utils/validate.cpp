@@ -0,0 +1,237 @@
+/**
+ * calc-cli is a command-line calculator.
+ *
+ * validate.cpp defines run_validate from utils.hpp, which checks
+ * files of input without evaluating any of it, and reports every
+ * error with the line and column it was found at:
+ *
+ * points.txt:3:9: Error: no such variable
+ *
+ * Each file is checked from top to bottom by its own copy of the
+ * calculator, so that a declaration is known to the lines after it.
+ * Files are checked at the same time, one per processor, and their
+ * reports are printed in the order the files were given.
+ */
+
+
+#include <map>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include "utils.hpp"
+#include "calc_consts.hpp"
+#include "../calculator/pool/pool.hpp"
+#include "../calculator/exceptions/exceptions.hpp"
+
+
+using std::string;
+using std::vector;
+
+
+using Arities = std::map<string, Arity>;
+
+
+bool check_file(const string& path, Calculator& calc,
+	const Arities& arities, std::ostream& report);
+void check_line(const string& line, Calculator& calc,
+	const Arities& arities);
+void check_gradient(const string& line, Calculator& calc,
+	const Arities& arities);
+
+
+/**
+ * Check every file, printing what is wrong with them. Return the exit
+ * code: 0 if they could all be read and have no errors.
+ */
+int run_validate(const vector<string>& paths, const Calculator& calc,
+		const Arities& arities) {
+
+	vector<string> reports(paths.size());
+	vector<char> clean(paths.size());
+	std::atomic<std::size_t> next{ 0 };
+
+	auto worker = [&]() {
+		for (auto i = next++; i < paths.size(); i = next++) {
+			auto checker = calc;
+			std::ostringstream report;
+			clean[i] = check_file(paths[i], checker, arities, report);
+			reports[i] = report.str();
+		}
+	};
+
+	auto workers = std::min(paths.size(), thread_count());
+
+	vector<std::thread> threads;
+	for (std::size_t i = 1; i < workers; ++i) {
+		threads.emplace_back(worker);
+	}
+
+	worker();
+
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	for (const auto& r : reports) {
+		std::cout << r;
+	}
+
+	std::cout.flush();
+	return std::all_of(clean.begin(), clean.end(),
+		[](char c) { return c != 0; }) ? 0 : 1;
+}
+
+
+/**
+ * Check every line of a file, as the REPL would run them, writing a
+ * report of each error. Return true if there are none.
+ */
+bool check_file(const string& path, Calculator& calc,
+		const Arities& arities, std::ostream& report) {
+
+	std::ifstream file{ path, std::ios::binary };
+	if (!file) {
+		report << error << "can't read " << path << '\n';
+		return false;
+	}
+
+	std::ostringstream contents;
+	contents << file.rdbuf();
+	auto all = contents.str();
+
+	bool clean = true;
+	std::size_t number = 0;
+	for (std::size_t start = 0; start < all.size(); ) {
+		auto end = std::min(all.find('\n', start), all.size());
+		auto line = all.substr(start, end - start);
+		start = end + 1;
+		++number;
+
+		if (line == quit) {		// nothing after it would be run
+			break;
+		}
+
+		try {
+			check_line(line, calc, arities);
+		} catch (Calc_cli_exception& e) {
+			clean = false;
+
+			report << path << ':' << number << ':';
+			if (e.column() != 0) {
+				report << e.column() << ':';
+			}
+			report << ' ' << error << e.what() << '\n';
+		}
+	}
+
+	return clean;
+}
+
+
+/**
+ * Check one line of input, throwing the first error in it.
+ */
+void check_line(const string& line, Calculator& calc,
+		const Arities& arities) {
+
+	if (line.empty() || line == clear || line == help || line == memo ||
+			line == stats || line == profile) {
+		return;
+	}
+
+	if (line.rfind(gradient, 0) == 0) {
+		check_gradient(line, calc, arities);
+		return;
+	}
+
+	if (is_file_command(line, save, calc.has_variable(save))) {
+		return;
+	}
+
+	// a saved session is loaded, for the names it defines
+	if (is_file_command(line, load, calc.has_variable(load))) {
+		calc.load(file_name(line));
+		return;
+	}
+
+	calc.check(line, arities);
+}
+
+
+/**
+ * Check a line of the form gradient[x, y] expression, in the order
+ * differentiate would: the expression, in which the names are index
+ * variables, then the names, which must be variables.
+ */
+void check_gradient(const string& line, Calculator& calc,
+		const Arities& arities) {
+
+	auto close = line.find(']');
+	if (close == string::npos) {
+		Syntax_error e{ "] was not found" };
+		e.locate(line.size() + 1);
+		throw e;
+	}
+
+	// the names, trimmed, and where each starts
+	vector<string> wrt;
+	vector<std::size_t> columns;
+	for (auto i = line.find('['); i < close; ) {
+		auto next = std::min(line.find(',', i + 1), close);
+		auto name = line.substr(i + 1, next - i - 1);
+
+		auto first = name.find_first_not_of(' ');
+		name.erase(0, first);
+		name.erase(name.find_last_not_of(' ') + 1);
+		wrt.push_back(name);
+		columns.push_back(i + 2 + std::min(first, next - i - 1));
+
+		i = next;
+	}
+
+	auto expression = line.substr(close + 1);
+	try {
+		auto tokens = tokenize(expression);
+		if (!tokens.empty() && tokens.front().type == Token_type::let) {
+			Syntax_error e{ "only an expression can be differentiated" };
+			e.locate(tokens.front().column);
+			throw e;
+		}
+
+		calc.check(expression, arities, wrt);
+	} catch (Calc_cli_exception& e) {
+		// columns are counted from the start of the line
+		Calc_cli_exception shifted{ e.what() };
+		if (e.column() != 0) {
+			shifted.locate(e.column() + close + 1);
+		}
+		throw shifted;
+	}
+
+	// a name is a variable exactly when it is made of letters, and
+	// checks as an expression of its own
+	for (std::size_t i = 0; i < wrt.size(); ++i) {
+		auto& name = wrt[i];
+		try {
+			if (name.empty() || !std::all_of(name.begin(), name.end(),
+					[](char c) {
+						return std::isalpha(
+							static_cast<unsigned char>(c)) != 0; })) {
+				throw Variable_not_defined{};
+			}
+
+			calc.check(name, arities);
+		} catch (Calc_cli_exception&) {
+			Variable_not_defined e{ "no such variable" };
+			e.locate(columns[i]);
+			throw e;
+		}
+	}
+}
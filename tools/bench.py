@@ -0,0 +1,338 @@
+#!/usr/bin/env python3
+"""
+calc-cli is a command-line calculator.
+
+bench.py times the inputs quoted when each optimization went in, on one
+or more built calc-cli, so that a speedup can be reproduced and a
+regression noticed. Give several builds, such as the float, double and
+long double ones, or one from before a change and one from after, to
+compare them side by side. Each time is the best of --runs runs, in
+seconds of wall time, including starting calc-cli. Cases are labelled
+by the feature they time, such as server or memo, and --only runs
+those whose feature or name contains the text given. A case may note
+something more under its times, such as how often --memo had the
+answer.
+
+Usage: bench.py [--runs N] [--only TEXT] <calc-cli>...
+       bench.py --list
+"""
+
+import os
+import random
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def answered(calc, args=(), input_text="", cwd=None):
+    """Return how long calc-cli took with the given arguments and input,
+    and what it wrote, failing if it failed or wrote an error, which
+    would make it look fast."""
+    start = time.perf_counter()
+    done = subprocess.run([calc] + list(args), input=input_text,
+        capture_output=True, text=True, cwd=cwd)
+    elapsed = time.perf_counter() - start
+
+    if done.returncode != 0 or done.stderr:
+        raise RuntimeError("exit code {}: {}".format(done.returncode,
+            done.stderr.strip()[:200]))
+
+    return elapsed, done.stdout
+
+
+def timed(calc, args=(), input_text="", cwd=None):
+    """Return how long calc-cli took with the given arguments and
+    input."""
+    return answered(calc, args, input_text, cwd)[0]
+
+
+def line(text, args=()):
+    """A case which evaluates one line of input."""
+    return lambda calc, tmp: timed(calc, args, text + "\n")
+
+
+def polynomial(name, degree, seed):
+    """A declaration of a function of x, written as a sum of terms with
+    random coefficients."""
+    rng = random.Random(seed)
+    terms = ["{:.6f}*x^{}".format(rng.uniform(-1, 1), d)
+        for d in range(degree, 1, -1)]
+    return "let {}[x] = {} + 0.5*x + 1".format(name, " + ".join(terms))
+
+
+def memo_hits(text):
+    """A case which evaluates one line of input with --memo, noting how
+    often each cache had the answer."""
+    def case(calc, tmp):
+        elapsed, out = answered(calc, ["--memo"], text + "\nmemo\n")
+        rates = []
+        for l in out.splitlines():
+            # e.g. "factorial: 990 of 1000 calls cached (99%), ..."
+            if "calls cached" in l:
+                words = l.strip("> ").split()
+                rates.append("{} {:.1f}% of {}".format(words[0],
+                    100 * int(words[1]) / int(words[3]), words[3]))
+        return elapsed, "hit rate " + ", ".join(rates)
+    return case
+
+
+# a process per expression, against one server for them all
+
+SPAWNED = "sum[k,1,100,sin[k]]*2"
+SPAWNS = 500
+
+
+def spawned(calc, tmp):
+    start = time.perf_counter()
+    for _ in range(SPAWNS):
+        subprocess.run([calc], input=SPAWNED + "\n", capture_output=True,
+            text=True, check=True)
+    return time.perf_counter() - start
+
+
+def wait_for(path):
+    """Wait until a server accepts connections on the socket."""
+    for _ in range(500):
+        with socket.socket(socket.AF_UNIX) as s:
+            try:
+                s.connect(path)
+                return
+            except OSError:
+                time.sleep(0.01)
+    raise RuntimeError("no server on " + path)
+
+
+def served(calc, tmp):
+    if not hasattr(socket, "AF_UNIX") or os.name == "nt":
+        raise RuntimeError("needs UNIX sockets")
+
+    path = os.path.join(tmp, "bench.sock")
+    if os.path.exists(path):
+        os.remove(path)
+    server = subprocess.Popen([calc, "--server", path],
+        stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL)
+    try:
+        wait_for(path)
+        return timed(calc, ["--client", path],
+            (SPAWNED + "\n") * SPAWNS)
+    finally:
+        server.kill()
+        server.wait()
+
+
+# many independent statements, and declarations among them, evaluated
+# by --script through a Shared_calculator
+
+def script(calc, tmp):
+    path = os.path.join(tmp, "script.txt")
+    with open(path, "w") as f:
+        for i in range(20000):
+            if i % 2000 == 0:
+                f.write("let v{} = {}\n".format(
+                    chr(ord("a") + i // 2000), i))
+            f.write("sin[{}] * cos[{}] + sqrt[{}]\n".format(i, i, i))
+    return timed(calc, ["--script", path])
+
+
+# declarations costly enough that they should run at once, none of
+# them using another
+
+def costly_lets(calc, tmp):
+    path = os.path.join(tmp, "costly-lets.txt")
+    with open(path, "w") as f:
+        for i in range(64):
+            f.write("let v{} = sum[k, 1, 2e5, sin[k * {}]]\n".format(
+                name(i), i + 1))
+    return timed(calc, ["--script", path])
+
+
+# the statistics of every line of a stream
+
+def streamed(calc, tmp):
+    rng = random.Random(37)
+    text = "".join("{:.6f}\n".format(rng.gauss(0, 1))
+        for _ in range(100000))
+    return timed(calc, [], text + "stats\n")
+
+
+# an argument list costly enough to evaluate in parallel
+
+def arguments(count):
+    terms = ",".join("sin[{0}]*cos[{0}]+ln[{0}]".format(i + 1)
+        for i in range(count))
+    return line("sum[" + terms + "]")
+
+
+# replaying 10^5 declarations, against loading them saved
+
+LETS = 100000
+
+
+def lets(tmp):
+    path = os.path.join(tmp, "lets.txt")
+    if not os.path.exists(path):
+        with open(path, "w") as f:
+            for i in range(LETS):
+                f.write("let v{} = {}\n".format(name(i), i))
+    return path
+
+
+def name(i):
+    """A variable name made of letters only, for the number i."""
+    letters = ""
+    while True:
+        letters += chr(ord("a") + i % 26)
+        i //= 26
+        if i == 0:
+            return letters
+
+
+def replayed(calc, tmp):
+    with open(lets(tmp)) as f:
+        return timed(calc, [], f.read())
+
+
+def loaded(calc, tmp):
+    # a session saved by this build, which is the only one that loads it
+    session = os.path.join(tmp, "lets-{}.calc".format(
+        abs(hash(calc)) % 10 ** 8))
+    if not os.path.exists(session):
+        with open(lets(tmp)) as f:
+            timed(calc, [], f.read() + "save " + session + "\n")
+    return timed(calc, ["--load", session], "1\n")
+
+
+# polynomials, in a reduction a block at a time, and in a function
+# called one value at a time
+
+POLY20 = ("sum[k, 1, 2000000, 0.5*(k/2000000)^20 - 3*(k/2000000)^17 + "
+    "2*(k/2000000)^13 - (k/2000000)^9 + 5*(k/2000000)^4 - "
+    "(k/2000000)^3 + 1.5*(k/2000000)^2 - (k/2000000) + 1]")
+
+
+def function_sum(degree):
+    return line(polynomial("f", degree, degree) + "\n" +
+        "sum[j, 1, 100000, sum[k, 1, 10, f[j/100000 - k/10]]]")
+
+
+# factorial of 10^5 arguments ranked by Zipf's law: k times the golden
+# ratio, mod 1, is spread evenly over [0, 1), so 1e5 raised to it is
+# rounded to r with probability close to 1 / r, and a few arguments
+# come up most of the time while the rest outgrow the cache
+
+ZIPF = ("sum[k, 1, 4e5, "
+    "factorial[round[1e5 ^ (k * 0.6180339887 % 1)] / 1000]]")
+
+
+SIN_LN = "sum[k, 1, 1e6, sin[k] * ln[k]]"
+ROOTS = "sum[k, 1, 1e6, sqrt[k] - cbrt[k] + atan[k/1000]]"
+
+# feature, name, case
+CASES = [
+    ("server", "500 processes, one line each", spawned),
+    ("server", "500 lines through one server", served),
+    ("fast-math", SIN_LN, line(SIN_LN)),
+    ("fast-math", ROOTS, line(ROOTS)),
+    ("fast-math", "--fast-math " + SIN_LN, line(SIN_LN, ["--fast-math"])),
+    ("fast-math", "--fast-math " + ROOTS, line(ROOTS, ["--fast-math"])),
+    ("reduction", "sum[k, 1, 1e6, 1 / k ^ 2]",
+        line("sum[k, 1, 1e6, 1 / k ^ 2]")),
+    ("reduction", "sum[j, 1, 300, sum[k, 1, 1000, sin[j * k]]]",
+        line("sum[j, 1, 300, sum[k, 1, 1000, sin[j * k]]]")),
+    ("script", "--script of 20000 lines", script),
+    ("script", "--script of 64 costly independent lets", costly_lets),
+    ("memo", "factorial of 100 values, 4e5 times",
+        line("sum[k, 1, 4e5, factorial[k % 100 / 10]]")),
+    ("memo", "factorial of 100 values, 4e5 times --memo",
+        line("sum[k, 1, 4e5, factorial[k % 100 / 10]]", ["--memo"])),
+    ("memo", "factorial of 1e5 Zipf-ranked values, 4e5 times",
+        line(ZIPF)),
+    ("memo", "factorial of 1e5 Zipf-ranked values, 4e5 times --memo",
+        memo_hits(ZIPF)),
+    ("statistics", "median[1..1000000]", line("median[1..1000000]")),
+    ("statistics", "variance[1..1000000]", line("variance[1..1000000]")),
+    ("statistics", "stats of 100000 lines", streamed),
+    ("parallel", "sum of 10000 costly arguments", arguments(10000)),
+    ("parallel", "sum of 30000 costly arguments", arguments(30000)),
+    ("save/load", "100000 let lines", replayed),
+    ("save/load", "--load of 100000 variables", loaded),
+    ("integrate", "integrate[x, 0, 100, sin[x]*x^2, 1e-12]",
+        line("integrate[x, 0, 100, sin[x]*x^2, 1e-12]")),
+    ("integrate", "midpoint sum of 1e6 terms",
+        line("sum[k, 0, 999999, sin[(k + 0.5) / 1e4] * "
+            "((k + 0.5) / 1e4)^2] / 1e4")),
+    ("polynomial", "degree-20 polynomial over 2e6 k", line(POLY20)),
+    ("polynomial", "degree-24 f, 1e6 calls", function_sum(24)),
+    ("polynomial", "degree-64 f, 1e6 calls", function_sum(64)),
+]
+
+
+def timing(result):
+    """Return a case's time, and the note it gave, if any."""
+    return result if isinstance(result, tuple) else (result, "")
+
+
+def main(args):
+    runs = 3
+    only = ""
+    while args and args[0].startswith("--"):
+        if args[0] == "--list":
+            for feature, case_name, _ in CASES:
+                print("{:<12}{}".format(feature, case_name))
+            return 0
+        elif args[0] == "--runs" and len(args) > 1 and args[1].isdigit():
+            runs = int(args[1])
+        elif args[0] == "--only" and len(args) > 1:
+            only = args[1]
+        else:
+            break
+        args = args[2:]
+
+    if not args or runs == 0:
+        sys.stderr.write(__doc__.split("\n\n")[-1].strip() + "\n")
+        return 1
+
+    calcs = [os.path.abspath(c) for c in args]
+    width = 56
+    print("{:<12}{:<{}}".format("feature", "case", width) +
+        "".join("{:>12}".format("build {}".format(i + 1))
+            for i in range(len(calcs))))
+    for i, c in enumerate(calcs):
+        print("  build {}: {}".format(i + 1, c))
+
+    tmp = tempfile.mkdtemp(prefix="calc-bench-")
+    failed = False
+    try:
+        for feature, case_name, case in CASES:
+            if only not in feature + " " + case_name:
+                continue
+
+            shown = case_name if len(case_name) <= width - 2 \
+                else case_name[:width - 5] + "..."
+            row = "{:<12}{:<{}}".format(feature, shown, width)
+            notes = []
+            for i, calc in enumerate(calcs):
+                try:
+                    best, note = min(timing(case(calc, tmp))
+                        for _ in range(runs))
+                    row += "{:>12.3f}".format(best)
+                    if note:
+                        notes.append("  build {}: {}".format(i + 1, note))
+                except (RuntimeError, OSError,
+                        subprocess.CalledProcessError) as e:
+                    row += "{:>12}".format("failed")
+                    sys.stderr.write("{}: {}: {}\n".format(case_name,
+                        calc, e))
+                    failed = True
+            print("\n".join([row] + notes), flush=True)
+    finally:
+        shutil.rmtree(tmp, ignore_errors=True)
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+"""
+calc-cli is a command-line calculator.
+
+check_fast_math.py measures the error and speed of each function which
+--fast-math approximates, against the standard library's, which
+calc-cli uses without it. Each function is applied to --count random
+arguments, 10^6 by default, spread logarithmically over its domain as
+in the table of bounds in batch_funcs.cpp (for sin to cot, |x| <= 10^5),
+whose bounds cover the largest errors it found with --count 5000000.
+Each function's arguments are the same on every run, and the first
+--count of them are the same whatever --count is. They are passed as a
+--binary file, so that the whole column goes through the batch
+functions, and the results come back with --raw-output, so that no
+digits are lost.
+
+The largest error, in units in the last place, is held to the bound
+in batch_funcs.cpp. A NaN from one build and not the other is a
+failure as well. The times are the best of --runs runs of each, in
+seconds, including starting calc-cli and reading and writing the
+values; the `x` line shows what that costs by itself.
+
+Only a build with Real = double can be checked: the approximations
+compute in double, whatever Real is.
+
+Usage: check_fast_math.py [--count N] [--runs N] [--only TEXT] <calc-cli>
+"""
+
+import math
+import os
+import random
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+from array import array
+
+
+# the bounds from batch_funcs.cpp, in ulps
+BOUNDS = {
+    "sin": 2, "cos": 2, "csc": 2, "sec": 2,
+    "tan": 4,
+    "cot": 5,
+    "asin": 2, "acos": 2, "acsc": 2, "asec": 2,
+    "atan": 1, "acot": 1,
+    "sinh": 3, "cosh": 3, "sech": 3,
+    "tanh": 4, "csch": 4,
+    "coth": 6,
+    "asinh": 2, "acosh": 2, "acsch": 2, "asech": 2,
+    "atanh": 4, "acoth": 4,
+    "ln": 2, "log": 2,
+    "logb": 3,
+    "cbrt": 5,
+}
+
+
+def spread(low, high, signed=False, offset=0, flip=False):
+    """Return a function giving an argument 10^u for u uniform in
+    [low, high], negated half of the time if signed, added to offset,
+    or subtracted from it if flip."""
+    def argument(rng):
+        v = 10 ** rng.uniform(low, high)
+        v = offset - v if flip else offset + v
+        return -v if signed and rng.random() < 0.5 else v
+    return argument
+
+
+TRIG = spread(-8, 5, signed=True)
+HYPERBOLIC = spread(-8, math.log10(700), signed=True)
+ANY = spread(-8, 8, signed=True)
+INVERSE = spread(0, 8, signed=True, offset=1)
+
+# function, arguments
+CASES = [
+    ("sin", TRIG), ("cos", TRIG), ("tan", TRIG),
+    ("csc", TRIG), ("sec", TRIG), ("cot", TRIG),
+    ("asin", spread(-8, 0, signed=True)),
+    ("acos", spread(-8, 0, signed=True)),
+    ("atan", ANY),
+    ("acsc", INVERSE), ("asec", INVERSE),
+    ("acot", ANY),
+    ("sinh", HYPERBOLIC), ("cosh", HYPERBOLIC), ("tanh", HYPERBOLIC),
+    ("csch", HYPERBOLIC), ("sech", HYPERBOLIC), ("coth", HYPERBOLIC),
+    ("asinh", ANY),
+    ("acosh", spread(-8, 8, offset=1)),
+    ("atanh", spread(-8, 0, signed=True, offset=1, flip=True)),
+    ("acsch", ANY),
+    ("asech", spread(-8, 0)),
+    ("acoth", spread(-8, 8, signed=True, offset=1)),
+    ("ln", spread(-300, 300)),
+    ("log", spread(-300, 300)),
+    ("logb", spread(-300, 300)),
+    ("cbrt", spread(-300, 300, signed=True)),
+]
+
+
+def run(args, input_text=""):
+    """Return the standard output of calc-cli and how long it took,
+    failing if it wrote an error."""
+    start = time.perf_counter()
+    done = subprocess.run(args, input=input_text.encode(),
+        capture_output=True)
+    elapsed = time.perf_counter() - start
+
+    if done.returncode != 0 or done.stderr:
+        raise RuntimeError("exit code {}: {}".format(done.returncode,
+            done.stderr.decode(errors="replace").strip()[:200]))
+
+    return done.stdout, elapsed
+
+
+def is_double(calc):
+    """Whether Real is double in the build: whether 2^-52, and not
+    2^-53, is the smallest power of 2 that changes 1 when added to it."""
+    out, _ = run([calc], "(1 + 2 ^ (-52)) - 1\n(1 + 2 ^ (-53)) - 1\n")
+    answers = [a.strip() for a in out.decode().split(">")[1:-1]]
+    return len(answers) == 2 and answers[0] != "= 0" and \
+        answers[1] == "= 0"
+
+
+def ordered(values):
+    """Return the bits of each double as an integer which orders them
+    as the doubles, so that adjacent doubles differ by 1."""
+    bits = array("q", values)
+    return [b if b >= 0 else -(1 << 63) - b for b in bits]
+
+
+def results(calc, options, expression, path, runs):
+    """Return the raw results of evaluating expression for every
+    argument in the file at path, and the best time of runs runs."""
+    best = None
+    for _ in range(runs):
+        out, elapsed = run([calc] + options + ["--raw-output", "--binary",
+            "x", path, expression])
+        best = elapsed if best is None else min(best, elapsed)
+
+    return out, best
+
+
+def main(args):
+    count = 10 ** 6
+    runs = 3
+    only = ""
+    while args and args[0].startswith("--"):
+        if args[0] in ("--count", "--runs") and len(args) > 1 and \
+                args[1].isdigit():
+            if args[0] == "--count":
+                count = int(args[1])
+            else:
+                runs = int(args[1])
+        elif args[0] == "--only" and len(args) > 1:
+            only = args[1]
+        else:
+            break
+        args = args[2:]
+
+    if len(args) != 1 or count == 0 or runs == 0:
+        sys.stderr.write(__doc__.split("\n\n")[-1].strip() + "\n")
+        return 1
+
+    calc = os.path.abspath(args[0])
+    try:
+        if not is_double(calc):
+            print("FAIL: {} isn't a build with Real = double".format(calc))
+            return 1
+    except (RuntimeError, OSError) as e:
+        print("FAIL: can't run {}: {}".format(calc, e))
+        return 1
+
+    print("{} arguments each".format(count))
+    print("{:<8}{:>8}{:>8}{:>10}{:>10}{:>9}".format("function", "bound",
+        "ulps", "libm", "fast", "speedup"))
+
+    failures = 0
+    with tempfile.TemporaryDirectory() as directory:
+        path = os.path.join(directory, "x.bin")
+        baseline = False
+        for name, argument in CASES:
+            if only not in name:
+                continue
+
+            # the same arguments whichever functions are run
+            rng = random.Random(name)
+            xs = [argument(rng) for _ in range(count)]
+            with open(path, "wb") as f:
+                f.write(struct.pack("={}d".format(count), *xs))
+
+            try:
+                if not baseline:
+                    _, exact_time = results(calc, [], "x", path, runs)
+                    _, fast_time = results(calc, ["--fast-math"], "x",
+                        path, runs)
+                    print("{:<8}{:>8}{:>8}{:>10.3f}{:>10.3f}".format("x",
+                        "", "", exact_time, fast_time))
+                    baseline = True
+
+                expression = "{}[x]".format(name)
+                exact, exact_time = results(calc, [], expression, path,
+                    runs)
+                fast, fast_time = results(calc, ["--fast-math"],
+                    expression, path, runs)
+            except (RuntimeError, OSError) as e:
+                print("FAIL {}: {}".format(name, e))
+                failures += 1
+                continue
+
+            if len(exact) != 8 * count or len(fast) != 8 * count:
+                print("FAIL {}: {} and {} bytes of results".format(name,
+                    len(exact), len(fast)))
+                failures += 1
+                continue
+
+            worst = 0
+            worst_x = None
+            mismatched = None
+            for x, e, a, eb, ab in zip(xs, array("d", exact),
+                    array("d", fast), ordered(exact), ordered(fast)):
+                if math.isnan(e) or math.isnan(a):
+                    if math.isnan(e) != math.isnan(a):
+                        mismatched = mismatched or (x, e, a)
+                    continue
+
+                if abs(eb - ab) > worst:
+                    worst = abs(eb - ab)
+                    worst_x = x
+
+            print("{:<8}{:>8}{:>8}{:>10.3f}{:>10.3f}{:>8.2f}x".format(name,
+                BOUNDS[name], worst, exact_time, fast_time,
+                exact_time / fast_time), flush=True)
+
+            if mismatched:
+                print("FAIL {} at {!r}: {!r}, but {!r} with --fast-math"
+                    .format(name, *mismatched))
+                failures += 1
+            if worst > BOUNDS[name]:
+                print("FAIL {} at {!r}: {} ulps over {}".format(name,
+                    worst_x, worst, BOUNDS[name]))
+                failures += 1
+
+    print("{} failed".format(failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
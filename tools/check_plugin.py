@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+"""
+calc-cli is a command-line calculator.
+
+check_plugin.py builds the example plugin, plugin/example/square.c,
+with a C compiler taking the options of gcc and clang, --cc or $CC or
+else cc, and checks how calc-cli calls each kind of function in it:
+
+    scalar  square, cube and hypot on single arguments, and from a
+            user-defined function
+    batch   square, which has a batch entry point, and cube, which is
+            called a block at a time through its scalar one, in a sum
+            and over the rows of a table, against the same expressions
+            written out
+    impure  calls, which counts its calls, isn't folded into a
+            constant or cached by --memo, nor is a function calling it
+    arity   a call with the wrong number of arguments is an error,
+            and --validate finds it without evaluating
+    load    loading the plugin twice, or a file which isn't a plugin,
+            stops calc-cli with an error
+
+Usage: check_plugin.py [--cc COMPILER] <calc-cli>
+"""
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+
+EXAMPLE = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+    "..", "calc-cli", "src", "plugin", "example", "square.c")
+
+ARITY_ERROR = "Error: invalid number of arguments"
+
+
+def run(calc, options, lines):
+    """Return the answer to each line, without its "= "."""
+    done = subprocess.run([calc] + options, input="\n".join(lines) + "\n",
+        capture_output=True, text=True)
+    if done.returncode != 0 or done.stderr:
+        raise RuntimeError("exit code {}: {}".format(done.returncode,
+            done.stderr.strip()[:200]))
+
+    answers = [a.strip() for a in done.stdout.split(">")[1:-1]]
+    if len(answers) != len(lines):
+        raise RuntimeError("{} answers to {} lines".format(len(answers),
+            len(lines)))
+
+    return [a[2:] if a.startswith("= ") else a for a in answers]
+
+
+def answers(lines, expected, options=()):
+    """A check that lines give the expected answers."""
+    def check(calc, plugin, tmp):
+        got = run(calc, list(options) + ["--plugin", plugin], lines)
+        return None if got == expected else \
+            "{} gave {}, not {}".format(lines, got, expected)
+    return check
+
+
+def written_out(expression, by_hand):
+    """A check that a sum of 10^5 terms calling the plugin is exactly
+    the same written out by hand, which is evaluated in the same order
+    and with the same operations. x is sin[k], which isn't compiled
+    into a polynomial, as a power of k would be."""
+    def term(body):
+        return "sum[k, 1, 1e5, {}]".format(body.replace("x", "sin[k]"))
+
+    return answers(["{} - {}".format(term(expression), term(by_hand))],
+        ["0"])
+
+
+def table(expression, by_hand):
+    """A check that a table of 10^5 rows gives the same results calling
+    the plugin as written out by hand."""
+    def check(calc, plugin, tmp):
+        path = os.path.join(tmp, "x.csv")
+        with open(path, "w") as f:
+            f.write("x\n")
+            f.write("".join("{}\n".format((i - 50000) / 7)
+                for i in range(100000)))
+
+        results = []
+        for e in (expression, by_hand):
+            done = subprocess.run([calc, "--plugin", plugin, "--csv", path,
+                e], capture_output=True, text=True)
+            if done.returncode != 0 or done.stderr:
+                return "exit code {}: {}".format(done.returncode,
+                    done.stderr.strip()[:200])
+            results.append(done.stdout)
+
+        return None if results[0] == results[1] else \
+            "{} and {} differ".format(expression, by_hand)
+    return check
+
+
+def fails(line, message):
+    """A check that evaluating a line writes an error with message."""
+    def check(calc, plugin, tmp):
+        done = subprocess.run([calc, "--plugin", plugin], input=line + "\n",
+            capture_output=True, text=True)
+        return None if message in done.stderr else \
+            "{} gave {!r}".format(line, (done.stderr or done.stdout)[:200])
+    return check
+
+
+def validated(lines, bad):
+    """A check that --validate finds errors in exactly the given lines,
+    numbered from 1."""
+    def check(calc, plugin, tmp):
+        path = os.path.join(tmp, "validate.txt")
+        with open(path, "w") as f:
+            f.write("\n".join(lines) + "\n")
+
+        done = subprocess.run([calc, "--plugin", plugin, "--validate",
+            path], capture_output=True, text=True)
+        found = [int(l.split(":")[1]) for l in
+            (done.stdout + done.stderr).splitlines() if ARITY_ERROR in l]
+        return None if found == bad and (done.returncode != 0) == bool(bad) \
+            else "errors in lines {}, not {}".format(found, bad)
+    return check
+
+
+def refused(plugins, message):
+    """A check that loading the given plugins fails with an error
+    containing message; "plugin" stands for the example."""
+    def check(calc, plugin, tmp):
+        options = []
+        for p in plugins:
+            if p == "plugin":
+                p = plugin
+            elif not os.path.exists(p):
+                p = os.path.join(tmp, p)
+                with open(p, "w") as f:
+                    f.write("not a shared library\n")
+            options += ["--plugin", p]
+
+        done = subprocess.run([calc] + options, input="1\n",
+            capture_output=True, text=True)
+        if done.returncode == 0 or message not in done.stdout + done.stderr:
+            return "exit code {}: {}".format(done.returncode,
+                (done.stderr or done.stdout).strip()[:200])
+        return None
+    return check
+
+
+# kind, name, check
+CHECKS = [
+    ("scalar", "square[3], cube[-2], hypot[3, 4]",
+        answers(["square[3]", "cube[-2]", "hypot[3, 4]"], ["9", "-8", "5"])),
+    ("scalar", "a user-defined function calling them",
+        answers(["let f[x] = hypot[square[x], cube[x]]", "f[2]"],
+            ["f[x] is defined", "8.94427"])),
+    ("scalar", "with --memo",
+        answers(["square[3]", "square[3]", "hypot[3, 4]"], ["9", "9", "5"],
+            ["--memo"])),
+    ("batch", "square, from its batch entry point, in a sum",
+        written_out("square[x]", "x * x")),
+    ("batch", "cube, from its scalar entry point, in a sum",
+        written_out("cube[x]", "x * x * x")),
+    ("batch", "both, over the rows of a table",
+        table("square[x] + cube[x]", "x * x + x * x * x")),
+    ("impure", "calls[0] twice",
+        answers(["calls[0]", "calls[0]"], ["1", "2"])),
+    ("impure", "calls[0] twice with --memo",
+        answers(["calls[0]", "calls[0]"], ["1", "2"], ["--memo"])),
+    ("impure", "a user-defined function calling it",
+        answers(["let g[x] = calls[x]", "g[0]", "g[0]"],
+            ["g[x] is defined", "1", "2"])),
+    ("impure", "called once per term of a sum",
+        answers(["sum[k, 1, 10, calls[0]]", "calls[0]"], ["55", "11"])),
+    ("arity", "square[1, 2]", fails("square[1, 2]", ARITY_ERROR)),
+    ("arity", "hypot[1]", fails("hypot[1]", ARITY_ERROR)),
+    ("arity", "calls[] in a function", fails("let h[x] = calls[] + x\nh[1]",
+        ARITY_ERROR)),
+    ("arity", "--validate",
+        validated(["square[1, 2]", "hypot[1]", "hypot[1, 2]",
+            "let h[x] = cube[x, x]", "calls[1]"], [1, 2, 4])),
+    ("load", "the same plugin twice",
+        refused(["plugin", "plugin"], "redefines square")),
+    ("load", "a file which isn't a plugin",
+        refused(["not-a-plugin.so"], "can't load")),
+]
+
+
+def build(compiler, tmp):
+    """Build the example plugin, and return its path."""
+    plugin = os.path.join(tmp, "square.so")
+    done = subprocess.run([compiler, "-O2", "-shared", "-fPIC", "-o",
+        plugin, EXAMPLE, "-lm"], capture_output=True, text=True)
+    if done.returncode != 0:
+        raise RuntimeError(done.stderr.strip()[:400])
+
+    return plugin
+
+
+def main(args):
+    compiler = os.environ.get("CC", "cc")
+    if len(args) > 1 and args[0] == "--cc":
+        compiler = args[1]
+        args = args[2:]
+
+    if len(args) != 1:
+        sys.stderr.write(__doc__.split("\n\n")[-1].strip() + "\n")
+        return 1
+
+    calc = os.path.abspath(args[0])
+    tmp = tempfile.mkdtemp(prefix="calc-plugin-")
+    try:
+        try:
+            plugin = build(compiler, tmp)
+        except (RuntimeError, OSError) as e:
+            print("FAIL: can't build {} with {}: {}".format(EXAMPLE,
+                compiler, e))
+            return 1
+
+        failures = 0
+        for kind, name, check in CHECKS:
+            try:
+                problem = check(calc, plugin, tmp)
+            except (RuntimeError, OSError) as e:
+                problem = str(e)
+
+            print("{:<8}{:<48}{}".format(kind, name,
+                "ok" if problem is None else "FAIL"))
+            if problem is not None:
+                print("    " + problem)
+                failures += 1
+    finally:
+        shutil.rmtree(tmp, ignore_errors=True)
+
+    print("{} failed".format(failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
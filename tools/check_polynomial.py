@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""
+calc-cli is a command-line calculator.
+
+check_polynomial.py compares the accuracy of a polynomial evaluated by
+Horner's scheme, as calc-cli does for one written out in a parameter or
+index variable, with the same polynomial evaluated term by term, as it
+does for one in a variable, against the exact value. The polynomials
+have degrees from 8 to 64, coefficients and points exact in every
+number type, and include (x - 1) ^ 20 multiplied out, which cancels
+away nearly all of its digits near 1.
+
+Both are held to the bound on the error of Horner's scheme, with or
+without a fused multiply-add:
+
+    |computed - exact| <= gamma(2n) * sum of |c_i| * |x|^i
+
+where n is the degree, gamma(k) = k u / (1 - k u), and u is the unit
+roundoff of the build, 2^-53 for double. Evaluating term by term meets
+it as well, given a pow correct to within an ulp. The largest error
+of each, in units of u times that sum, is shown for comparison.
+
+Usage: check_polynomial.py <path to calc-cli>
+"""
+
+import random
+import subprocess
+import sys
+from decimal import Decimal, getcontext
+from fractions import Fraction
+
+
+DEGREES = [8, 16, 24, 32, 48, 64]
+POINTS = 200
+
+# bits in a point, which fit in a float, and its largest magnitude
+POINT_BITS = 20
+POINT_MAX = Fraction(3, 2)
+
+getcontext().prec = 60
+
+
+def run(calc, lines):
+    """Return the value of each line, or fail if any of them didn't
+    have one."""
+    done = subprocess.run([calc], input="\n".join(lines) + "\n",
+        capture_output=True, text=True)
+    if done.returncode != 0 or done.stderr:
+        raise RuntimeError("exit code {}: {}".format(done.returncode,
+            done.stderr.strip()[:200]))
+
+    answers = [a.strip() for a in done.stdout.split(">")[1:-1]]
+    if len(answers) != len(lines):
+        raise RuntimeError("{} answers to {} lines".format(len(answers),
+            len(lines)))
+
+    return [a[2:] for a in answers]
+
+
+def unit_roundoff(calc):
+    """Return the exponent of the unit roundoff of the build: the
+    largest power of 2 that leaves 1 as it is when added to it."""
+    answers = run(calc, ["(1 + 2 ^ (-{})) - 1".format(k)
+        for k in range(1, 120)])
+    return answers.index("0") + 1
+
+
+def literal(v):
+    """Write an exact value in decimal, with more digits than any
+    number type holds."""
+    d = Decimal(v.numerator) / Decimal(v.denominator)
+    return "({})".format(format(d, ".40g"))
+
+
+def nearest(v, bits):
+    """Round an exact value to the nearest number of the given
+    precision."""
+    if v == 0:
+        return v
+
+    e = 0
+    a = abs(v)
+    while a >= 2:
+        a /= 2
+        e += 1
+    while a < 1:
+        a *= 2
+        e -= 1
+
+    scale = Fraction(2) ** (bits - 1 - e)
+    return Fraction(round(v * scale)) / scale
+
+
+def polynomials():
+    """Return each polynomial to check, as a name and coefficients,
+    lowest degree first."""
+    rng = random.Random(48)
+    result = []
+    for degree in DEGREES:
+        c = [Fraction(rng.randint(-1024, 1024), 1024)
+            for _ in range(degree + 1)]
+        c[-1] = c[-1] or Fraction(1)
+        result.append(("degree {}".format(degree), c))
+
+    binomial = [Fraction(1)]
+    for _ in range(20):
+        binomial = [a - b for a, b in zip([0] + binomial, binomial + [0])]
+    result.append(("(x - 1) ^ 20", binomial))
+
+    return result
+
+
+def written(c, x):
+    """Write a polynomial out as a sum of terms, highest degree first."""
+    terms = ["{} * {} ^ {}".format(literal(c[i]), x, i)
+        for i in range(len(c) - 1, 1, -1)]
+    return " + ".join(terms + ["{} * {}".format(literal(c[1]), x),
+        literal(c[0])])
+
+
+def main(args):
+    if len(args) != 1:
+        sys.stderr.write(__doc__.split("\n\n")[-1].strip() + "\n")
+        return 1
+
+    calc = args[0]
+    try:
+        bits = unit_roundoff(calc)
+    except (RuntimeError, OSError, ValueError) as e:
+        print("FAIL: can't run {}: {}".format(calc, e))
+        return 1
+
+    u = Fraction(1, 2 ** bits)
+    print("unit roundoff 2^-{}".format(bits))
+    print("{:<14} {:>10} {:>12} {:>12}".format("polynomial", "bound",
+        "Horner", "term by term"))
+
+    rng = random.Random(1)
+    failures = 0
+    for name, c in polynomials():
+        n = len(c) - 1
+        gamma = 2 * n * u / (1 - 2 * n * u)
+
+        points = [Fraction(rng.randint(-2 ** POINT_BITS, 2 ** POINT_BITS),
+            2 ** POINT_BITS) * POINT_MAX for _ in range(POINTS)]
+        if name.startswith("("):
+            # the hard part of (x - 1) ^ 20 is close to 1
+            points = [1 + p / 64 for p in points]
+
+        lines = ["let f[x] = " + written(c, "x")]
+        exact = []
+        for x in points:
+            value = sum(c[i] * x ** i for i in range(n + 1))
+            size = sum(abs(c[i]) * abs(x) ** i for i in range(n + 1))
+            r = nearest(value, bits)
+            exact.append((value, size, r))
+
+            # the difference from r is exact, or nearly so, and keeps
+            # the digits that calc-cli doesn't print
+            lines.append("f[{}] - {}".format(literal(x), literal(r)))
+            lines.append("({}) - {}".format(written(c, literal(x)),
+                literal(r)))
+
+        try:
+            answers = run(calc, lines)[1:]
+        except RuntimeError as e:
+            print("FAIL {}: {}".format(name, e))
+            failures += 1
+            continue
+
+        worst = [0, 0]
+        for i, (value, size, r) in enumerate(exact):
+            for j in range(2):
+                try:
+                    error = abs(Fraction(answers[2 * i + j]) + r - value)
+                except ValueError:
+                    print("FAIL {} at {}: {}".format(name,
+                        float(points[i]), answers[2 * i + j]))
+                    failures += 1
+                    break
+
+                if error > gamma * size:
+                    print("FAIL {} at {}: error {:.3g} over {:.3g}".format(
+                        name, float(points[i]), float(error),
+                        float(gamma * size)))
+                    failures += 1
+                worst[j] = max(worst[j], error / (u * size))
+
+        print("{:<14} {:>8} u {:>10.2f} u {:>10.2f} u".format(name, 2 * n,
+            float(worst[0]), float(worst[1])))
+
+    print("{} failed".format(failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
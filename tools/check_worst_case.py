@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""
+calc-cli is a command-line calculator.
+
+check_worst_case.py feeds every kind of input from worst_case.py to a
+built calc-cli, at sizes up to 100000, and fails if any of them:
+
+- crashes, as it would by overflowing the stack, which is limited to
+  8 MiB, as on Linux, for the run
+- takes longer than the timeout
+- takes more than 20 times as long as the same kind a tenth the size,
+  as parsing in quadratic time would, taking about 100 times as long;
+  the time to start calc-cli is left out of both
+- gives an error for a kind that doesn't nest, which has a value,
+  or any error but "nested too deeply" for one that does
+
+Usage: check_worst_case.py <path to calc-cli> [timeout in seconds]
+"""
+
+import subprocess
+import sys
+import time
+
+from worst_case import KINDS, NESTING, generate
+
+try:
+    import resource
+except ImportError:     # not on Windows, whose stack is set at link time
+    resource = None
+
+
+SIZES = [1000, 10000, 100000]
+STACK = 8 << 20
+RATIO = 20
+TIMEOUT = 10.0
+
+# the only error input that nests too deeply may give
+TOO_DEEP = "Error: nested too deeply"
+
+# a time shorter than this is compared as this, since it is mostly
+# noise
+FLOOR = 0.01
+
+
+def limit_stack():
+    resource.setrlimit(resource.RLIMIT_STACK, (STACK, STACK))
+
+
+def run(calc, line, timeout):
+    """Return how long calc-cli took for the line, and its output."""
+    start = time.perf_counter()
+    done = subprocess.run([calc], input=line + "\n", capture_output=True,
+        text=True, timeout=timeout,
+        preexec_fn=limit_stack if resource else None)
+    elapsed = time.perf_counter() - start
+
+    if done.returncode != 0:
+        raise RuntimeError("exit code {}".format(done.returncode))
+
+    # the error, or else the answer without the prompts
+    return elapsed, done.stderr.strip() or \
+        done.stdout.replace(">", "").strip()
+
+
+def main(args):
+    if len(args) not in (1, 2):
+        sys.stderr.write(__doc__.split("\n\n")[-1].strip() + "\n")
+        return 1
+
+    calc = args[0]
+    timeout = float(args[1]) if len(args) == 2 else TIMEOUT
+
+    try:
+        startup = min(run(calc, "1", timeout)[0] for _ in range(5))
+    except (subprocess.TimeoutExpired, RuntimeError, OSError) as e:
+        print("FAIL: can't run {}: {}".format(calc, e))
+        return 1
+
+    failures = 0
+    for kind in KINDS:
+        times = []
+        for n in SIZES:
+            try:
+                # the fastest of three, to keep out noise
+                elapsed, output = min(run(calc, generate(kind, n), timeout)
+                    for _ in range(3))
+                elapsed = max(elapsed - startup, 0)
+            except subprocess.TimeoutExpired:
+                print("FAIL {} {}: over {} s".format(kind, n, timeout))
+                failures += 1
+                break
+            except RuntimeError as e:
+                print("FAIL {} {}: {}".format(kind, n, e))
+                failures += 1
+                break
+
+            print("{:<10} {:>7} {:8.3f} s  {}".format(kind, n, elapsed,
+                output.splitlines()[0][:40] if output else ""))
+
+            if output.startswith("Error") and (kind not in NESTING or
+                    output != TOO_DEEP):
+                print("FAIL {} {}: an error instead of a value".format(
+                    kind, n))
+                failures += 1
+                break
+
+            if times and elapsed > RATIO * max(times[-1], FLOOR):
+                print("FAIL {} {}: {:.3f} s, after {:.3f} s at {}".format(
+                    kind, n, elapsed, times[-1], n // 10))
+                failures += 1
+                break
+
+            times.append(elapsed)
+
+    print("{} failed".format(failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""
+calc-cli is a command-line calculator.
+
+scaling.py times inputs which calc-cli splits across threads, and a
+--script run by as many sessions of a Shared_calculator, with
+--threads set to 1, 2, 4 and so on up to --max, and shows the speedup
+of each over one thread, to see how well they use the processors.
+Counts beyond the number of processors show what the extra threads
+cost. Each time is the best of --runs runs, in seconds of wall time,
+including starting calc-cli.
+
+Usage: scaling.py [--runs N] [--max N] [--only TEXT] <calc-cli>
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def timed(calc, args, input_text):
+    """Return how long calc-cli took, failing if it wrote an error."""
+    start = time.perf_counter()
+    done = subprocess.run([calc] + list(args), input=input_text,
+        capture_output=True, text=True)
+    elapsed = time.perf_counter() - start
+
+    if done.returncode != 0 or done.stderr or "Error" in done.stdout:
+        raise RuntimeError("exit code {}: {}".format(done.returncode,
+            (done.stderr or done.stdout).strip()[:200]))
+
+    return elapsed
+
+
+def line(text):
+    """A case which evaluates one line of input."""
+    return lambda calc, threads: timed(calc, ["--threads", str(threads)],
+        text + "\n")
+
+
+def arguments(count):
+    terms = ",".join("sin[{0}]*cos[{0}]+ln[{0}]".format(i + 1)
+        for i in range(count))
+    return line("sum[" + terms + "]")
+
+
+def name(i):
+    """A variable name made of letters only, for the number i."""
+    letters = ""
+    while True:
+        letters += chr(ord("a") + i % 26)
+        i //= 26
+        if i == 0:
+            return letters
+
+
+def script(calc, threads):
+    """A --script of 20000 independent lines, one in 20 a declaration,
+    so that each of the threads, which has a session of its own, keeps
+    fetching newly published definitions."""
+    with tempfile.NamedTemporaryFile("w", suffix=".txt",
+            delete=False) as f:
+        for i in range(20000):
+            if i % 20 == 0:
+                f.write("let v{} = {}\n".format(name(i), i))
+            f.write("sin[{0}] * cos[{0}] + sqrt[{0}]\n".format(i))
+    try:
+        return timed(calc, ["--threads", str(threads), "--script", f.name],
+            "")
+    finally:
+        os.remove(f.name)
+
+
+# name, case
+CASES = [
+    ("sum of 4e6 terms", line("sum[k, 1, 4e6, sin[k] * ln[k]]")),
+    ("sum of 30000 costly arguments", arguments(30000)),
+    ("300 calls, each a sum of 70000 terms",
+        line("let g[x] = sum[k, 1, 70000, sin[k * x]]\n"
+            "sum[j, 1, 300, g[j]]")),
+    ("--script of 20000 lines, 1000 lets", script),
+]
+
+
+def main(args):
+    runs = 3
+    most = 64
+    only = ""
+    while args and args[0].startswith("--"):
+        if args[0] in ("--runs", "--max") and len(args) > 1 and \
+                args[1].isdigit():
+            if args[0] == "--runs":
+                runs = int(args[1])
+            else:
+                most = int(args[1])
+        elif args[0] == "--only" and len(args) > 1:
+            only = args[1]
+        else:
+            break
+        args = args[2:]
+
+    if len(args) != 1 or runs == 0 or most == 0:
+        sys.stderr.write(__doc__.split("\n\n")[-1].strip() + "\n")
+        return 1
+
+    calc = os.path.abspath(args[0])
+    counts = [1]
+    while counts[-1] * 2 <= most:
+        counts.append(counts[-1] * 2)
+
+    print("{} processors".format(os.cpu_count()))
+    print("{:<40}{:>8}{:>10}{:>9}".format("case", "threads", "seconds",
+        "speedup"))
+
+    failed = False
+    for case_name, case in CASES:
+        if only not in case_name:
+            continue
+
+        one = None
+        for threads in counts:
+            try:
+                best = min(case(calc, threads) for _ in range(runs))
+            except (RuntimeError, OSError) as e:
+                sys.stderr.write("{}: {}\n".format(case_name, e))
+                failed = True
+                break
+
+            one = one or best
+            print("{:<40}{:>8}{:>10.3f}{:>8.2f}x".format(
+                case_name if threads == 1 else "", threads, best,
+                one / best), flush=True)
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
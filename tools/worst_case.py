@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""
+calc-cli is a command-line calculator.
+
+worst_case.py writes a line of input built to be as hard as possible to
+parse: long chains of operators, deep nesting of parentheses, calls and
+signs, long argument lists and long names. Each kind is scaled by n,
+the number of operators, brackets or characters it repeats. Only the
+kinds in NESTING nest; the others have a value at any size.
+
+Usage: worst_case.py <kind> <n>
+       worst_case.py --kinds
+"""
+
+import sys
+
+
+KINDS = {
+    "plus":     lambda n: "+".join(["1"] * n),
+    "minus":    lambda n: "-".join(["1"] * n),
+    "multiply": lambda n: "*".join(["1"] * n),
+    "power":    lambda n: "^".join(["1"] * n),
+    "compare":  lambda n: "<".join(["1"] * n),
+    "parens":   lambda n: "(" * n + "1" + ")" * n,
+    "nested":   lambda n: "1+(" * n + "1" + ")" * n,
+    "negated":  lambda n: "-(" * n + "1" + ")" * n,
+    "signs":    lambda n: "-" * n + "1",
+    "factorial": lambda n: "1" + "!" * n,
+    "arguments": lambda n: "sum[" + ",".join(["1"] * n) + "]",
+    "calls":    lambda n: "abs[" * n + "1" + "]" * n,
+    "name":     lambda n: "let " + "a" * n + " = 1",
+    "mixed":    lambda n: "+".join(["2*3-4/5"] * n),
+    "last":     lambda n: "1+" * n + "(" + "+".join(["1"] * n) + ")",
+}
+
+
+# kinds which nest n deep, and may be refused as nested too deeply
+NESTING = {"nested", "negated", "calls", "parens"}
+
+
+def generate(kind, n):
+    """Return the input of the given kind and size, without a newline."""
+    return KINDS[kind](n)
+
+
+def main(args):
+    if args == ["--kinds"]:
+        print("\n".join(KINDS))
+        return 0
+
+    if len(args) != 2 or args[0] not in KINDS or not args[1].isdigit():
+        sys.stderr.write(__doc__.split("\n\n")[-1].strip() + "\n")
+        return 1
+
+    print(generate(args[0], int(args[1])))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))